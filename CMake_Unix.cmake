@@ -49,6 +49,11 @@ target_link_libraries(${GOLDENDICT} PRIVATE
         Iconv::Iconv
         )
 
+# Older Hunspell versions aren't reentrant, see src/dict/hunspell.cc
+if (PKGCONFIG_DEPS_hunspell_VERSION VERSION_GREATER_EQUAL 1.7.0)
+    target_compile_definitions(${GOLDENDICT} PUBLIC HUNSPELL_IS_REENTRANT)
+endif ()
+
 if (WITH_FFMPEG_PLAYER)
     pkg_check_modules(FFMPEG REQUIRED IMPORTED_TARGET
             libavcodec
@@ -74,6 +79,11 @@ if (WITH_ZIM)
     target_link_libraries(${GOLDENDICT} PRIVATE PkgConfig::ZIM)
 endif ()
 
+if (WITH_ZSTD)
+    pkg_check_modules(ZSTD REQUIRED IMPORTED_TARGET libzstd)
+    target_link_libraries(${GOLDENDICT} PRIVATE PkgConfig::ZSTD)
+endif ()
+
 if (USE_SYSTEM_FMT)
     find_package(fmt)
     target_link_libraries(${GOLDENDICT} PRIVATE fmt::fmt)
@@ -1,6 +1,7 @@
 target_compile_definitions(${GOLDENDICT} PUBLIC
         __WIN32
         INCLUDE_LIBRARY_PATH # temporal hack to let singleapplication compile
+        HUNSPELL_IS_REENTRANT # the bundled Hunspell is 1.7
         )
 
 target_include_directories(${GOLDENDICT} PUBLIC
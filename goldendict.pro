@@ -147,6 +147,7 @@ win32 {
         LIBS += -lshell32 -luser32 -lsapi -lole32
         Debug: LIBS+= -L$$PWD/winlibs/lib/dbg/ -lhunspell-1.7
         Release: LIBS+= -L$$PWD/winlibs/lib/ -lhunspell-1.7
+        DEFINES += HUNSPELL_IS_REENTRANT
     }
 
     LIBS += -lwsock32 \
@@ -195,6 +196,8 @@ unix:!mac {
         vorbis \
         ogg \
         hunspell
+    # Older Hunspell versions aren't reentrant, see src/dict/hunspell.cc
+    system(pkg-config --atleast-version=1.7.0 hunspell): DEFINES += HUNSPELL_IS_REENTRANT
     !CONFIG( no_ffmpeg_player ) {
         PKGCONFIG += libavutil \
             libavformat \
@@ -256,6 +259,7 @@ mac {
     CONFIG += link_pkgconfig
 
     PKGCONFIG +=   hunspell
+    system(pkg-config --atleast-version=1.7.0 hunspell): DEFINES += HUNSPELL_IS_REENTRANT
     INCLUDEPATH += /opt/homebrew/include /usr/local/include
     LIBS += -L/opt/homebrew/lib -L/usr/local/lib -framework AppKit -framework Carbon
     
@@ -303,6 +307,7 @@ HEADERS += \
     src/common/htmlescape.hh \
     src/common/iconv.hh \
     src/common/inc_case_folding.hh \
+    src/common/scheduler.hh \
     src/common/sptr.hh \
     src/common/ufile.hh \
     src/common/utf8.hh \
@@ -361,6 +366,7 @@ HEADERS += \
     src/history.hh \
     src/hotkeywrapper.hh \
     src/iframeschemehandler.hh \
+    src/indexcodec.hh \
     src/indexedzip.hh \
     src/initializing.hh \
     src/instances.hh \
@@ -429,6 +435,7 @@ SOURCES += \
     src/common/help.cc \
     src/common/htmlescape.cc \
     src/common/iconv.cc \
+    src/common/scheduler.cc \
     src/common/ufile.cc \
     src/common/utf8.cc \
     src/common/utils.cc \
@@ -484,6 +491,7 @@ SOURCES += \
     src/history.cc \
     src/hotkeywrapper.cc \
     src/iframeschemehandler.cc \
+    src/indexcodec.cc \
     src/indexedzip.cc \
     src/initializing.cc \
     src/instances.cc \
@@ -560,6 +568,11 @@ CONFIG( zim_support ) {
   LIBS += -lzim
 }
 
+CONFIG( zstd_support ) {
+  DEFINES += USE_ZSTD
+  LIBS += -lzstd
+}
+
 CONFIG( no_epwing_support ) {
   DEFINES += NO_EPWING_SUPPORT
 }
@@ -13,8 +13,10 @@
 #include "wstring_qt.hh"
 #include <QDir>
 #include <QFile>
-#include <QTextDocumentFragment>
 #include <QUrl>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 
 #include "fmt/core.h"
 #include "fmt/compile.h"
@@ -484,18 +486,25 @@ ArticleRequest::ArticleRequest( QString const & word,
 
   hasAnyData = true;
 
+  Config::Preferences const * preferences = GlobalBroadcaster::instance()->getPreference();
+  streamArticles                          = preferences && preferences->streamArticles;
+
   appendString( header );
 
   //clear founded dicts.
   emit GlobalBroadcaster::instance()->dictionaryClear( ActiveDictIds{ group.id, word } );
 
+  if ( activeDicts.size() <= 1 )
+    articleSizeLimit = -1; // Don't collapse article if only one dictionary presented
+
   // Accumulate main forms
-  for ( const auto & activeDict : activeDicts ) {
-    auto const s = activeDict->findHeadwordsForSynonym( gd::removeTrailingZero( word ) );
+  for ( size_t x = 0; x < activeDicts.size(); ++x ) {
+    auto const s = activeDicts[ x ]->findHeadwordsForSynonym( gd::removeTrailingZero( word ) );
 
     connect( s.get(), &Dictionary::Request::finished, this, &ArticleRequest::altSearchFinished, Qt::QueuedConnection );
 
     altSearches.push_back( s );
+    bodyRequests.push_back( BodyRequest{ x, {} } );
   }
 
   altSearchFinished(); // Handle any ones which have already finished
@@ -522,61 +531,76 @@ void ArticleRequest::altSearchFinished()
   if ( altSearches.empty() ) {
 #ifdef QT_DEBUG
     qDebug( "alts finished" );
-#endif
-
-    // They all've finished! Now we can look up bodies
-
-    altsDone = true; // So any pending signals in queued mode won't mess us up
-
-    vector< wstring > altsVector( alts.begin(), alts.end() );
 
-#ifdef QT_DEBUG
-    for ( const auto & x : altsVector ) {
+    for ( const auto & x : alts ) {
       qDebug() << "Alt:" << QString::fromStdU32String( x );
     }
 #endif
 
-    wstring wordStd = gd::toWString( word );
-
-    if ( activeDicts.size() <= 1 )
-      articleSizeLimit = -1; // Don't collapse article if only one dictionary presented
+    altsDone = true; // So any pending signals in queued mode won't mess us up
+  }
 
-    for ( const auto & activeDict : activeDicts ) {
-      try {
-        sptr< Dictionary::DataRequest > r = activeDict->getArticle(
-          wordStd,
-          altsVector,
-          gd::removeTrailingZero( contexts.value( QString::fromStdString( activeDict->getId() ) ) ),
-          ignoreDiacritics );
+  // Don't wait for the slow synonym searches to start looking up the bodies
+  startBodyRequests();
 
-        connect( r.get(), &Dictionary::Request::finished, this, &ArticleRequest::bodyFinished, Qt::QueuedConnection );
+  if ( altsDone )
+    bodyFinished(); // Handle any ones which have already finished
+}
 
-        bodyRequests.push_back( r );
-      }
-      catch ( std::exception & e ) {
-        gdWarning( "getArticle request error (%s) in \"%s\"\n", e.what(), activeDict->getName().c_str() );
+void ArticleRequest::startBodyRequests()
+{
+  for ( auto i = bodyRequests.begin(); i != bodyRequests.end(); ) {
+    if ( i->request ) {
+      if ( !altsDone || i->altsUsed == alts.size() ) {
+        ++i;
+        continue;
       }
+
+      // Some alts have arrived after it was started, so it has to be redone
+      // with all of them. The finished signal of the old one is harmless,
+      // since it isn't referenced anymore.
+      i->request->cancel();
+    }
+    else if ( i->started ? !altsDone || i->altsUsed == alts.size() :
+                           !altsDone && !activeDicts[ i->dictIndex ]->isLocalDictionary() ) {
+      // Either it's waiting for all the alts, or there's nothing to redo
+      ++i;
+      continue;
     }
 
-    bodyFinished(); // Handle any ones which have already finished
+    if ( startBodyRequest( *i ) || i->shown )
+      ++i; // What's already on the page stays there if the redo fails
+    else
+      i = bodyRequests.erase( i );
   }
 }
 
-int ArticleRequest::findEndOfCloseDiv( const QString & str, int pos )
+bool ArticleRequest::startBodyRequest( BodyRequest & body )
 {
-  for ( ;; ) {
-    const int n1 = str.indexOf( "</div>", pos );
-    if ( n1 <= 0 )
-      return n1;
-
-    // will there be some custom tags starts with <div but not <div> ,such as <divider>
-    const int n2 = str.indexOf( RX::Html::startDivTag, pos );
-    if ( n2 <= 0 || n2 > n1 )
-      return n1 + 6;
-
-    pos = findEndOfCloseDiv( str, n2 + 1 );
-    if ( pos <= 0 )
-      return pos;
+  sptr< Dictionary::Class > const & activeDict = activeDicts[ body.dictIndex ];
+
+  body.started  = true;
+  body.altsUsed = alts.size();
+
+  try {
+    body.request = activeDict->getArticle(
+      gd::toWString( word ),
+      vector< wstring >( alts.begin(), alts.end() ),
+      gd::removeTrailingZero( contexts.value( QString::fromStdString( activeDict->getId() ) ) ),
+      ignoreDiacritics );
+
+    connect( body.request.get(),
+             &Dictionary::Request::finished,
+             this,
+             &ArticleRequest::bodyFinished,
+             Qt::QueuedConnection );
+
+    return true;
+  }
+  catch ( std::exception & e ) {
+    gdWarning( "getArticle request error (%s) in \"%s\"\n", e.what(), activeDict->getName().c_str() );
+    body.request.reset();
+    return false;
   }
 }
 
@@ -585,37 +609,17 @@ bool ArticleRequest::isCollapsable( Dictionary::DataRequest & req, QString const
   if ( GlobalBroadcaster::instance()->collapsedDicts.contains( dictId ) )
     return true;
 
-  bool collapse = false;
-
-  if ( articleSizeLimit >= 0 ) {
-    try {
-      QMutexLocker _( &dataMutex );
-      QString text = QString::fromUtf8( req.getFullData().data(), req.getFullData().size() );
-
-      if ( !needExpandOptionalParts ) {
-        // Strip DSL optional parts
-        for ( ;; ) {
-          const int pos = text.indexOf( "<div class=\"dsl_opt\"" );
-          if ( pos > 0 ) {
-            const int endPos = findEndOfCloseDiv( text, pos + 1 );
-            if ( endPos > pos )
-              text.remove( pos, endPos - pos );
-            else
-              break;
-          }
-          else
-            break;
-        }
-      }
+  if ( articleSizeLimit < 0 )
+    return false;
 
-      int size = htmlTextSize( text );
-      if ( size > articleSizeLimit )
-        collapse = true;
-    }
-    catch ( ... ) {
-    }
+  try {
+    vector< char > const & body = req.getFullData();
+
+    return htmlTextSize( body.data(), body.size(), !needExpandOptionalParts, articleSizeLimit ) > articleSizeLimit;
+  }
+  catch ( ... ) {
+    return false;
   }
-  return collapse;
 }
 
 void ArticleRequest::bodyFinished()
@@ -628,50 +632,79 @@ void ArticleRequest::bodyFinished()
   bool wasUpdated = false;
 
   QStringList dictIds;
-  while ( bodyRequests.size() ) {
-    // Since requests should go in order, check the first one first
-    if ( bodyRequests.front()->isFinished() ) {
+  for ( auto i = bodyRequests.begin(); i != bodyRequests.end(); ) {
+    // Since requests should go in order, check the first one first. When
+    // streaming, the unfinished ones are given slots to be filled later.
+    if ( i->request && i->request->isFinished() ) {
       // Good
 
       GD_DPRINTF( "one finished." );
 
-      Dictionary::DataRequest & req = *bodyRequests.front();
+      Dictionary::DataRequest & req = *i->request;
 
       QString errorString = req.getErrorString();
 
       if ( req.dataSize() >= 0 || errorString.size() ) {
-        sptr< Dictionary::Class > const & activeDict = activeDicts[ activeDicts.size() - bodyRequests.size() ];
+        sptr< Dictionary::Class > const & activeDict = activeDicts[ i->dictIndex ];
 
         string dictId = activeDict->getId();
 
-        //signal finished dictionray for pronounciation
-        GlobalBroadcaster::instance()->pronounce_engine.finishDictionary( dictId );
+        if ( !i->shown ) {
+          //signal finished dictionray for pronounciation
+          GlobalBroadcaster::instance()->pronounce_engine.finishDictionary( dictId );
+
+          dictIds << QString::fromStdString( dictId );
+        }
 
-        dictIds << QString::fromStdString( dictId );
         string head;
 
         string gdFrom = "gdfrom-" + Html::escape( dictId );
 
+        string jsVal = Html::escapeForJavaScript( dictId );
+
+        // An article which may still be redone with more alts is shown in a
+        // slot of its own, which the redone one replaces later
+        bool const final = altsDone && i->altsUsed == alts.size();
+        bool const put   = i->hasSlot || i->shown || !final;
+        string fillId    = i->shown ? "redo-" + dictId : dictId;
+
         if ( closePrevSpan ) {
-          head += R"(</div></div><div style="clear:both;"></div><span class="gdarticleseparator"></span>)";
+          head += "</div></div>";
+          closePrevSpan = false;
         }
 
-        bool collapse = isCollapsable( req, QString::fromStdString( dictId ) );
+        if ( put && !i->hasSlot && !i->shown ) {
+          head += R"(<div class="gdarticleslot" id="gdslot-)" + Html::escape( dictId ) + "\"></div>";
+          i->hasSlot = true;
+        }
 
-        string jsVal = Html::escapeForJavaScript( dictId );
+        if ( put ) {
+          // It's put aside and moved to its slot once complete. A template
+          // keeps the unbalanced tags of the article from leaking out of it.
+          head += R"(<template id="gdslotfill-)" + Html::escape( fillId ) + "\">";
+        }
+
+        if ( !final )
+          head += R"(<div class="gdarticleslot" id="gdslot-redo-)" + Html::escape( dictId ) + "\">";
+
+        if ( foundAnyDefinitions || put ) {
+          head += R"(<div style="clear:both;"></div><span class="gdarticleseparator"></span>)";
+        }
+
+        i->active = i->active || !foundAnyDefinitions;
+
+        bool collapse = isCollapsable( req, QString::fromStdString( dictId ) );
 
         fmt::format_to( std::back_inserter( head ),
                         FMT_COMPILE(
                           R"( <div class="gdarticle {0} {1}" id="{2}"
                               onClick="gdMakeArticleActive( '{3}', false );"
                               onContextMenu="gdMakeArticleActive( '{3}', false );">)" ),
-                        closePrevSpan ? "" : " gdactivearticle",
+                        i->active ? " gdactivearticle" : "",
                         collapse ? " gdcollapsedarticle" : "",
                         gdFrom,
                         jsVal );
 
-        closePrevSpan = true;
-
         fmt::format_to(
           std::back_inserter( head ),
           FMT_COMPILE(
@@ -720,22 +753,59 @@ void ArticleRequest::bodyFinished()
 
         try {
           if ( req.dataSize() > 0 ) {
-            auto d = bodyRequests.front()->getFullData();
-            appendDataSlice( &d.front(), d.size() );
+            vector< char > const & d = req.getFullData();
+            appendDataSlice( d.data(), d.size() );
           }
         }
         catch ( std::exception & e ) {
           gdWarning( "getDataSlice error: %s\n", e.what() );
         }
 
+        if ( streamArticles || put ) {
+          // The articles may come in any order, so each one is closed at once
+          string tail = "</div></div>";
+
+          if ( !final )
+            tail += "</div>";
+
+          if ( put )
+            tail += "</template><script>gdFillArticleSlot('" + Html::escapeForJavaScript( fillId ) + "');</script>";
+
+          appendString( tail );
+        }
+        else
+          closePrevSpan = true;
+
         wasUpdated = true;
 
         foundAnyDefinitions = true;
+
+        i->shown = true;
       }
+
+      i->request.reset();
+    }
+
+    if ( !i->request && i->started && altsDone
+         && ( i->altsUsed == alts.size() || !startBodyRequest( *i ) ) ) {
+      // Nothing more to come for it
       GD_DPRINTF( "erasing.." );
-      bodyRequests.pop_front();
+      i = bodyRequests.erase( i );
       GD_DPRINTF( "erase done.." );
     }
+    else if ( i->shown ) {
+      // The redone article will replace it once it's done
+      ++i;
+    }
+    else if ( streamArticles ) {
+      // Hold its place on the page and go on with the ones below it
+      if ( !i->hasSlot ) {
+        appendString( R"(<div class="gdarticleslot" id="gdslot-)" + Html::escape( activeDicts[ i->dictIndex ]->getId() )
+                      + "\"></div>" );
+        i->hasSlot = true;
+      }
+      ++i;
+    }
     else {
       GD_DPRINTF( "one not finished." );
       break;
@@ -804,22 +874,122 @@ void ArticleRequest::bodyFinished()
   }
 }
 
-int ArticleRequest::htmlTextSize( QString html )
+namespace {
+
+/// Checks whether the tag starting at p, right after the '<', has the given
+/// lowercase name.
+bool isTag( char const * p, char const * end, char const * name )
 {
-  // website dictionary.
-  if ( html.contains( QRegularExpression( "<iframe\\s*[^>]*>", QRegularExpression::CaseInsensitiveOption ) ) ) {
-    //arbitary number;
-    return 1000;
+  for ( ; *name; ++p, ++name ) {
+    if ( p == end || ( *p | 0x20 ) != *name )
+      return false;
   }
 
-  //https://bugreports.qt.io/browse/QTBUG-102757
-  QString stripStyleSheet =
-    html.remove( QRegularExpression( "<link\\s*[^>]*>", QRegularExpression::CaseInsensitiveOption ) )
-      .remove( QRegularExpression( R"(<script[\s\S]*?>[\s\S]*?<\/script>)",
-                                   QRegularExpression::CaseInsensitiveOption | QRegularExpression::MultilineOption ) );
-  int size = QTextDocumentFragment::fromHtml( stripStyleSheet ).toPlainText().length();
+  return p == end || *p == '>' || *p == '/' || isspace( (unsigned char)*p );
+}
 
-  return size;
+/// Finds the closing tag with the given lowercase name, such as "</script",
+/// starting from p. Returns end if there's none.
+char const * findClosingTag( char const * p, char const * end, char const * name )
+{
+  for ( ; ( p = (char const *)memchr( p, '<', end - p ) ); ++p ) {
+    if ( p + 1 != end && p[ 1 ] == '/' && isTag( p + 2, end, name ) )
+      return p;
+  }
+
+  return end;
+}
+
+} // namespace
+
+int ArticleRequest::htmlTextSize( char const * html, size_t size, bool skipOptionalParts, int limit )
+{
+  char const * p         = html;
+  char const * const end = html + size;
+
+  int length        = 0;
+  bool afterSpace   = true;
+  int optionalDepth = 0; // The nesting level of divs within the optional part being skipped
+
+  while ( p != end && length <= limit ) {
+    if ( *p == '<' ) {
+      char const * tag = p + 1;
+
+      if ( end - tag >= 3 && memcmp( tag, "!--", 3 ) == 0 ) {
+        char const * commentEnd = std::search( tag, end, "-->", "-->" + 3 );
+        p                       = commentEnd == end ? end : commentEnd + 3;
+        continue;
+      }
+
+      char const * tagEnd = (char const *)memchr( tag, '>', end - tag );
+      if ( !tagEnd )
+        break;
+
+      p = tagEnd + 1;
+
+      if ( isTag( tag, tagEnd, "iframe" ) ) {
+        // A website dictionary. Its size can't be known, so it's an arbitrary number.
+        return 1000;
+      }
+
+      // Scripts and styles aren't shown
+      char const * hiddenTag = nullptr;
+      if ( isTag( tag, tagEnd, "script" ) )
+        hiddenTag = "script";
+      else if ( isTag( tag, tagEnd, "style" ) )
+        hiddenTag = "style";
+
+      if ( hiddenTag ) {
+        p = findClosingTag( p, end, hiddenTag );
+        continue;
+      }
+
+      if ( isTag( tag, tagEnd, "div" ) ) {
+        static char const optionalPart[] = "div class=\"dsl_opt\"";
+
+        if ( optionalDepth )
+          ++optionalDepth;
+        else if ( skipOptionalParts && tagEnd - tag >= (long)sizeof( optionalPart ) - 1
+                  && memcmp( tag, optionalPart, sizeof( optionalPart ) - 1 ) == 0 )
+          optionalDepth = 1;
+      }
+      else if ( optionalDepth && *tag == '/' && isTag( tag + 1, tagEnd, "div" ) )
+        --optionalDepth;
+
+      continue;
+    }
+
+    if ( optionalDepth ) {
+      ++p;
+      continue;
+    }
+
+    unsigned char const c = *p++;
+
+    if ( isspace( c ) ) {
+      // Runs of whitespace collapse into a single space
+      if ( !afterSpace )
+        ++length;
+      afterSpace = true;
+      continue;
+    }
+
+    afterSpace = false;
+
+    if ( c == '&' ) {
+      // An entity, which stands for a single character
+      char const * entityEnd = (char const *)memchr( p, ';', std::min< ptrdiff_t >( end - p, 10 ) );
+      if ( entityEnd )
+        p = entityEnd + 1;
+      ++length;
+    }
+    else if ( ( c & 0xC0 ) != 0x80 ) {
+      // Count the utf16 code units, like QString does
+      length += c >= 0xF0 ? 2 : 1;
+    }
+  }
+
+  return length;
 }
 
 void ArticleRequest::stemmedSearchFinished()
@@ -1109,10 +1279,9 @@ void ArticleRequest::cancel()
       ( *i )->cancel();
     }
   }
-  if ( !bodyRequests.empty() ) {
-    for ( list< sptr< Dictionary::DataRequest > >::iterator i = bodyRequests.begin(); i != bodyRequests.end(); ++i ) {
-      ( *i )->cancel();
-    }
+  for ( auto & body : bodyRequests ) {
+    if ( body.request )
+      body.request->cancel();
   }
   if ( stemmedWordFinder.get() )
     stemmedWordFinder->cancel();
@@ -87,12 +87,25 @@ class ArticleRequest: public Dictionary::DataRequest
 
   std::set< gd::wstring, std::less<> > alts; // Accumulated main forms
   std::list< sptr< Dictionary::WordSearchRequest > > altSearches;
-  std::list< sptr< Dictionary::DataRequest > > bodyRequests;
+
+  /// The article of a dictionary, in the order of activeDicts
+  struct BodyRequest
+  {
+    size_t dictIndex;
+    sptr< Dictionary::DataRequest > request; // Null when not running
+    size_t altsUsed{ 0 };                    // The number of alts it was last started with
+    bool started{ false };
+    bool shown{ false };   // Whether an article which may be redone is on the page
+    bool hasSlot{ false }; // Whether a placeholder was put on the page for it
+    bool active{ false };  // Whether its article is the active one
+  };
+  std::list< BodyRequest > bodyRequests;
   bool altsDone{ false };
   bool bodyDone{ false };
   bool foundAnyDefinitions{ false };
   bool closePrevSpan{ false };          // Indicates whether the last opened article span is to
                                         // be closed after the article ends.
+  bool streamArticles{ false };         // Show the articles out of order, in their slots
   sptr< WordFinder > stemmedWordFinder; // Used when there're no results
 
   /// A sequence of words and spacings between them, including the initial
@@ -135,7 +148,21 @@ private slots:
   void individualWordFinished();
 
 private:
-  int htmlTextSize( QString html );
+  /// Starts the body requests which can be started with the alts known so
+  /// far. Local dictionaries are queried right away and shown once done. If
+  /// more alts have arrived meanwhile, they're queried again with the word
+  /// and all the alts once those are known, and the redone article replaces
+  /// the one shown, so the dictionary itself still weeds out the duplicates.
+  /// The rest wait for all the alts, since they may be costly to query twice.
+  void startBodyRequests();
+
+  /// Queries the dictionary of the given body for the word and all the alts
+  /// known. Returns false if the request couldn't be made.
+  bool startBodyRequest( BodyRequest & );
+
+  /// Estimates the length of the plain text the html body would be shown
+  /// as, without making a copy of it. Stops counting once it exceeds the limit.
+  static int htmlTextSize( char const * html, size_t size, bool skipOptionalParts, int limit );
 
   /// Uses stemmedWordFinder to perform the next step of looking up word
   /// combinations.
@@ -150,8 +177,6 @@ private:
   /// Escapes the spacing between the words to include in html.
   std::string escapeSpacing( QString const & );
 
-  /// Find end of corresponding </div> tag
-  int findEndOfCloseDiv( QString const &, int pos );
   bool isCollapsable( Dictionary::DataRequest & req, QString const & dictId );
 };
 
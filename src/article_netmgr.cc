@@ -239,6 +239,54 @@ QNetworkReply * ArticleNetworkAccessManager::getArticleReply( QNetworkRequest co
   return new AllowFrameReply( reply );
 }
 
+ArticleNetworkAccessManager::ArticleNetworkAccessManager( QObject * parent,
+                                                          ArticleMaker const & articleMaker_,
+                                                          bool const & disallowContentFromOtherSites_,
+                                                          bool const & hideGoldenDictHeader_ ):
+  QNetworkAccessManager( parent ),
+  articleMaker( articleMaker_ ),
+  disallowContentFromOtherSites( disallowContentFromOtherSites_ ),
+  hideGoldenDictHeader( hideGoldenDictHeader_ ),
+  registry( Dictionary::Registry::current() )
+{
+  connect( GlobalBroadcaster::instance(),
+           &GlobalBroadcaster::dictionaryRegistryPublished,
+           this,
+           &ArticleNetworkAccessManager::registryPublished );
+}
+
+void ArticleNetworkAccessManager::registryPublished()
+{
+  encodedIcons.clear();
+  registry = Dictionary::Registry::current();
+}
+
+sptr< Dictionary::Class > ArticleNetworkAccessManager::findDictionary( string const & id )
+{
+  return registry->find( id );
+}
+
+sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getDictionaryIcon( Dictionary::Class & dict )
+{
+  QIcon const & icon    = dict.getIcon();
+  EncodedIcon & encoded = encodedIcons[ dict.getId() ];
+
+  if ( encoded.png.empty() || encoded.iconKey != icon.cacheKey() ) {
+    QByteArray bytes;
+    QBuffer buffer( &bytes );
+    buffer.open( QIODevice::WriteOnly );
+    icon.pixmap( 64 ).save( &buffer, "PNG" );
+    buffer.close();
+
+    encoded.iconKey = icon.cacheKey();
+    encoded.png.assign( bytes.begin(), bytes.end() );
+  }
+
+  sptr< Dictionary::DataRequestInstant > ico = std::make_shared< Dictionary::DataRequestInstant >( true );
+  ico->getData() = encoded.png;
+  return ico;
+}
+
 sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource( QUrl const & url, QString & contentType )
 {
   qDebug() << "getResource:" << url.toString();
@@ -309,27 +357,18 @@ sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource( QUrl c
     bool search = ( id == "search" );
 
     if ( !search ) {
-      for ( unsigned x = 0; x < dictionaries.size(); ++x )
-        if ( dictionaries[ x ]->getId() == id ) {
-          if ( url.scheme() == "gico" ) {
-            QByteArray bytes;
-            QBuffer buffer( &bytes );
-            buffer.open( QIODevice::WriteOnly );
-            dictionaries[ x ]->getIcon().pixmap( 64 ).save( &buffer, "PNG" );
-            buffer.close();
-            sptr< Dictionary::DataRequestInstant > ico = std::make_shared< Dictionary::DataRequestInstant >( true );
-            ico->getData().resize( bytes.size() );
-            memcpy( &( ico->getData().front() ), bytes.data(), bytes.size() );
-            return ico;
-          }
-          try {
-            return dictionaries[ x ]->getResource( Utils::Url::path( url ).mid( 1 ).toUtf8().data() );
-          }
-          catch ( std::exception & e ) {
-            gdWarning( "getResource request error (%s) in \"%s\"\n", e.what(), dictionaries[ x ]->getName().c_str() );
-            return sptr< Dictionary::DataRequest >();
-          }
+      if ( sptr< Dictionary::Class > dict = findDictionary( id ) ) {
+        if ( url.scheme() == "gico" )
+          return getDictionaryIcon( *dict );
+
+        try {
+          return dict->getResource( Utils::Url::path( url ).mid( 1 ).toUtf8().data() );
+        }
+        catch ( std::exception & e ) {
+          gdWarning( "getResource request error (%s) in \"%s\"\n", e.what(), dict->getName().c_str() );
+          return sptr< Dictionary::DataRequest >();
         }
+      }
     }
   }
 
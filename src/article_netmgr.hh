@@ -16,6 +16,8 @@
 #include "dict/dictionary.hh"
 #include "article_maker.hh"
 
+#include <unordered_map>
+
 using std::vector;
 
 /// A custom QNetworkAccessManager version which fetches images from the
@@ -129,26 +131,45 @@ protected:
 class ArticleNetworkAccessManager: public QNetworkAccessManager
 {
   Q_OBJECT
-  vector< sptr< Dictionary::Class > > const & dictionaries;
   ArticleMaker const & articleMaker;
   bool const & disallowContentFromOtherSites;
   bool const & hideGoldenDictHeader;
   QMimeDatabase db;
 
+  /// The registry the encoded icons below were made with. Once another one
+  /// is published, the dictionaries were reloaded, so it's replaced and the
+  /// icons are dropped.
+  sptr< Dictionary::Registry const > registry;
+
+  /// The icon of a dictionary encoded as PNG, along with the cache key of
+  /// the icon, which tells whether it was changed since
+  struct EncodedIcon
+  {
+    qint64 iconKey;
+    vector< char > png;
+  };
+
+  /// The encoded icons by the dictionary ids
+  std::unordered_map< std::string, EncodedIcon > encodedIcons;
+
+  /// Returns the dictionary with the given id, or an empty pointer
+  sptr< Dictionary::Class > findDictionary( std::string const & id );
+
+  /// Returns the icon of the dictionary encoded as PNG, encoding it only if
+  /// it's not cached or was changed. Only called on the GUI thread.
+  sptr< Dictionary::DataRequest > getDictionaryIcon( Dictionary::Class & );
+
+private slots:
+
+  /// Releases the registry held and the icons of its dictionaries
+  void registryPublished();
+
 public:
 
   ArticleNetworkAccessManager( QObject * parent,
-                               vector< sptr< Dictionary::Class > > const & dictionaries_,
                                ArticleMaker const & articleMaker_,
                                bool const & disallowContentFromOtherSites_,
-                               bool const & hideGoldenDictHeader_ ):
-    QNetworkAccessManager( parent ),
-    dictionaries( dictionaries_ ),
-    articleMaker( articleMaker_ ),
-    disallowContentFromOtherSites( disallowContentFromOtherSites_ ),
-    hideGoldenDictHeader( hideGoldenDictHeader_ )
-  {
-  }
+                               bool const & hideGoldenDictHeader_ );
 
   /// Tries handling any kind of internal resources referenced by dictionaries.
   /// If it succeeds, the result is a dictionary request object. Otherwise, an
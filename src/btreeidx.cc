@@ -17,9 +17,11 @@
 #include <QRegularExpression>
 #include "wildcard.hh"
 #include "globalbroadcaster.hh"
+#include "indexcodec.hh"
 
-#include <QtConcurrent>
-#include <zlib.h>
+#include <atomic>
+#include <list>
+#include <unordered_map>
 
 namespace BtreeIndexing {
 
@@ -32,9 +34,178 @@ enum {
   BtreeMaxElements = 8192
 };
 
+namespace {
+
+/// A process-wide LRU cache of decompressed btree nodes, shared by all the
+/// opened indices. Nodes are keyed by the id of the opened index and their
+/// offset in it. The cache is split into several independently locked shards
+/// to keep the contention low when many dictionaries are searched at once.
+class NodeCache
+{
+public:
+
+  enum {
+    Shards        = 16,
+    DefaultBudget = 64 * 1024 * 1024
+  };
+
+  static NodeCache & instance()
+  {
+    static NodeCache cache;
+    return cache;
+  }
+
+  sptr< Node const > find( uint32_t cacheId, uint32_t offset )
+  {
+    uint64_t key  = makeKey( cacheId, offset );
+    Shard & shard = shardFor( key );
+
+    QMutexLocker _( &shard.mutex );
+
+    auto i = shard.index.find( key );
+
+    if ( i == shard.index.end() ) {
+      ++shard.misses;
+      return {};
+    }
+
+    ++shard.hits;
+
+    // Move the entry to the front, as the most recently used one
+    shard.lru.splice( shard.lru.begin(), shard.lru, i->second );
+
+    return i->second->node;
+  }
+
+  void insert( uint32_t cacheId, uint32_t offset, sptr< Node const > const & node )
+  {
+    size_t shardBudget = budget.load( std::memory_order_relaxed ) / Shards;
+    size_t cost        = nodeCost( *node );
+
+    if ( cost > shardBudget )
+      return;
+
+    uint64_t key  = makeKey( cacheId, offset );
+    Shard & shard = shardFor( key );
+
+    QMutexLocker _( &shard.mutex );
+
+    if ( shard.index.find( key ) != shard.index.end() )
+      return; // Some other thread has inserted it already
+
+    shard.lru.push_front( Entry{ key, node, cost } );
+    shard.index.emplace( key, shard.lru.begin() );
+    shard.bytesUsed += cost;
+
+    trim( shard, shardBudget );
+  }
+
+  void setBudget( size_t bytes )
+  {
+    budget.store( bytes, std::memory_order_relaxed );
+
+    for ( auto & shard : shards ) {
+      QMutexLocker _( &shard.mutex );
+      trim( shard, bytes / Shards );
+    }
+  }
+
+  NodeCacheStats stats()
+  {
+    NodeCacheStats result;
+
+    result.bytesBudget = budget.load( std::memory_order_relaxed );
+
+    for ( auto & shard : shards ) {
+      QMutexLocker _( &shard.mutex );
+      result.hits += shard.hits;
+      result.misses += shard.misses;
+      result.evictions += shard.evictions;
+      result.nodes += shard.index.size();
+      result.bytesUsed += shard.bytesUsed;
+    }
+
+    return result;
+  }
+
+private:
+
+  struct Entry
+  {
+    uint64_t key;
+    sptr< Node const > node;
+    size_t cost;
+  };
+
+  struct Shard
+  {
+    QMutex mutex;
+    std::list< Entry > lru; // Most recently used entries come first
+    std::unordered_map< uint64_t, std::list< Entry >::iterator > index;
+    size_t bytesUsed   = 0;
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+  };
+
+  NodeCache():
+    budget( DefaultBudget )
+  {
+  }
+
+  static uint64_t makeKey( uint32_t cacheId, uint32_t offset )
+  {
+    return ( (uint64_t)cacheId << 32 ) | offset;
+  }
+
+  static size_t nodeCost( Node const & node )
+  {
+    return node.data.capacity() + sizeof( Node ) + sizeof( Entry );
+  }
+
+  Shard & shardFor( uint64_t key )
+  {
+    // Mix the index id with the offset, as offsets are rarely evenly distributed
+    return shards[ ( key ^ ( key >> 32 ) ^ ( key >> 7 ) ) % Shards ];
+  }
+
+  static void trim( Shard & shard, size_t shardBudget )
+  {
+    while ( shard.bytesUsed > shardBudget && !shard.lru.empty() ) {
+      Entry const & victim = shard.lru.back();
+      shard.bytesUsed -= victim.cost;
+      shard.index.erase( victim.key );
+      shard.lru.pop_back();
+      ++shard.evictions;
+    }
+  }
+
+  std::atomic< size_t > budget;
+  Shard shards[ Shards ];
+};
+
+/// Each opened index gets its own id, so the nodes of the indices which were
+/// closed or rebuilt can never be confused with the ones of a newer index.
+std::atomic< uint32_t > nextCacheId( 1 );
+
+} // namespace
+
+NodeCacheStats getNodeCacheStats()
+{
+  return NodeCache::instance().stats();
+}
+
+void setNodeCacheBudget( size_t bytes )
+{
+  NodeCache::instance().setBudget( bytes );
+}
+
 BtreeIndex::BtreeIndex():
+  idxFileMutex( nullptr ),
   idxFile( nullptr ),
-  rootNodeLoaded( false )
+  cacheId( 0 ),
+  idxMapping( nullptr ),
+  idxMappingSize( 0 )
 {
 }
 
@@ -52,14 +223,22 @@ string const & BtreeDictionary::ensureInitDone()
 
 void BtreeIndex::openIndex( IndexInfo const & indexInfo, File::Class & file, QMutex & mutex )
 {
-  indexNodeSize = indexInfo.btreeMaxElements;
+  indexNodeSize = indexInfo.btreeMaxElements & 0xFFFFFF;
+  nodeCodec     = indexInfo.btreeMaxElements >> 24;
   rootOffset    = indexInfo.rootOffset;
 
+  if ( !IndexCodec::isSupported( nodeCodec ) )
+    throw IndexCodec::exUnsupportedCodec();
+
   idxFile      = &file;
   idxFileMutex = &mutex;
 
-  rootNodeLoaded = false;
-  rootNode.clear();
+  cacheId = nextCacheId.fetch_add( 1, std::memory_order_relaxed );
+
+  idxMapping     = file.mapAll();
+  idxMappingSize = idxMapping ? file.mappedSize() : 0;
+
+  std::atomic_store( &rootNode, sptr< Node const >() );
 }
 
 vector< WordArticleLink >
@@ -76,7 +255,7 @@ BtreeIndex::findArticles( wstring const & search_word, bool ignoreDiacritics, ui
 
     bool exactMatch;
 
-    vector< char > leaf;
+    sptr< Node const > leaf;
     uint32_t nextLeaf;
 
     char const * leafEnd;
@@ -101,6 +280,180 @@ BtreeIndex::findArticles( wstring const & search_word, bool ignoreDiacritics, ui
   return result;
 }
 
+namespace {
+
+/// The chains of a btree leaf, with their folded words computed on demand,
+/// used to look up several words in the same leaf.
+class LeafChains
+{
+public:
+
+  void reset( sptr< Node const > const & node_ )
+  {
+    node = node_;
+    chains.clear();
+    folded.clear();
+
+    if ( !node )
+      return;
+
+    char const * ptr     = node->data.data();
+    uint32_t leafEntries = *(uint32_t *)ptr;
+
+    if ( leafEntries == 0xffffFFFF )
+      return; // Not a leaf
+
+    ptr += sizeof( uint32_t );
+
+    chains.resize( leafEntries );
+    folded.resize( leafEntries );
+
+    for ( auto & chain : chains ) {
+      uint32_t chainSize;
+
+      chain = ptr;
+      memcpy( &chainSize, ptr, sizeof( uint32_t ) );
+      ptr += sizeof( uint32_t ) + chainSize;
+    }
+  }
+
+  /// Returns true if the folded word, being no less than the one used to
+  /// locate the leaf, can only be in this leaf
+  bool covers( wstring const & target )
+  {
+    return !chains.empty() && target.compare( foldedAt( chains.size() - 1 ) ) <= 0;
+  }
+
+  /// Returns the chain of the folded word, or nullptr if there's none
+  char const * find( wstring const & target )
+  {
+    size_t begin = 0, end = chains.size();
+
+    while ( begin < end ) {
+      size_t middle     = begin + ( end - begin ) / 2;
+      int compareResult = target.compare( foldedAt( middle ) );
+
+      if ( !compareResult )
+        return chains[ middle ];
+
+      if ( compareResult < 0 )
+        end = middle;
+      else
+        begin = middle + 1;
+    }
+
+    return nullptr;
+  }
+
+private:
+
+  wstring const & foldedAt( size_t index )
+  {
+    wstring & result = folded[ index ];
+
+    if ( result.empty() ) {
+      wstring word = Utf8::decode( chains[ index ] + sizeof( uint32_t ) );
+
+      result = Folding::apply( word );
+      if ( result.empty() )
+        result = Folding::applyWhitespaceOnly( word );
+    }
+
+    return result;
+  }
+
+  sptr< Node const > node; // Keeps the chains alive
+  vector< char const * > chains;
+  vector< wstring > folded;
+};
+
+} // namespace
+
+vector< vector< WordArticleLink > >
+BtreeIndex::findArticlesBatch( vector< wstring > const & words, bool ignoreDiacritics, uint32_t maxMatchCount )
+{
+  vector< vector< WordArticleLink > > results( words.size() );
+
+  // Sort the folded words, so the ones in the same leaf come one after another
+  vector< pair< wstring, size_t > > keys;
+  keys.reserve( words.size() );
+
+  for ( size_t x = 0; x < words.size(); ++x ) {
+    wstring word   = gd::removeTrailingZero( words[ x ] );
+    wstring folded = Folding::apply( word );
+    if ( folded.empty() )
+      folded = Folding::applyWhitespaceOnly( word );
+
+    // An empty word doesn't match anything, just like in findArticles()
+    if ( !folded.empty() )
+      keys.emplace_back( folded, x );
+  }
+
+  std::sort( keys.begin(), keys.end() );
+
+  LeafChains leaf;
+  bool haveLeaf = false;
+
+  for ( auto const & key : keys ) {
+    vector< WordArticleLink > & result = results[ key.second ];
+
+    try {
+      char const * chainOffset = nullptr;
+
+      if ( haveLeaf && leaf.covers( key.first ) )
+        chainOffset = leaf.find( key.first );
+      else {
+        bool exactMatch;
+        sptr< Node const > node;
+        uint32_t nextLeaf;
+        char const * leafEnd;
+
+        chainOffset = findChainOffsetExactOrPrefix( key.first, exactMatch, node, nextLeaf, leafEnd );
+        if ( !exactMatch )
+          chainOffset = nullptr;
+
+        leaf.reset( node );
+        haveLeaf = true;
+      }
+
+      if ( chainOffset ) {
+        result = readChain( chainOffset, maxMatchCount );
+
+        antialias( gd::removeTrailingZero( words[ key.second ] ), result, ignoreDiacritics );
+      }
+    }
+    catch ( std::exception & e ) {
+      gdWarning( "Articles searching failed, error: %s\n", e.what() );
+      result.clear();
+      haveLeaf = false;
+    }
+    catch ( ... ) {
+      qWarning( "Articles searching failed\n" );
+      result.clear();
+      haveLeaf = false;
+    }
+  }
+
+  return results;
+}
+
+vector< WordArticleLink >
+BtreeIndex::findArticlesWithAlts( wstring const & word, vector< wstring > const & alts, bool ignoreDiacritics )
+{
+  vector< wstring > words;
+  words.reserve( alts.size() + 1 );
+  words.push_back( word );
+  words.insert( words.end(), alts.begin(), alts.end() );
+
+  vector< vector< WordArticleLink > > chains = findArticlesBatch( words, ignoreDiacritics );
+
+  vector< WordArticleLink > result;
+
+  for ( auto & chain : chains )
+    result.insert( result.end(), chain.begin(), chain.end() );
+
+  return result;
+}
 
 BtreeWordSearchRequest::BtreeWordSearchRequest( BtreeDictionary & dict_,
                                                 wstring const & str_,
@@ -117,7 +470,7 @@ BtreeWordSearchRequest::BtreeWordSearchRequest( BtreeDictionary & dict_,
   allowMiddleMatches( allowMiddleMatches_ )
 {
   if ( startRunnable ) {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -241,10 +594,13 @@ void BtreeWordSearchRequest::findMatches()
       charsLeftToChop = maxSuffixVariation;
   }
 
+  // Reused for every chain visited
+  wstring chainHead, resultFolded, prefixFolded;
+
   try {
     for ( ;; ) {
       bool exactMatch;
-      vector< char > leaf;
+      sptr< Node const > leaf;
       uint32_t nextLeaf;
       char const * leafEnd;
 
@@ -259,9 +615,9 @@ void BtreeWordSearchRequest::findMatches()
 
           vector< WordArticleLink > chain = dict.readChain( chainOffset );
 
-          wstring chainHead = Utf8::decode( chain[ 0 ].word );
+          chainHead = Utf8::decode( chain[ 0 ].word );
 
-          wstring resultFolded = Folding::apply( chainHead );
+          Folding::apply( chainHead.data(), chainHead.size(), resultFolded );
           if ( resultFolded.empty() )
             resultFolded = Folding::applyWhitespaceOnly( chainHead );
 
@@ -285,7 +641,15 @@ void BtreeWordSearchRequest::findMatches()
               else {
                 // Skip middle matches, if requested. If suffix variation is specified,
                 // make sure the string isn't larger than requested.
-                if ( ( allowMiddleMatches || Folding::apply( Utf8::decode( x.prefix ) ).empty() )
+                bool middleMatch = false;
+
+                if ( !allowMiddleMatches && !x.prefix.empty() ) {
+                  wstring prefix = Utf8::decode( x.prefix );
+                  Folding::apply( prefix.data(), prefix.size(), prefixFolded );
+                  middleMatch = !prefixFolded.empty();
+                }
+
+                if ( !middleMatch
                      && ( maxSuffixVariation < 0
                           || (int)resultFolded.size() - initialFoldedSize <= maxSuffixVariation ) )
                   addMatch( Utf8::decode( x.prefix + x.word ) );
@@ -314,15 +678,13 @@ void BtreeWordSearchRequest::findMatches()
             //GD_DPRINTF( "advancing\n" );
 
             if ( nextLeaf ) {
-              QMutexLocker _( dict.idxFileMutex );
-
-              dict.readNode( nextLeaf, leaf );
-              leafEnd = &leaf.front() + leaf.size();
+              leaf    = dict.readNode( nextLeaf );
+              leafEnd = leaf->data.data() + leaf->data.size();
 
-              nextLeaf    = dict.idxFile->read< uint32_t >();
-              chainOffset = &leaf.front() + sizeof( uint32_t );
+              nextLeaf    = leaf->nextLeaf;
+              chainOffset = leaf->data.data() + sizeof( uint32_t );
 
-              uint32_t leafEntries = *(uint32_t *)&leaf.front();
+              uint32_t leafEntries = *(uint32_t *)leaf->data.data();
 
               if ( leafEntries == 0xffffFFFF ) {
                 //GD_DPRINTF( "bah!\n" );
@@ -394,37 +756,97 @@ sptr< Dictionary::WordSearchRequest > BtreeDictionary::stemmedMatch( wstring con
                                                      maxResults );
 }
 
-void BtreeIndex::readNode( uint32_t offset, vector< char > & out )
+sptr< Node const > BtreeIndex::readNode( uint32_t offset )
 {
-  idxFile->seek( offset );
+  NodeCache & cache = NodeCache::instance();
+
+  if ( auto cached = cache.find( cacheId, offset ) )
+    return cached;
+
+  uint32_t uncompressedSize;
+  uint32_t compressedSize;
+  unsigned char const * compressedData;
+  vector< unsigned char > compressedBuffer;
+
+  // Leaves are followed by the offset of the next leaf. We don't know yet
+  // whether this is a leaf, and a node may well be the last thing in the
+  // file, so a missing value is not an error here.
+  uint32_t nextLeaf = 0;
+
+  if ( idxMapping ) {
+    // Positional read straight from the mapping, no locking needed
+    if ( (qint64)offset + 2 * sizeof( uint32_t ) > idxMappingSize )
+      throw exNodeOutOfRange();
+
+    memcpy( &uncompressedSize, idxMapping + offset, sizeof( uint32_t ) );
+    memcpy( &compressedSize, idxMapping + offset + sizeof( uint32_t ), sizeof( uint32_t ) );
+
+    qint64 dataOffset = (qint64)offset + 2 * sizeof( uint32_t );
+
+    if ( dataOffset + compressedSize > idxMappingSize )
+      throw exNodeOutOfRange();
+
+    compressedData = idxMapping + dataOffset;
 
-  uint32_t uncompressedSize = idxFile->read< uint32_t >();
-  uint32_t compressedSize   = idxFile->read< uint32_t >();
+    if ( dataOffset + compressedSize + (qint64)sizeof( uint32_t ) <= idxMappingSize )
+      memcpy( &nextLeaf, compressedData + compressedSize, sizeof( uint32_t ) );
+  }
+  else {
+    QMutexLocker _( idxFileMutex );
+
+    idxFile->seek( offset );
+
+    uncompressedSize = idxFile->read< uint32_t >();
+    compressedSize   = idxFile->read< uint32_t >();
 
-  //GD_DPRINTF( "%x,%x\n", uncompressedSize, compressedSize );
+    //GD_DPRINTF( "%x,%x\n", uncompressedSize, compressedSize );
 
-  out.resize( uncompressedSize );
+    compressedBuffer.resize( compressedSize );
 
-  vector< unsigned char > compressedData( compressedSize );
+    idxFile->read( compressedBuffer.data(), compressedBuffer.size() );
 
-  idxFile->read( &compressedData.front(), compressedData.size() );
+    compressedData = compressedBuffer.data();
 
-  unsigned long decompressedLength = out.size();
+    if ( idxFile->readRecords( &nextLeaf, sizeof( nextLeaf ), 1 ) != 1 )
+      nextLeaf = 0;
+  }
+
+  auto node = std::make_shared< Node >();
 
-  if ( uncompress( (unsigned char *)&out.front(), &decompressedLength, &compressedData.front(), compressedData.size() )
-         != Z_OK
-       || decompressedLength != out.size() )
+  node->data.resize( uncompressedSize );
+
+  if ( uncompressedSize < sizeof( uint32_t )
+       || !IndexCodec::decompress( nodeCodec, compressedData, compressedSize, node->data.data(), node->data.size() ) )
     throw exFailedToDecompressNode();
+
+  if ( *(uint32_t *)node->data.data() != 0xffffFFFF )
+    node->nextLeaf = nextLeaf;
+
+  cache.insert( cacheId, offset, node );
+
+  return node;
+}
+
+sptr< Node const > BtreeIndex::getRootNode()
+{
+  sptr< Node const > root = std::atomic_load( &rootNode );
+
+  if ( !root ) {
+    // Time to load our root node. We do it only once, at the first request.
+    // Should several threads race here, they would all get the same node.
+    root = readNode( rootOffset );
+    std::atomic_store( &rootNode, root );
+  }
+
+  return root;
 }
 
 char const * BtreeIndex::findChainOffsetExactOrPrefix(
-  wstring const & target, bool & exactMatch, vector< char > & extLeaf, uint32_t & nextLeaf, char const *& leafEnd )
+  wstring const & target, bool & exactMatch, sptr< Node const > & extLeaf, uint32_t & nextLeaf, char const *& leafEnd )
 {
   if ( !idxFile )
     throw exIndexWasNotOpened();
 
-  QMutexLocker _( idxFileMutex );
-
   // Lookup the index by traversing the index btree
 
   // vector< wchar > wcharBuffer;
@@ -435,14 +857,10 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix(
 
   uint32_t currentNodeOffset = rootOffset;
 
-  if ( !rootNodeLoaded ) {
-    // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
-  }
+  extLeaf = getRootNode();
 
-  char const * leaf = &rootNode.front();
-  leafEnd           = leaf + rootNode.size();
+  char const * leaf = extLeaf->data.data();
+  leafEnd           = leaf + extLeaf->data.size();
 
   if ( target.empty() ) {
     //For empty target string we return first chain in index
@@ -452,17 +870,15 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix(
       if ( leafEntries == 0xffffFFFF ) {
         // A node
         currentNodeOffset = *( (uint32_t *)leaf + 1 );
-        readNode( currentNodeOffset, extLeaf );
-        leaf     = &extLeaf.front();
-        leafEnd  = leaf + extLeaf.size();
-        nextLeaf = idxFile->read< uint32_t >();
+        extLeaf           = readNode( currentNodeOffset );
+        leaf              = extLeaf->data.data();
+        leafEnd           = leaf + extLeaf->data.size();
       }
       else {
         // A leaf
-        if ( currentNodeOffset == rootOffset ) {
-          // Only one leaf in index, there's no next leaf
-          nextLeaf = 0;
-        }
+        // Only one leaf in index, there's no next leaf
+        nextLeaf = ( currentNodeOffset != rootOffset ? extLeaf->nextLeaf : 0 );
+
         if ( !leafEntries )
           return nullptr;
 
@@ -562,18 +978,16 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix(
       }
 
       //GD_DPRINTF( "reading node at %x\n", currentNodeOffset );
-      readNode( currentNodeOffset, extLeaf );
-      leaf    = &extLeaf.front();
-      leafEnd = leaf + extLeaf.size();
+      extLeaf = readNode( currentNodeOffset );
+      leaf    = extLeaf->data.data();
+      leafEnd = leaf + extLeaf->data.size();
     }
     else {
       //GD_DPRINTF( "=>a leaf\n" );
       // A leaf
 
       // If this leaf is the root, there's no next leaf, it just can't be.
-      // We do this check because the file's position indicator just won't
-      // be in the right place for root node anyway, since we precache it.
-      nextLeaf = ( currentNodeOffset != rootOffset ? idxFile->read< uint32_t >() : 0 );
+      nextLeaf = ( currentNodeOffset != rootOffset ? extLeaf->nextLeaf : 0 );
 
       if ( !leafEntries ) {
         // Empty leaf? This may only be possible for entirely empty trees only.
@@ -661,13 +1075,13 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix(
             // would mean the first element in the next leaf.
             if ( chainToCheck == &chainOffsets.back() ) {
               if ( nextLeaf ) {
-                readNode( nextLeaf, extLeaf );
+                extLeaf = readNode( nextLeaf );
 
-                leafEnd = &extLeaf.front() + extLeaf.size();
+                leafEnd = extLeaf->data.data() + extLeaf->data.size();
 
-                nextLeaf = idxFile->read< uint32_t >();
+                nextLeaf = extLeaf->nextLeaf;
 
-                return &extLeaf.front() + sizeof( uint32_t );
+                return extLeaf->data.data() + sizeof( uint32_t );
               }
               else
                 return nullptr; // This was the last leaf
@@ -756,6 +1170,7 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
                                 size_t indexSize,
                                 File::Class & file,
                                 size_t maxElements,
+                                IndexCodec::Codec codec,
                                 uint32_t & lastLeafLinkOffset )
 {
   // We compress all the node data. This buffer would hold it.
@@ -824,7 +1239,8 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
     for ( unsigned x = 0; x < maxElements; ++x ) {
       unsigned curEntry = (uint64_t)indexSize * ( x + 1 ) / ( maxElements + 1 );
 
-      uint32_t offset = buildBtreeNode( nextIndex, curEntry - prevEntry, file, maxElements, lastLeafLinkOffset );
+      uint32_t offset =
+        buildBtreeNode( nextIndex, curEntry - prevEntry, file, maxElements, codec, lastLeafLinkOffset );
 
       memcpy( &uncompressedData.front() + sizeof( uint32_t ) + x * sizeof( uint32_t ), &offset, sizeof( uint32_t ) );
 
@@ -839,19 +1255,20 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
     }
 
     // Rightmost child
-    uint32_t offset = buildBtreeNode( nextIndex, indexSize - prevEntry, file, maxElements, lastLeafLinkOffset );
+    uint32_t offset =
+      buildBtreeNode( nextIndex, indexSize - prevEntry, file, maxElements, codec, lastLeafLinkOffset );
     memcpy( &uncompressedData.front() + sizeof( uint32_t ) + maxElements * sizeof( uint32_t ),
             &offset,
             sizeof( offset ) );
   }
 
   // Save the result.
-  vector< unsigned char > compressedData( compressBound( uncompressedData.size() ) );
+  vector< unsigned char > compressedData;
 
-  unsigned long compressedSize = compressedData.size();
-
-  if ( compress( &compressedData.front(), &compressedSize, &uncompressedData.front(), uncompressedData.size() )
-       != Z_OK ) {
+  try {
+    IndexCodec::compress( codec, uncompressedData.data(), uncompressedData.size(), compressedData );
+  }
+  catch ( IndexCodec::Ex & ) {
     qFatal( "Failed to compress btree node." );
     abort();
   }
@@ -859,8 +1276,8 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
   uint32_t offset = file.tell();
 
   file.write< uint32_t >( uncompressedData.size() );
-  file.write< uint32_t >( compressedSize );
-  file.write( &compressedData.front(), compressedSize );
+  file.write< uint32_t >( compressedData.size() );
+  file.write( compressedData.data(), compressedData.size() );
 
   if ( isLeaf ) {
     // A link to the next leef, which is zero and which will be updated
@@ -914,6 +1331,8 @@ void IndexedWords::addWord( wstring const & index_word, uint32_t articleOffset,
 
   int wordsAdded = 0; // Number of stored parts
 
+  wstring foldedPart; // Reused for every part
+
   for ( ;; ) {
     // Skip any whitespace/punctuation
     for ( ;; ++nextChar ) {
@@ -937,8 +1356,8 @@ void IndexedWords::addWord( wstring const & index_word, uint32_t articleOffset,
     }
 
     // Insert this word
-    wstring folded = Folding::apply( nextChar );
-    auto name      = Utf8::encode( folded );
+    Folding::apply( nextChar, std::char_traits< wchar >::length( nextChar ), foldedPart );
+    auto name = Utf8::encode( foldedPart );
 
     auto i = insert( { std::move( name ), vector< WordArticleLink >() } ).first;
 
@@ -1004,9 +1423,13 @@ IndexInfo buildIndex( IndexedWords const & indexedWords, File::Class & file )
 
   uint32_t lastLeafOffset = 0;
 
-  uint32_t rootOffset = buildBtreeNode( nextIndex, indexSize, file, btreeMaxElements, lastLeafOffset );
+  // Nodes are small and read one at a time, so unlike the chunks they
+  // don't get a trained dictionary.
+  IndexCodec::Codec codec = IndexCodec::preferred();
 
-  return IndexInfo( btreeMaxElements, rootOffset );
+  uint32_t rootOffset = buildBtreeNode( nextIndex, indexSize, file, btreeMaxElements, codec, lastLeafOffset );
+
+  return IndexInfo( btreeMaxElements | ( (uint32_t)codec << 24 ), rootOffset );
 }
 
 void BtreeIndex::getAllHeadwords( QSet< QString > & headwords )
@@ -1036,20 +1459,12 @@ void BtreeIndex::findArticleLinks( QVector< WordArticleLink > * articleLinks,
   uint32_t nextLeaf          = 0;
   uint32_t leafEntries;
 
-  QMutexLocker _( idxFileMutex );
-
-  if ( !rootNodeLoaded ) {
-    // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
-  }
+  sptr< Node const > extLeaf = getRootNode();
 
-  char const * leaf     = &rootNode.front();
-  char const * leafEnd  = leaf + rootNode.size();
+  char const * leaf     = extLeaf->data.data();
+  char const * leafEnd  = leaf + extLeaf->data.size();
   char const * chainPtr = nullptr;
 
-  vector< char > extLeaf;
-
   // Find first leaf
 
   for ( ;; ) {
@@ -1061,10 +1476,10 @@ void BtreeIndex::findArticleLinks( QVector< WordArticleLink > * articleLinks,
     if ( leafEntries == 0xffffFFFF ) {
       // A node
       currentNodeOffset = *( (uint32_t *)leaf + 1 );
-      readNode( currentNodeOffset, extLeaf );
-      leaf     = &extLeaf.front();
-      leafEnd  = leaf + extLeaf.size();
-      nextLeaf = idxFile->read< uint32_t >();
+      extLeaf           = readNode( currentNodeOffset );
+      leaf              = extLeaf->data.data();
+      leafEnd           = leaf + extLeaf->data.size();
+      nextLeaf          = extLeaf->nextLeaf;
     }
     else {
       // A leaf
@@ -1128,11 +1543,86 @@ void BtreeIndex::findArticleLinks( QVector< WordArticleLink > * articleLinks,
       // We're past the current leaf, fetch the next one
 
       if ( nextLeaf ) {
-        readNode( nextLeaf, extLeaf );
-        leaf    = &extLeaf.front();
-        leafEnd = leaf + extLeaf.size();
+        extLeaf = readNode( nextLeaf );
+        leaf    = extLeaf->data.data();
+        leafEnd = leaf + extLeaf->data.size();
 
-        nextLeaf = idxFile->read< uint32_t >();
+        nextLeaf = extLeaf->nextLeaf;
+        chainPtr = leaf + sizeof( uint32_t );
+
+        leafEntries = *(uint32_t *)leaf;
+
+        if ( leafEntries == 0xffffFFFF )
+          throw exCorruptedChainData();
+      }
+      else
+        break; // That was the last leaf
+    }
+  }
+}
+
+void BtreeIndex::forEachArticleLink( std::function< void( WordArticleLink const & ) > const & callback,
+                                    QAtomicInt * isCancelled )
+{
+  uint32_t currentNodeOffset = rootOffset;
+  uint32_t nextLeaf          = 0;
+  uint32_t leafEntries;
+
+  sptr< Node const > extLeaf = getRootNode();
+
+  char const * leaf     = extLeaf->data.data();
+  char const * leafEnd  = leaf + extLeaf->data.size();
+  char const * chainPtr = nullptr;
+
+  // Find first leaf
+
+  for ( ;; ) {
+    leafEntries = *(uint32_t *)leaf;
+
+    if ( isCancelled && Utils::AtomicInt::loadAcquire( *isCancelled ) )
+      return;
+
+    if ( leafEntries == 0xffffFFFF ) {
+      // A node
+      currentNodeOffset = *( (uint32_t *)leaf + 1 );
+      extLeaf           = readNode( currentNodeOffset );
+      leaf              = extLeaf->data.data();
+      leafEnd           = leaf + extLeaf->data.size();
+      nextLeaf          = extLeaf->nextLeaf;
+    }
+    else {
+      // A leaf
+      chainPtr = leaf + sizeof( uint32_t );
+      break;
+    }
+  }
+
+  if ( !leafEntries ) {
+    // Empty leaf? This may only be possible for entirely empty trees only.
+    if ( currentNodeOffset != rootOffset )
+      throw exCorruptedChainData();
+    else
+      return; // No match
+  }
+
+  // Read all chains
+
+  for ( ;; ) {
+    if ( isCancelled && Utils::AtomicInt::loadAcquire( *isCancelled ) )
+      return;
+
+    for ( auto const & i : readChain( chainPtr ) )
+      callback( i );
+
+    if ( chainPtr >= leafEnd ) {
+      // We're past the current leaf, fetch the next one
+
+      if ( nextLeaf ) {
+        extLeaf = readNode( nextLeaf );
+        leaf    = extLeaf->data.data();
+        leafEnd = leaf + extLeaf->data.size();
+
+        nextLeaf = extLeaf->nextLeaf;
         chainPtr = leaf + sizeof( uint32_t );
 
         leafEntries = *(uint32_t *)leaf;
@@ -1165,18 +1655,14 @@ void BtreeIndex::findSingleNodeHeadwords( uint32_t offsets, QSet< QString > * he
 {
   uint32_t currentNodeOffset = offsets;
 
-  QMutexLocker _( idxFileMutex );
-
   char const * leaf     = nullptr;
   char const * leafEnd  = nullptr;
   char const * chainPtr = nullptr;
 
-  vector< char > extLeaf;
-
   // A node
-  readNode( currentNodeOffset, extLeaf );
-  leaf    = &extLeaf.front();
-  leafEnd = leaf + extLeaf.size();
+  sptr< Node const > extLeaf = readNode( currentNodeOffset );
+  leaf                       = extLeaf->data.data();
+  leafEnd                    = leaf + extLeaf->data.size();
 
   // A leaf
   chainPtr = leaf + sizeof( uint32_t );
@@ -1199,15 +1685,9 @@ void BtreeIndex::findSingleNodeHeadwords( uint32_t offsets, QSet< QString > * he
 //find the next chain ptr ,which is large than this currentChainPtr
 QSet< uint32_t > BtreeIndex::findNodes()
 {
-  QMutexLocker _( idxFileMutex );
-
-  if ( !rootNodeLoaded ) {
-    // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
-  }
+  sptr< Node const > root = getRootNode();
 
-  char const * leaf = &rootNode.front();
+  char const * leaf = root->data.data();
   QSet< uint32_t > leafOffset;
 
   uint32_t leafEntries;
@@ -1239,20 +1719,12 @@ void BtreeIndex::getHeadwordsFromOffsets( QList< uint32_t > & offsets,
 
   std::sort( offsets.begin(), offsets.end() );
 
-  QMutexLocker _( idxFileMutex );
+  sptr< Node const > extLeaf = getRootNode();
 
-  if ( !rootNodeLoaded ) {
-    // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
-  }
-
-  char const * leaf     = &rootNode.front();
-  char const * leafEnd  = leaf + rootNode.size();
+  char const * leaf     = extLeaf->data.data();
+  char const * leafEnd  = leaf + extLeaf->data.size();
   char const * chainPtr = nullptr;
 
-  vector< char > extLeaf;
-
   // Find first leaf
 
   for ( ;; ) {
@@ -1264,10 +1736,10 @@ void BtreeIndex::getHeadwordsFromOffsets( QList< uint32_t > & offsets,
     if ( leafEntries == 0xffffFFFF ) {
       // A node
       currentNodeOffset = *( (uint32_t *)leaf + 1 );
-      readNode( currentNodeOffset, extLeaf );
-      leaf     = &extLeaf.front();
-      leafEnd  = leaf + extLeaf.size();
-      nextLeaf = idxFile->read< uint32_t >();
+      extLeaf           = readNode( currentNodeOffset );
+      leaf              = extLeaf->data.data();
+      leafEnd           = leaf + extLeaf->data.size();
+      nextLeaf          = extLeaf->nextLeaf;
     }
     else {
       // A leaf
@@ -1322,11 +1794,11 @@ void BtreeIndex::getHeadwordsFromOffsets( QList< uint32_t > & offsets,
       // We're past the current leaf, fetch the next one
 
       if ( nextLeaf ) {
-        readNode( nextLeaf, extLeaf );
-        leaf    = &extLeaf.front();
-        leafEnd = leaf + extLeaf.size();
+        extLeaf = readNode( nextLeaf );
+        leaf    = extLeaf->data.data();
+        leafEnd = leaf + extLeaf->data.size();
 
-        nextLeaf = idxFile->read< uint32_t >();
+        nextLeaf = extLeaf->nextLeaf;
         chainPtr = leaf + sizeof( uint32_t );
 
         leafEntries = *(uint32_t *)leaf;
@@ -1375,4 +1847,26 @@ void BtreeDictionary::findHeadWordsWithLenth( int & index, QSet< QString > * hea
 
 void BtreeDictionary::getArticleText( uint32_t, QString &, QString & ) {}
 
+bool isCodecSupported( uint32_t btreeMaxElements )
+{
+  return IndexCodec::isSupported( btreeMaxElements >> 24 );
+}
+
+uint32_t formatVersionToWrite( uint32_t currentFormatVersion, uint32_t btreeMaxElements )
+{
+  // The chunks were compressed with the codec preferred when the building
+  // began, which may differ from the btree's if the preference has changed
+  // meanwhile
+  uint32_t const codec = std::max< uint32_t >( btreeMaxElements >> 24, IndexCodec::preferred() );
+
+  return currentFormatVersion + codec * CodecFormatVersionStep;
+}
+
+bool isCurrentFormatVersion( uint32_t formatVersion, uint32_t currentFormatVersion )
+{
+  uint32_t const codecPart = formatVersion - currentFormatVersion;
+
+  return codecPart % CodecFormatVersionStep == 0 && IndexCodec::isSupported( codecPart / CodecFormatVersionStep );
+}
+
 } // namespace BtreeIndexing
@@ -6,14 +6,15 @@
 
 #include "dict/dictionary.hh"
 #include "file.hh"
+#include "scheduler.hh"
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
-#include <QFuture>
 #include <QList>
 #include <QSet>
 #include <QVector>
@@ -32,7 +33,10 @@ enum {
   /// This is to be bumped up each time the internal format changes.
   /// The value isn't used here by itself, it is supposed to be added
   /// to each dictionary's internal format version.
-  FormatVersion = 4
+  FormatVersion = 4,
+
+  /// The format version of an index is raised by this times its codec
+  CodecFormatVersionStep = 0x10000
 };
 
 // These exceptions which might be thrown during the index traversal
@@ -40,6 +44,7 @@ enum {
 DEF_EX( exIndexWasNotOpened, "The index wasn't opened", Dictionary::Ex )
 DEF_EX( exFailedToDecompressNode, "Failed to decompress a btree's node", Dictionary::Ex )
 DEF_EX( exCorruptedChainData, "Corrupted chain data in the leaf of a btree encountered", Dictionary::Ex )
+DEF_EX( exNodeOutOfRange, "A btree's node lies outside of the index file", Dictionary::Ex )
 
 /// This structure describes a word linked to its translation. The
 /// translation is represented as an abstract 32-bit offset.
@@ -61,6 +66,9 @@ struct WordArticleLink
 /// Information needed to open the index
 struct IndexInfo
 {
+  /// The lower 24 bits hold the max number of elements in a node, the upper
+  /// 8 bits the IndexCodec the nodes are compressed with. The formats store
+  /// this value as is, so the indices built with zlib are unaffected.
   uint32_t btreeMaxElements, rootOffset;
 
   IndexInfo( uint32_t btreeMaxElements_, uint32_t rootOffset_ ):
@@ -70,6 +78,36 @@ struct IndexInfo
   }
 };
 
+/// A decompressed btree node or leaf. Instances are immutable once built and
+/// are shared between all the lookups through the process-wide node cache.
+struct Node
+{
+  vector< char > data;
+
+  /// For leaves, the offset of the next leaf, or 0 if this is the last one.
+  /// Always 0 for non-leaf nodes.
+  uint32_t nextLeaf = 0;
+};
+
+/// Usage counters of the decompressed node cache, to help sizing it. They're
+/// logged on exit, and the budget comes from the indexNodeCacheSize preference.
+struct NodeCacheStats
+{
+  uint64_t hits      = 0;
+  uint64_t misses    = 0;
+  uint64_t evictions = 0;
+  size_t nodes       = 0;
+  size_t bytesUsed   = 0;
+  size_t bytesBudget = 0;
+};
+
+/// Returns the current counters of the decompressed node cache.
+NodeCacheStats getNodeCacheStats();
+
+/// Changes the memory budget of the decompressed node cache, in bytes.
+/// Setting it to zero disables caching altogether.
+void setNodeCacheBudget( size_t bytes );
+
 /// Base btree indexing class which allows using what buildIndex() function
 /// created. It's quite low-lovel and is basically a set of 'building blocks'
 /// functions.
@@ -81,13 +119,28 @@ public:
 
   /// Opens the index. The file reference is saved to be used for
   /// subsequent lookups.
-  /// The mutex is the one to be locked when working with the file.
+  /// The mutex is the one to be locked when working with the file. The index
+  /// file is memory-mapped if possible, in which case lookups read it
+  /// directly and don't need the mutex at all.
   void openIndex( IndexInfo const &, File::Class &, QMutex & );
 
   /// Finds articles that match the given string. A case-insensitive search
   /// is performed.
   vector< WordArticleLink > findArticles( wstring const &, bool ignoreDiacritics = false, uint32_t maxMatchCount = -1 );
 
+  /// Does what findArticles() does for each of the given words, returning
+  /// the results in the same order. The words are looked up in the order of
+  /// the index, so the ones landing in the same leaf share a single descent
+  /// of the btree.
+  vector< vector< WordArticleLink > > findArticlesBatch( vector< wstring > const &,
+                                                         bool ignoreDiacritics = false,
+                                                         uint32_t maxMatchCount = -1 );
+
+  /// Finds the articles for the word followed by the ones for its alternate
+  /// writings, in a single batch.
+  vector< WordArticleLink >
+  findArticlesWithAlts( wstring const & word, vector< wstring > const & alts, bool ignoreDiacritics = false );
+
   /// Find all unique article links in the index
   void findAllArticleLinks( QVector< WordArticleLink > & articleLinks );
 
@@ -100,6 +153,10 @@ public:
                          QSet< QString > * headwords,
                          QAtomicInt * isCancelled = 0 );
 
+  /// Calls the given function for each article link in the index, in the
+  /// order of the index, without collecting them all in memory
+  void forEachArticleLink( std::function< void( WordArticleLink const & ) > const &, QAtomicInt * isCancelled = 0 );
+
   void findHeadWords( QSet< uint32_t > offsets, int & index, QSet< QString > * headwords, uint32_t length );
   void findSingleNodeHeadwords( uint32_t offsets, QSet< QString > * headwords );
   QSet< uint32_t > findNodes();
@@ -116,18 +173,21 @@ protected:
   /// match. The input string must already be folded. The exactMatch is set
   /// to true when an exact match is located, and to false otherwise.
   /// The located leaf is loaded to 'leaf', and the pointer to the next
-  /// leaf is saved to 'nextLeaf'.
-  /// However, due to root node being permanently cached, the 'leaf' passed
-  /// might not get used at all if the root node was the terminal one. In that
-  /// case, the returned pointer wouldn't belong to 'leaf' at all. To that end,
-  /// the leafEnd pointer always holds the pointer to the first byte outside
+  /// leaf is saved to 'nextLeaf'. The returned pointer points inside the
+  /// 'leaf' data, so the caller has to keep 'leaf' alive while using it.
+  /// The leafEnd pointer always holds the pointer to the first byte outside
   /// the node data.
   char const * findChainOffsetExactOrPrefix(
-    wstring const & target, bool & exactMatch, vector< char > & leaf, uint32_t & nextLeaf, char const *& leafEnd );
+    wstring const & target, bool & exactMatch, sptr< Node const > & leaf, uint32_t & nextLeaf, char const *& leafEnd );
+
+  /// Reads a node or leaf at the given offset. The decompressed data is
+  /// looked up in the shared node cache first, and is put there if missing.
+  /// When the index file is mapped, this needs no locking. Otherwise, only
+  /// the file access itself is done under the index file mutex.
+  sptr< Node const > readNode( uint32_t offset );
 
-  /// Reads a node or leaf at the given offset. Just uncompresses its data
-  /// to the given vector and does nothing more.
-  void readNode( uint32_t offset, vector< char > & out );
+  /// Returns the root node, loading it on first use.
+  sptr< Node const > getRootNode();
 
   /// Reads the word-article links' chain at the given offset. The pointer
   /// is updated to point to the next chain, if there's any.
@@ -145,10 +205,17 @@ protected:
 private:
 
   uint32_t indexNodeSize;
+  uint32_t nodeCodec;
   uint32_t rootOffset;
-  bool rootNodeLoaded;
-  vector< char > rootNode; // We load root note here and keep it at all times,
-                           // since all searches always start with it.
+  uint32_t cacheId; // Identifies this opened index in the node cache
+
+  // The whole index file mapped to memory, or nullptr if it couldn't be
+  uchar const * idxMapping;
+  qint64 idxMappingSize;
+
+  sptr< Node const > rootNode; // We load root note here and keep it at all times,
+                               // since all searches always start with it.
+                               // Only accessed with std::atomic_load/store.
 };
 
 /// A base for the dictionary that utilizes a btree index build using
@@ -169,6 +236,11 @@ public:
   /// need not to implement this function.
   virtual sptr< Dictionary::WordSearchRequest > prefixMatch( wstring const &, unsigned long );
 
+  virtual bool prefixMatchNarrowsDown()
+  {
+    return true;
+  }
+
   virtual sptr< Dictionary::WordSearchRequest >
   stemmedMatch( wstring const &, unsigned minLength, unsigned maxSuffixVariation, unsigned long maxResults );
 
@@ -231,7 +303,7 @@ protected:
   int maxSuffixVariation;
   bool allowMiddleMatches;
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -250,6 +322,9 @@ public:
   virtual void cancel()
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~BtreeWordSearchRequest();
@@ -278,6 +353,22 @@ struct IndexedWords: public map< string, vector< WordArticleLink > >
 /// position.
 IndexInfo buildIndex( IndexedWords const &, File::Class & file );
 
+/// Returns true if this build can read the btree whose IndexInfo holds the
+/// given btreeMaxElements, that is, supports the codec it was compressed
+/// with. The formats use this to rebuild the indexes they can't open.
+bool isCodecSupported( uint32_t btreeMaxElements );
+
+/// Returns the format version to write into the header of an index being
+/// built, given the current format version of its dictionary and the
+/// btreeMaxElements of its main btree. The indexes compressed with a codec
+/// other than zlib get a version of their own, so that the older builds,
+/// which only know zlib, rebuild them instead of misreading them.
+uint32_t formatVersionToWrite( uint32_t currentFormatVersion, uint32_t btreeMaxElements );
+
+/// Returns true if the format version read from an index header is the
+/// current one for any of the codecs this build supports.
+bool isCurrentFormatVersion( uint32_t formatVersion, uint32_t currentFormatVersion );
+
 } // namespace BtreeIndexing
 
 #endif
@@ -2,7 +2,8 @@
  * Part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
 
 #include "chunkedstorage.hh"
-#include <zlib.h>
+#include <algorithm>
+#include <numeric>
 #include <string.h>
 #include <QDataStream>
 #include <QScopeGuard>
@@ -11,13 +12,24 @@
 namespace ChunkedStorage {
 
 enum {
-  ChunkMaxSize = 65536 // Can't be more since it would overflow the address
+  ChunkMaxSize = 65536, // Can't be more since it would overflow the address
+
+  /// Begins the chunk table of the codecs other than zlib. It can't be
+  /// mistaken for the number of chunks, which is limited by ChunkMaxSize.
+  ExtendedTableMarker = 0xffffFFFF,
+
+  /// How much data to collect before training the dictionary on it
+  DictionaryTrainingSize = 2 * 1024 * 1024,
+  DictionaryMaxSize      = 32 * 1024
 };
 
 Writer::Writer( File::Class & f ):
   file( f ),
   chunkStarted( false ),
-  bufferUsed( 0 )
+  bufferUsed( 0 ),
+  codec( IndexCodec::preferred() ),
+  training( codec == IndexCodec::Zstd ),
+  pendingSize( 0 )
 {
   // Create a sratchpad at the beginning of file. We use it to write chunk
   // table if it would fit, in order to save some seek times.
@@ -41,10 +53,13 @@ uint32_t Writer::startNewBlock()
 
   chunkStarted = true;
 
+  if ( training )
+    sampleSizes.push_back( 0 );
+
   // The address is comprised of the offset within the chunk (in lower
   // 16 bits, always fits there since ChunkMaxSize-1 does) and the
   // number of the chunk, which is therefore limited to be 65535 max.
-  return bufferUsed | ( (uint32_t)offsets.size() << 16 );
+  return bufferUsed | ( (uint32_t)( offsets.size() + pendingChunks.size() ) << 16 );
 }
 
 void Writer::addToBlock( void const * data, size_t size )
@@ -59,30 +74,68 @@ void Writer::addToBlock( void const * data, size_t size )
 
   bufferUsed += size;
 
+  if ( training && !sampleSizes.empty() )
+    sampleSizes.back() += size;
+
   chunkStarted = false;
 }
 
 void Writer::saveCurrentChunk()
 {
-  size_t maxCompressedSize = compressBound( bufferUsed );
+  if ( training ) {
+    pendingChunks.emplace_back( buffer.begin(), buffer.begin() + bufferUsed );
+    pendingSize += bufferUsed;
 
-  if ( bufferCompressed.size() < maxCompressedSize )
-    bufferCompressed.resize( maxCompressedSize );
+    if ( pendingSize >= DictionaryTrainingSize )
+      trainDictionary();
+  }
+  else
+    writeChunk( buffer.data(), bufferUsed );
 
-  unsigned long compressedSize = bufferCompressed.size();
+  bufferUsed = 0;
+
+  chunkStarted = false;
+}
 
-  if ( compress( &bufferCompressed.front(), &compressedSize, &buffer.front(), bufferUsed ) != Z_OK )
+void Writer::writeChunk( unsigned char const * data, size_t size )
+{
+  try {
+    IndexCodec::compress( codec, data, size, bufferCompressed, dictionary.get() );
+  }
+  catch ( IndexCodec::Ex & ) {
     throw exFailedToCompressChunk();
+  }
 
   offsets.push_back( file.tell() );
 
-  file.write( (uint32_t)bufferUsed );
-  file.write( (uint32_t)compressedSize );
-  file.write( &bufferCompressed.front(), compressedSize );
+  file.write( (uint32_t)size );
+  file.write( (uint32_t)bufferCompressed.size() );
+  file.write( bufferCompressed.data(), bufferCompressed.size() );
+}
 
-  bufferUsed = 0;
+void Writer::trainDictionary()
+{
+  training = false;
 
-  chunkStarted = false;
+  vector< char > samples;
+  samples.reserve( pendingSize );
+
+  for ( auto const & chunk : pendingChunks )
+    samples.insert( samples.end(), chunk.begin(), chunk.end() );
+
+  // Each block makes a sample, except the empty ones
+  sampleSizes.erase( std::remove( sampleSizes.begin(), sampleSizes.end(), 0 ), sampleSizes.end() );
+
+  if ( std::accumulate( sampleSizes.begin(), sampleSizes.end(), (size_t)0 ) == samples.size() )
+    dictionary = IndexCodec::TrainedDictionary::train( samples, sampleSizes, DictionaryMaxSize );
+
+  // Without a dictionary, the chunks are still compressed with the codec
+  for ( auto const & chunk : pendingChunks )
+    writeChunk( chunk.data(), chunk.size() );
+
+  pendingChunks.clear();
+  pendingSize = 0;
+  sampleSizes.clear();
 }
 
 uint32_t Writer::finish()
@@ -90,10 +143,20 @@ uint32_t Writer::finish()
   if ( bufferUsed || chunkStarted )
     saveCurrentChunk();
 
+  if ( training )
+    trainDictionary();
+
+  uint32_t dictionarySize = dictionary ? dictionary->data().size() : 0;
+
+  size_t tableSize = offsets.size() * sizeof( uint32_t ) + sizeof( uint32_t );
+
+  if ( codec != IndexCodec::Zlib )
+    tableSize += 3 * sizeof( uint32_t ) + dictionarySize;
+
   bool useScratchPad   = false;
   uint32_t savedOffset = 0;
 
-  if ( scratchPadSize >= offsets.size() * sizeof( uint32_t ) + sizeof( uint32_t ) ) {
+  if ( scratchPadSize >= tableSize ) {
     useScratchPad = true;
     savedOffset   = file.tell();
     file.seek( scratchPadOffset );
@@ -101,6 +164,17 @@ uint32_t Writer::finish()
 
   uint32_t offset = file.tell();
 
+  if ( codec != IndexCodec::Zlib ) {
+    // zlib chunks keep the original table layout, so such indices stay
+    // readable by the older versions.
+    file.write( (uint32_t)ExtendedTableMarker );
+    file.write( (uint32_t)codec );
+    file.write( dictionarySize );
+
+    if ( dictionarySize )
+      file.write( dictionary->data().data(), dictionarySize );
+  }
+
   file.write( (uint32_t)offsets.size() );
 
   if ( offsets.size() )
@@ -116,67 +190,166 @@ uint32_t Writer::finish()
 }
 
 Reader::Reader( File::Class & f, uint32_t offset ):
-  file( f )
+  file( f ),
+  codec( IndexCodec::Zlib )
 {
   file.seek( offset );
 
   uint32_t size = file.read< uint32_t >();
+
+  if ( size == ExtendedTableMarker ) {
+    codec = file.read< uint32_t >();
+
+    if ( !IndexCodec::isSupported( codec ) )
+      throw IndexCodec::exUnsupportedCodec();
+
+    uint32_t dictionarySize = file.read< uint32_t >();
+
+    if ( dictionarySize ) {
+      vector< char > data( dictionarySize );
+      file.read( data.data(), data.size() );
+      dictionary = std::make_shared< IndexCodec::TrainedDictionary >( std::move( data ) );
+    }
+
+    size = file.read< uint32_t >();
+  }
+
   if ( size == 0 )
     return;
   offsets.resize( size );
   file.read( &offsets.front(), offsets.size() * sizeof( uint32_t ) );
 }
 
-char * Reader::getBlock( uint32_t address, vector< char > & chunk )
+Chunk Reader::loadChunk( size_t chunkIdx )
+{
+  uint32_t uncompressedSize;
+  uint32_t compressedSize;
+
+  auto chunk = std::make_shared< vector< char > >();
+
+  // The whole file stays mapped for as long as it is open, so normally
+  // there's no need to map and unmap anything here.
+  uchar const * mapping = file.mapAll();
+
+  if ( mapping ) {
+    qint64 chunkOffset = offsets[ chunkIdx ];
+
+    if ( chunkOffset + 8 > file.mappedSize() )
+      throw exAddressOutOfRange();
+
+    memcpy( &uncompressedSize, mapping + chunkOffset, sizeof( uint32_t ) );
+    memcpy( &compressedSize, mapping + chunkOffset + 4, sizeof( uint32_t ) );
+
+    if ( chunkOffset + 8 + compressedSize > file.mappedSize() )
+      throw exAddressOutOfRange();
+
+    chunk->resize( uncompressedSize );
+
+    if ( !IndexCodec::decompress( codec,
+                                  mapping + chunkOffset + 8,
+                                  compressedSize,
+                                  chunk->data(),
+                                  chunk->size(),
+                                  dictionary.get() ) ) {
+      throw exFailedToDecompressChunk();
+    }
+
+    return chunk;
+  }
+
+  // Fall back to mapping just the chunk
+  QMutexLocker _( &file.lock );
+  auto bytes = file.map( offsets[ chunkIdx ], 8 );
+  if ( bytes == nullptr )
+    throw mapFailed();
+  auto qBytes = QByteArray::fromRawData( reinterpret_cast< char * >( bytes ), 8 );
+  QDataStream in( qBytes );
+  in.setByteOrder( QDataStream::LittleEndian );
+
+  in >> uncompressedSize >> compressedSize;
+
+  file.unmap( bytes );
+  chunk->resize( uncompressedSize );
+
+  auto chunkDataBytes = file.map( offsets[ chunkIdx ] + 8, compressedSize );
+  if ( chunkDataBytes == nullptr )
+    throw mapFailed();
+  auto autoUnmap = qScopeGuard( [ & ] {
+    file.unmap( chunkDataBytes );
+  } );
+  Q_UNUSED( autoUnmap )
+
+  if ( !IndexCodec::decompress( codec, chunkDataBytes, compressedSize, chunk->data(), chunk->size(), dictionary.get() ) ) {
+    throw exFailedToDecompressChunk();
+  }
+
+  return chunk;
+}
+
+char const * Reader::getBlock( uint32_t address, Chunk & chunk )
 {
   size_t chunkIdx = address >> 16;
 
   if ( chunkIdx >= offsets.size() )
     throw exAddressOutOfRange();
 
-  // Read and decompress the chunk
+  chunk.reset();
+
   {
-    // file.seek( offsets[ chunkIdx ] );
-    QMutexLocker _( &file.lock );
-    auto bytes = file.map( offsets[ chunkIdx ], 8 );
-    if ( bytes == nullptr )
-      throw mapFailed();
-    auto qBytes = QByteArray::fromRawData( reinterpret_cast< char * >( bytes ), 8 );
-    QDataStream in( qBytes );
-    in.setByteOrder( QDataStream::LittleEndian );
-
-    uint32_t uncompressedSize;
-    uint32_t compressedSize;
-
-    in >> uncompressedSize >> compressedSize;
-
-    file.unmap( bytes );
-    chunk.resize( uncompressedSize );
-
-    // vector< unsigned char > compressedData( compressedSize );
-    auto chunkDataBytes = file.map( offsets[ chunkIdx ] + 8, compressedSize );
-    if ( chunkDataBytes == nullptr )
-      throw mapFailed();
-    // file.read( &compressedData.front(), compressedData.size() );
-    auto autoUnmap = qScopeGuard( [ & ] {
-      file.unmap( chunkDataBytes );
+    QMutexLocker _( &cacheMutex );
+
+    for ( auto i = cache.begin(); i != cache.end(); ++i ) {
+      if ( i->first == chunkIdx ) {
+        chunk = i->second;
+        // Move it to the front, as the most recently used one
+        std::rotate( cache.begin(), i, i + 1 );
+        break;
+      }
+    }
+  }
+
+  if ( !chunk ) {
+    // Decompress without holding the lock, so other blocks can be served
+    // meanwhile. Two threads may end up loading the same chunk, which is
+    // harmless.
+    chunk = loadChunk( chunkIdx );
+
+    QMutexLocker _( &cacheMutex );
+
+    bool cached = std::any_of( cache.begin(), cache.end(), [ chunkIdx ]( auto const & entry ) {
+      return entry.first == chunkIdx;
     } );
-    Q_UNUSED( autoUnmap )
 
-    unsigned long decompressedLength = chunk.size();
+    if ( !cached ) {
+      if ( cache.size() >= CachedChunks )
+        cache.pop_back();
 
-    if ( uncompress( (unsigned char *)&chunk.front(), &decompressedLength, chunkDataBytes, compressedSize ) != Z_OK
-         || decompressedLength != chunk.size() ) {
-      throw exFailedToDecompressChunk();
+      cache.insert( cache.begin(), { chunkIdx, chunk } );
     }
   }
 
   size_t offsetInChunk = address & 0xffFF;
 
-  if ( offsetInChunk > chunk.size() ) // It can be equal to for 0-sized blocks
+  if ( offsetInChunk > chunk->size() ) // It can be equal to for 0-sized blocks
     throw exAddressOutOfRange();
 
-  return &chunk.front() + offsetInChunk;
+  return chunk->data() + offsetInChunk;
+}
+
+bool isCodecSupported( File::Class & file, uint32_t offset )
+{
+  try {
+    file.seek( offset );
+
+    if ( file.read< uint32_t >() != ExtendedTableMarker )
+      return true; // zlib
+
+    return IndexCodec::isSupported( file.read< uint32_t >() );
+  }
+  catch ( File::Ex & ) {
+    // A truncated file, which can't be read anyway
+    return false;
+  }
 }
 
 } // namespace ChunkedStorage
@@ -6,7 +6,11 @@
 
 #include "ex.hh"
 #include "file.hh"
+#include "indexcodec.hh"
+#include "sptr.hh"
 
+#include <QMutex>
+#include <utility>
 #include <vector>
 #include <stdint.h>
 
@@ -17,6 +21,9 @@
 /// even if its size does exceed its maximum allowed size. This is very
 /// handy since we're retrieving the data by the same blocks we used to save
 /// it as, that' the only kind of seek we support, really.
+/// The chunks are compressed with the codec selected in the preferences at the
+/// time of writing (see IndexCodec). For codecs other than zlib, the chunk
+/// table also records the codec and the dictionary trained for the chunks.
 namespace ChunkedStorage {
 
 using std::vector;
@@ -65,10 +72,32 @@ private:
   // grows, but never shrinks.
   size_t bufferUsed;
 
+  IndexCodec::Codec codec;
+
+  // For the codecs which benefit from a trained dictionary, the first chunks
+  // are held back until there's enough data to train it on.
+  bool training;
+  vector< vector< unsigned char > > pendingChunks;
+  size_t pendingSize;
+  vector< size_t > sampleSizes; // Sizes of the blocks in pendingChunks
+
+  sptr< IndexCodec::TrainedDictionary > dictionary;
+
   void saveCurrentChunk();
+
+  /// Compresses the chunk and writes it out
+  void writeChunk( unsigned char const * data, size_t size );
+
+  /// Trains the dictionary on the pending chunks and writes them out
+  void trainDictionary();
 };
 
+/// A decompressed chunk. It is shared between the reader's cache and the
+/// users of the blocks it contains, and is never modified once loaded.
+using Chunk = sptr< vector< char > const >;
+
 /// This class reads data blocks previously written by Writer.
+/// It is safe to use from several threads at once.
 class Reader
 {
   vector< uint32_t > offsets;
@@ -80,11 +109,34 @@ public:
   Reader( File::Class &, uint32_t );
 
   /// Reads the block previously written by Writer, identified by its address.
-  /// Uses the user-provided storage to load the entire chunk, and then to
-  /// return a pointer to the requested block inside it.
-  char * getBlock( uint32_t address, vector< char > & );
+  /// The entire chunk holding the block is stored to 'chunk', and a pointer
+  /// to the requested block inside it is returned. The pointer stays valid
+  /// for as long as 'chunk' is kept around.
+  char const * getBlock( uint32_t address, Chunk & chunk );
+
+private:
+
+  enum {
+    /// The number of the recently decompressed chunks kept by each reader
+    CachedChunks = 4
+  };
+
+  /// Reads and decompresses the given chunk.
+  Chunk loadChunk( size_t chunkIdx );
+
+  uint32_t codec;
+  sptr< IndexCodec::TrainedDictionary const > dictionary;
+
+  QMutex cacheMutex;
+  /// The recently used chunks along with their indices, the most recent first
+  vector< std::pair< size_t, Chunk > > cache;
 };
 
+/// Returns true if this build can read the chunks whose table is at the given
+/// offset, that is, supports the codec they were compressed with. The formats
+/// use this to rebuild the indexes they can't open.
+bool isCodecSupported( File::Class &, uint32_t offset );
+
 } // namespace ChunkedStorage
 
 #endif
@@ -167,6 +167,37 @@ bool Class::unmap( uchar * address )
   return f.unmap( address );
 }
 
+uchar const * Class::mapAll()
+{
+  uchar * mapping = wholeMapping.load( std::memory_order_acquire );
+
+  if ( mapping )
+    return mapping;
+
+  QMutexLocker _( &lock );
+
+  mapping = wholeMapping.load( std::memory_order_relaxed );
+
+  if ( mapping || wholeMappingFailed )
+    return mapping;
+
+  qint64 size = f.size();
+
+  // Zero-sized mappings aren't possible, and huge files may exhaust
+  // the address space of 32-bit builds, in which case mapping fails.
+  mapping = size > 0 ? f.map( 0, size ) : nullptr;
+
+  if ( !mapping ) {
+    wholeMappingFailed = true;
+    return nullptr;
+  }
+
+  wholeMappingSize = size;
+  wholeMapping.store( mapping, std::memory_order_release );
+
+  return mapping;
+}
+
 
 void Class::seekEnd()
 {
@@ -196,6 +227,9 @@ QFile & Class::file()
 
 void Class::close()
 {
+  // Closing the file unmaps everything
+  wholeMapping.store( nullptr, std::memory_order_release );
+  wholeMappingSize = 0;
   f.close();
 }
 
@@ -8,6 +8,7 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <atomic>
 #include <cstdio>
 #include <string>
 #include <vector>
@@ -106,6 +107,19 @@ public:
   uchar * map( qint64 offset, qint64 size );
   bool unmap( uchar * address );
 
+  /// Maps the whole file on first use and returns the mapping, or nullptr if
+  /// the file can't be mapped. The mapping stays valid until the file is
+  /// closed. Unlike seek() and read(), reading through it doesn't depend on
+  /// the file position, so it can be done from several threads at once
+  /// without any locking.
+  uchar const * mapAll();
+
+  /// The size of the mapping returned by mapAll().
+  qint64 mappedSize() const
+  {
+    return wholeMappingSize;
+  }
+
 
   /// Returns the underlying QFile* , so other operations can be
   /// performed on it.
@@ -117,6 +131,10 @@ public:
   ~Class() noexcept;
 
 private:
+  std::atomic< uchar * > wholeMapping{ nullptr };
+  qint64 wholeMappingSize = 0;
+  bool wholeMappingFailed = false;
+
   // QFile::open but with fopen-like mode settings.
   void open( char const * mode );
 
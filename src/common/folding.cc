@@ -7,21 +7,22 @@
 #include "globalregex.hh"
 #include "inc_case_folding.hh"
 
+#include <algorithm>
+#include <stdint.h>
+
 namespace Folding {
 
-/// Tests if the given char is one of the Unicode combining marks. Some are
-/// caught by the diacritics folding table, but they are only handled there
-/// when they come with their main characters, not by themselves. The rest
-/// are caught here.
-bool isCombiningMark( wchar ch )
+namespace {
+
+bool isWildcard( wchar ch )
 {
-  return QChar::isMark( ch );
+  return ch == '\\' || ch == '?' || ch == '*' || ch == '[' || ch == ']';
 }
 
-wstring apply( wstring const & in, bool preserveWildcards )
+void applyGeneric( wchar const * in, size_t size, wstring & out, bool preserveWildcards )
 {
   //remove space and accent;
-  auto withPunc = QString::fromStdU32String( in )
+  auto withPunc = QString::fromUcs4( in, size )
                     .normalized( QString::NormalizationForm_KD )
                     .remove( RX::markSpace )
                     .toStdU32String();
@@ -34,8 +35,7 @@ wstring apply( wstring const & in, bool preserveWildcards )
 
   for ( auto const & ch : withPunc ) {
 
-    if ( !isPunct( ch )
-         || ( preserveWildcards && ( ch == '\\' || ch == '?' || ch == '*' || ch == '[' || ch == ']' ) ) ) {
+    if ( !isPunct( ch ) || ( preserveWildcards && isWildcard( ch ) ) ) {
       withoutDiacritics.push_back( ch );
     }
   }
@@ -43,18 +43,91 @@ wstring apply( wstring const & in, bool preserveWildcards )
 
   // Now, fold the case
 
-  wstring caseFolded;
-
-  caseFolded.reserve( withoutDiacritics.size() * foldCaseMaxOut );
+  out.clear();
+  out.reserve( withoutDiacritics.size() * foldCaseMaxOut );
 
   wchar const * nextChar = withoutDiacritics.data();
 
   wchar buf[ foldCaseMaxOut ];
 
   for ( size_t left = withoutDiacritics.size(); left--; )
-    caseFolded.append( buf, foldCase( *nextChar++, buf ) );
+    out.append( buf, foldCase( *nextChar++, buf ) );
+}
 
-  return caseFolded;
+struct FoldedChar
+{
+  enum {
+    MaxSize = 3
+  };
+
+  uint8_t size;
+  wchar chars[ MaxSize ];
+};
+
+/// Each Latin-1 character folded on its own by applyGeneric(). None of those
+/// decompose into anything but themselves or other characters followed by
+/// combining marks, which are removed, so folding a Latin-1 string is the
+/// same as concatenating the foldings of its characters.
+FoldedChar const * latin1Foldings()
+{
+  static FoldedChar const * const foldings = [] {
+    static FoldedChar table[ 0x100 ];
+
+    wstring folded;
+
+    for ( wchar ch = 0; ch < 0x100; ++ch ) {
+      applyGeneric( &ch, 1, folded, false );
+
+      Q_ASSERT( folded.size() <= FoldedChar::MaxSize );
+
+      table[ ch ].size = std::min< size_t >( folded.size(), FoldedChar::MaxSize );
+      std::copy( folded.begin(), folded.begin() + table[ ch ].size, table[ ch ].chars );
+    }
+
+    return table;
+  }();
+
+  return foldings;
+}
+
+} // namespace
+
+/// Tests if the given char is one of the Unicode combining marks. Some are
+/// caught by the diacritics folding table, but they are only handled there
+/// when they come with their main characters, not by themselves. The rest
+/// are caught here.
+bool isCombiningMark( wchar ch )
+{
+  return QChar::isMark( ch );
+}
+
+wstring apply( wstring const & in, bool preserveWildcards )
+{
+  wstring out;
+  apply( in.data(), in.size(), out, preserveWildcards );
+  return out;
+}
+
+void apply( wchar const * in, size_t size, wstring & out, bool preserveWildcards )
+{
+  for ( size_t x = 0; x < size; ++x )
+    if ( in[ x ] >= 0x100 ) {
+      applyGeneric( in, size, out, preserveWildcards );
+      return;
+    }
+
+  FoldedChar const * foldings = latin1Foldings();
+
+  out.clear();
+
+  for ( size_t x = 0; x < size; ++x ) {
+    wchar ch = in[ x ];
+
+    if ( preserveWildcards && isWildcard( ch ) )
+      out.push_back( ch );
+    else
+      out.append( foldings[ ch ].chars, foldings[ ch ].size );
+  }
 }
 
 wstring applySimpleCaseOnly( wstring const & in )
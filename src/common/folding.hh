@@ -72,13 +72,12 @@ QString trimWhitespaceOrPunct( QString const & in );
 wstring trimWhitespace( wstring const & );
 QString trimWhitespace( QString const & in );
 
-/// Same as apply( wstring ), but without any heap operations, therefore
-/// preferable when there're many strings to process. Returns -1 if the
-/// operation succeeded, or otherwise the minimum value of outSize required
-/// to succeed.
-/// Currently commented out, consider implementing it in case indices'
-/// generation would be too slow.
-//ssize_t apply( wchar const * in, wchar * out, size_t outSize );
+/// Same as apply( wstring ), but folds 'size' characters starting at 'in' and
+/// stores the result in 'out', reusing its storage. Strings made of Latin-1
+/// characters only, which most headwords are, are folded using a precomputed
+/// table without any heap operations, so this is preferable when there're
+/// many strings to process.
+void apply( wchar const * in, size_t size, wstring & out, bool preserveWildcards = false );
 
 /// Unescape all wildcard symbols (for exast search)
 QString unescapeWildcardSymbols( QString const & );
@@ -49,6 +49,9 @@ signals:
   void dictionaryChanges( ActiveDictIds ad );
   void dictionaryClear( ActiveDictIds ad );
 
+  /// Emitted by Dictionary::Registry::publish() once the dictionaries were (re)loaded
+  void dictionaryRegistryPublished();
+
   void indexingDictionary( QString );
 };
 
@@ -0,0 +1,170 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
+
+#include "scheduler.hh"
+
+#include <QDebug>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <mutex>
+
+namespace Scheduler {
+
+namespace {
+
+enum {
+  /// Interactive lookups get at least that many threads regardless of the
+  /// number of cores, since some of them (network dictionaries) mostly wait
+  MinInteractiveThreads = 4
+};
+
+/// The QRunnable put into the pool. It is owned by the pool, or by whoever
+/// takes it back from there.
+class Runnable: public QRunnable
+{
+public:
+
+  explicit Runnable( sptr< Task > task_ ):
+    task( std::move( task_ ) )
+  {
+  }
+
+  void run() override;
+
+private:
+
+  sptr< Task > task;
+};
+
+} // namespace
+
+class Task
+{
+public:
+
+  enum State {
+    Queued,
+    Running,
+    Finished,
+    Dropped
+  };
+
+  Task( QThreadPool & pool_, std::function< void() > work_ ):
+    pool( pool_ ),
+    work( std::move( work_ ) )
+  {
+  }
+
+  void execute()
+  {
+    {
+      QMutexLocker _( &mutex );
+      state    = Running;
+      runnable = nullptr;
+    }
+
+    // QtConcurrent used to swallow the exceptions escaping the work, so keep
+    // doing that: letting one reach the pool would terminate the program,
+    // and the waiters would never see the task finished anyway
+    try {
+      work();
+    }
+    catch ( std::exception & e ) {
+      qWarning() << "Scheduler: a task failed:" << e.what();
+    }
+    catch ( ... ) {
+      qWarning() << "Scheduler: a task failed with an unknown exception";
+    }
+
+    QMutexLocker _( &mutex );
+    state = Finished;
+    stateChanged.wakeAll();
+  }
+
+  QThreadPool & pool;
+  std::function< void() > work;
+
+  QMutex mutex;
+  QWaitCondition stateChanged;
+  State state = Queued;
+  /// Only valid while the task is queued
+  Runnable * runnable = nullptr;
+};
+
+void Runnable::run()
+{
+  task->execute();
+}
+
+QThreadPool & pool( Class cls )
+{
+  static QThreadPool pools[ Bulk + 1 ];
+  static std::once_flag configured;
+
+  std::call_once( configured, []() {
+    int const cores = QThread::idealThreadCount();
+
+    pools[ Interactive ].setMaxThreadCount( qMax( cores, (int)MinInteractiveThreads ) );
+
+    pools[ Background ].setMaxThreadCount( qMax( cores / 2, 2 ) );
+    pools[ Background ].setThreadPriority( QThread::LowPriority );
+
+    // The full-text indexing limits its parallelism by itself
+    pools[ Bulk ].setMaxThreadCount( qMax( cores, 1 ) );
+    pools[ Bulk ].setThreadPriority( QThread::LowestPriority );
+  } );
+
+  return pools[ cls ];
+}
+
+Future run( Class cls, std::function< void() > work )
+{
+  QThreadPool & threadPool = pool( cls );
+
+  Future future;
+  future.task = std::make_shared< Task >( threadPool, std::move( work ) );
+
+  auto * runnable = new Runnable( future.task );
+
+  {
+    QMutexLocker _( &future.task->mutex );
+    future.task->runnable = runnable;
+  }
+
+  threadPool.start( runnable );
+
+  return future;
+}
+
+void Future::waitForFinished()
+{
+  if ( !task )
+    return;
+
+  QMutexLocker _( &task->mutex );
+
+  while ( task->state == Task::Queued || task->state == Task::Running )
+    task->stateChanged.wait( &task->mutex );
+}
+
+bool Future::cancel()
+{
+  if ( !task )
+    return false;
+
+  QMutexLocker _( &task->mutex );
+
+  // If a thread has just picked it up, it waits for our lock in execute()
+  // and isn't in the queue anymore, so tryTake() fails
+  if ( task->state != Task::Queued || !task->runnable || !task->pool.tryTake( task->runnable ) )
+    return false;
+
+  delete task->runnable;
+  task->runnable = nullptr;
+  task->state    = Task::Dropped;
+  task->stateChanged.wakeAll();
+
+  return true;
+}
+
+} // namespace Scheduler
@@ -0,0 +1,56 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
+
+#ifndef __SCHEDULER_HH_INCLUDED__
+#define __SCHEDULER_HH_INCLUDED__
+
+#include "sptr.hh"
+
+#include <QThreadPool>
+#include <functional>
+
+/// Runs the background work of the program. The work is split into classes,
+/// each having its own threads, so that long jobs such as building the
+/// full-text indexes can't hold up the lookups the user is waiting for.
+namespace Scheduler {
+
+enum Class {
+  /// Lookups the user is waiting for: word searches, articles, resources
+  Interactive,
+  /// Work the user doesn't wait for directly, e.g. deferred initializations
+  Background,
+  /// Long running jobs, such as building the full-text indexes
+  Bulk
+};
+
+/// Returns the thread pool running the tasks of the given class. Useful for
+/// QtConcurrent::run() and for starting QRunnables.
+QThreadPool & pool( Class );
+
+class Task;
+
+/// Refers to a task started by run(). A default-constructed one refers to no
+/// task at all.
+class Future
+{
+public:
+
+  /// Blocks until the task is finished. Returns at once if it was dropped.
+  void waitForFinished();
+
+  /// Drops the task if it hasn't been started yet. Returns true if it was
+  /// dropped, in which case it's never going to run.
+  bool cancel();
+
+private:
+
+  friend Future run( Class, std::function< void() > );
+
+  sptr< Task > task;
+};
+
+/// Queues the given function to run on the pool of the given class.
+Future run( Class, std::function< void() > );
+
+} // namespace Scheduler
+
+#endif
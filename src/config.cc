@@ -648,6 +648,9 @@ Class load()
   if ( !hunspell.isNull() ) {
     c.hunspell.dictionariesPath = hunspell.toElement().attribute( "dictionariesPath" );
 
+    if ( hunspell.toElement().hasAttribute( "maxInstances" ) )
+      c.hunspell.maxInstances = hunspell.toElement().attribute( "maxInstances" ).toUInt();
+
     QDomNodeList nl = hunspell.toElement().elementsByTagName( "enabled" );
 
     for ( int x = 0; x < nl.length(); ++x )
@@ -935,6 +938,10 @@ Class load()
       c.preferences.sessionCollapse = ( preferences.namedItem( "sessionCollapse" ).toElement().text() == "1" );
     }
 
+    if ( !preferences.namedItem( "streamArticles" ).isNull() ) {
+      c.preferences.streamArticles = ( preferences.namedItem( "streamArticles" ).toElement().text() == "1" );
+    }
+
 #ifdef HAVE_X11
     c.preferences.trackClipboardScan = ( preferences.namedItem( "trackClipboardScan" ).toElement().text() == "1" );
     c.preferences.trackSelectionScan = ( preferences.namedItem( "trackSelectionScan" ).toElement().text() == "1" );
@@ -1015,6 +1022,15 @@ Class load()
 
     c.preferences.dictionaryDebug = fromConfig2Preference( preferences.namedItem( "dictionaryDebug" ), "1" );
 
+    c.preferences.zstdIndexCompression =
+      fromConfig2Preference( preferences.namedItem( "zstdIndexCompression" ), "1" );
+
+    if ( !preferences.namedItem( "indexNodeCacheSize" ).isNull() )
+      c.preferences.indexNodeCacheSize = preferences.namedItem( "indexNodeCacheSize" ).toElement().text().toInt();
+
+    if ( !preferences.namedItem( "dictzipCacheSize" ).isNull() )
+      c.preferences.dictzipCacheSize = preferences.namedItem( "dictzipCacheSize" ).toElement().text().toInt();
+
     if ( !preferences.namedItem( "maxStringsInHistory" ).isNull() )
       c.preferences.maxStringsInHistory = preferences.namedItem( "maxStringsInHistory" ).toElement().text().toUInt();
 
@@ -1087,6 +1103,9 @@ Class load()
         c.preferences.fts.enablePosition = ( fts.namedItem( "enablePosition" ).toElement().text() == "1" );
       }
 
+      if ( !fts.namedItem( "federatedSearch" ).isNull() )
+        c.preferences.fts.federatedSearch = ( fts.namedItem( "federatedSearch" ).toElement().text() == "1" );
+
       if ( !fts.namedItem( "maxDictionarySize" ).isNull() )
         c.preferences.fts.maxDictionarySize = fts.namedItem( "maxDictionarySize" ).toElement().text().toUInt();
 
@@ -1174,6 +1193,9 @@ Class load()
   if ( !root.namedItem( "maxHeadwordsToExpand" ).isNull() )
     c.maxHeadwordsToExpand = root.namedItem( "maxHeadwordsToExpand" ).toElement().text().toUInt();
 
+  if ( !root.namedItem( "zimEmbeddedIndexes" ).isNull() )
+    c.zimEmbeddedIndexes = ( root.namedItem( "zimEmbeddedIndexes" ).toElement().text() == "1" );
+
   QDomNode headwordsDialog = root.namedItem( "headwordsDialog" );
 
   if ( !headwordsDialog.isNull() ) {
@@ -1367,6 +1389,9 @@ void save( Class const & c )
     QDomAttr path        = dd.createAttribute( "dictionariesPath" );
     path.setValue( c.hunspell.dictionariesPath );
     hunspell.setAttributeNode( path );
+    QDomAttr maxInstances = dd.createAttribute( "maxInstances" );
+    maxInstances.setValue( QString::number( c.hunspell.maxInstances ) );
+    hunspell.setAttributeNode( maxInstances );
     root.appendChild( hunspell );
 
     for ( const auto & enabledDictionarie : c.hunspell.enabledDictionaries ) {
@@ -1841,6 +1866,10 @@ void save( Class const & c )
     opt.appendChild( dd.createTextNode( c.preferences.sessionCollapse ? "1" : "0" ) );
     preferences.appendChild( opt );
 
+    opt = dd.createElement( "streamArticles" );
+    opt.appendChild( dd.createTextNode( c.preferences.streamArticles ? "1" : "0" ) );
+    preferences.appendChild( opt );
+
 #ifdef HAVE_X11
     opt = dd.createElement( "trackClipboardScan" );
     opt.appendChild( dd.createTextNode( c.preferences.trackClipboardScan ? "1" : "0" ) );
@@ -2007,6 +2036,18 @@ void save( Class const & c )
     opt.appendChild( dd.createTextNode( c.preferences.dictionaryDebug ? "1" : "0" ) );
     preferences.appendChild( opt );
 
+    opt = dd.createElement( "zstdIndexCompression" );
+    opt.appendChild( dd.createTextNode( c.preferences.zstdIndexCompression ? "1" : "0" ) );
+    preferences.appendChild( opt );
+
+    opt = dd.createElement( "indexNodeCacheSize" );
+    opt.appendChild( dd.createTextNode( QString::number( c.preferences.indexNodeCacheSize ) ) );
+    preferences.appendChild( opt );
+
+    opt = dd.createElement( "dictzipCacheSize" );
+    opt.appendChild( dd.createTextNode( QString::number( c.preferences.dictzipCacheSize ) ) );
+    preferences.appendChild( opt );
+
     opt = dd.createElement( "maxStringsInHistory" );
     opt.appendChild( dd.createTextNode( QString::number( c.preferences.maxStringsInHistory ) ) );
     preferences.appendChild( opt );
@@ -2079,6 +2120,10 @@ void save( Class const & c )
       opt.appendChild( dd.createTextNode( c.preferences.fts.enablePosition ? "1" : "0" ) );
       hd.appendChild( opt );
 
+      opt = dd.createElement( "federatedSearch" );
+      opt.appendChild( dd.createTextNode( c.preferences.fts.federatedSearch ? "1" : "0" ) );
+      hd.appendChild( opt );
+
       opt = dd.createElement( "maxDictionarySize" );
       opt.appendChild( dd.createTextNode( QString::number( c.preferences.fts.maxDictionarySize ) ) );
       hd.appendChild( opt );
@@ -2183,6 +2228,10 @@ void save( Class const & c )
     opt = dd.createElement( "maxHeadwordsToExpand" );
     opt.appendChild( dd.createTextNode( QString::number( c.maxHeadwordsToExpand ) ) );
     root.appendChild( opt );
+
+    opt = dd.createElement( "zimEmbeddedIndexes" );
+    opt.appendChild( dd.createTextNode( c.zimEmbeddedIndexes ? "1" : "0" ) );
+    root.appendChild( opt );
   }
 
   {
@@ -201,6 +201,8 @@ struct FullTextSearch
   bool enabled;
 
   bool enablePosition = false;
+  /// Search all the dictionaries as one index, ranking the matches across them
+  bool federatedSearch = true;
 
   quint32 maxDictionarySize;
   quint32 parallelThreads = QThread::idealThreadCount() / 3 + 1;
@@ -382,6 +384,7 @@ struct Preferences
   bool ignoreDiacritics;
   bool ignorePunctuation;
   bool sessionCollapse = false;
+  bool streamArticles  = true;
 #ifdef HAVE_X11
   bool trackClipboardScan;
   bool trackSelectionScan;
@@ -405,6 +408,9 @@ struct Preferences
   bool clearNetworkCacheOnExit;
   bool removeInvalidIndexOnExit = false;
   bool dictionaryDebug          = false;
+  bool zstdIndexCompression     = false;
+  int indexNodeCacheSize        = 64; // In MB, the decompressed index nodes kept in memory
+  int dictzipCacheSize          = 5;  // The inflated chunks each .dz file keeps in memory
 
   qreal zoomFactor;
   qreal helpZoomFactor;
@@ -565,9 +571,15 @@ struct Hunspell
 
   Dictionaries enabledDictionaries;
 
+  /// The most Hunspell instances each dictionary may have, each one holding
+  /// the whole dictionary in memory. More of them let more lookups use the
+  /// dictionary at once.
+  unsigned maxInstances = 2;
+
   bool operator==( Hunspell const & other ) const
   {
-    return dictionariesPath == other.dictionariesPath && enabledDictionaries == other.enabledDictionaries;
+    return dictionariesPath == other.dictionariesPath && enabledDictionaries == other.enabledDictionaries
+      && maxInstances == other.maxInstances;
   }
 
   bool operator!=( Hunspell const & other ) const
@@ -889,6 +901,10 @@ struct Class
 
   unsigned int maxHeadwordsToExpand;
 
+  /// Use the title and full-text indexes embedded into the ZIM files, when
+  /// they have them, instead of building our own ones.
+  bool zimEmbeddedIndexes;
+
   HeadwordsDialog headwordsDialog;
 
   QString editDictionaryCommandLine; // Command line to call external editor for dictionary
@@ -901,7 +917,8 @@ struct Class
     usingSmallIconsInToolbars( false ),
     maxPictureWidth( 0 ),
     maxHeadwordSize( 256U ),
-    maxHeadwordsToExpand( 0 )
+    maxHeadwordsToExpand( 0 ),
+    zimEmbeddedIndexes( true )
   {
   }
   Group * getGroup( unsigned id );
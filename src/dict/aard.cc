@@ -124,7 +124,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 void readJSONValue( string const & source, string & str, string::size_type & pos )
@@ -542,7 +544,7 @@ QString const & AardDictionary::getDescription()
 void AardDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -601,7 +603,7 @@ class AardArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -614,7 +616,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -624,6 +626,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~AardArticleRequest()
@@ -640,15 +645,7 @@ void AardArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -927,7 +924,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         idxHeader.wordCount = wordCount;
 
@@ -96,8 +96,10 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion || header.parserVersion != Babylon::ParserVersion
-    || header.foldingVersion != Folding::Version;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || header.parserVersion != Babylon::ParserVersion
+    || header.foldingVersion != Folding::Version || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 // Removes the $1$-like postfix
@@ -288,15 +290,15 @@ void BglDictionary::loadIcon() noexcept
 
       // Try loading icon now
 
-      vector< char > chunk;
+      ChunkedStorage::Chunk chunk;
 
       QMutexLocker _( &idxMutex );
 
-      char * iconData = chunks.getBlock( idxHeader.iconAddress, chunk );
+      char const * iconData = chunks.getBlock( idxHeader.iconAddress, chunk );
 
       QImage img;
 
-      if ( img.loadFromData( (unsigned char *)iconData, idxHeader.iconSize ) ) {
+      if ( img.loadFromData( (uchar const *)iconData, idxHeader.iconSize ) ) {
 
         // Transform it to be square
         int max = img.width() > img.height() ? img.width() : img.height();
@@ -326,11 +328,9 @@ void BglDictionary::loadIcon() noexcept
 
 void BglDictionary::loadArticle( uint32_t offset, string & headword, string & displayedHeadword, string & articleText )
 {
-  vector< char > chunk;
+  ChunkedStorage::Chunk chunk;
 
-  QMutexLocker _( &idxMutex );
-
-  char * articleData = chunks.getBlock( offset, chunk );
+  char const * articleData = chunks.getBlock( offset, chunk );
 
   headword = articleData;
 
@@ -348,8 +348,8 @@ QString const & BglDictionary::getDescription()
     dictionaryDescription = "NONE";
   else {
     QMutexLocker _( &idxMutex );
-    vector< char > chunk;
-    char * dictDescription = chunks.getBlock( idxHeader.descriptionAddress, chunk );
+    ChunkedStorage::Chunk chunk;
+    char const * dictDescription = chunks.getBlock( idxHeader.descriptionAddress, chunk );
     string str( dictDescription );
     if ( !str.empty() )
       dictionaryDescription += QObject::tr( "Copyright: %1%2" )
@@ -419,7 +419,7 @@ void BglDictionary::getArticleText( uint32_t articleAddress, QString & headword,
 void BglDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -448,7 +448,7 @@ class BglHeadwordsRequest: public Dictionary::WordSearchRequest
   BglDictionary & dict;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -456,7 +456,7 @@ public:
     str( word_ ),
     dict( dict_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -466,6 +466,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~BglHeadwordsRequest() override
@@ -558,7 +561,7 @@ class BglArticleRequest: public Dictionary::DataRequest
 
   QAtomicInt isCancelled;
   bool ignoreDiacritics;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -571,7 +574,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -581,6 +584,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   void fixHebString( string & hebStr );      // Hebrew support
@@ -635,18 +641,10 @@ void BglArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   static Language::Id hebrew = LangCoder::code2toInt( "he" ); // Hebrew support
 
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
-
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
   set< uint32_t > articlesIncluded; // Some synonims make it that the articles
@@ -814,7 +812,7 @@ class BglResourceRequest: public Dictionary::DataRequest
   string name;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -829,7 +827,7 @@ public:
     resourcesCount( resourcesCount_ ),
     name( name_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -839,6 +837,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~BglResourceRequest()
@@ -1155,7 +1156,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature      = Signature;
-        idxHeader.formatVersion  = CurrentFormatVersion;
+        idxHeader.formatVersion  =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
         idxHeader.parserVersion  = Babylon::ParserVersion;
         idxHeader.foldingVersion = Folding::Version;
         idxHeader.articleCount   = articleCount;
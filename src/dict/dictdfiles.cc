@@ -78,7 +78,8 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements );
 }
 
 class DictdDictionary: public BtreeIndexing::BtreeDictionary
@@ -87,7 +88,7 @@ class DictdDictionary: public BtreeIndexing::BtreeDictionary
   File::Class idx, indexFile; // The later is .index file
   IdxHeader idxHeader;
   dictData * dz;
-  QMutex indexFileMutex, dzMutex;
+  QMutex indexFileMutex;
 
 public:
 
@@ -171,6 +172,8 @@ DictdDictionary::DictdDictionary( string const & id,
   if ( !dz )
     throw exDictzipError( string( dz_error_str( error ) ) + "(" + getDictionaryFilenames()[ 1 ] + ")" );
 
+  dict_data_set_cache_size( dz, Dictionary::dictzipCacheSize() );
+
   // Initialize the index
 
   openIndex( IndexInfo( idxHeader.indexBtreeMaxElements, idxHeader.indexRootOffset ), idx, idxMutex );
@@ -248,15 +251,7 @@ sptr< Dictionary::DataRequest > DictdDictionary::getArticle( wstring const & wor
 
 {
   try {
-    vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-    for ( const auto & alt : alts ) {
-      /// Make an additional query for each alt
-
-      vector< WordArticleLink > altChain = findArticles( alt, ignoreDiacritics );
-
-      chain.insert( chain.end(), altChain.begin(), altChain.end() );
-    }
+    vector< WordArticleLink > chain = findArticlesWithAlts( word, alts, ignoreDiacritics );
 
     multimap< wstring, string > mainArticles, alternateArticles;
 
@@ -311,10 +306,7 @@ sptr< Dictionary::DataRequest > DictdDictionary::getArticle( wstring const & wor
       string articleText;
 
       char * articleBody;
-      {
-        QMutexLocker _( &dzMutex );
-        articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-      }
+      articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
       if ( !articleBody ) {
         articleText = string( "<div class=\"dictd_article\">DICTZIP error: " ) + dict_error_str( dz ) + "</div>";
@@ -434,7 +426,7 @@ QString const & DictdDictionary::getDescription()
 void DictdDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -499,10 +491,7 @@ void DictdDictionary::getArticleText( uint32_t articleAddress, QString & headwor
     string articleText;
 
     char * articleBody;
-    {
-      QMutexLocker _( &dzMutex );
-      articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-    }
+    articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
     if ( !articleBody ) {
       articleText = dict_error_str( dz );
@@ -693,7 +682,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         // read languages
         QPair< quint32, quint32 > langs = LangCoder::findIdsForFilename( QString::fromStdString( dictFiles[ 0 ] ) );
@@ -4,6 +4,7 @@
 #include <vector>
 #include <algorithm>
 #include <cstdio>
+#include <memory>
 #include "dictionary.hh"
 
 #include <QCryptographicHash>
@@ -20,6 +21,8 @@
 #include <QImage>
 #include <QPainter>
 #include <QRegularExpression>
+#include "dictzip.hh"
+#include "globalbroadcaster.hh"
 #include "utils.hh"
 #include "zipfile.hh"
 
@@ -84,18 +87,79 @@ vector< WordMatch > & WordSearchRequest::getAllMatches()
   if ( !isFinished() )
     throw exRequestUnfinished();
 
+  // The caller may change them in any way
+  matchesChanged();
+
   return matches;
 }
 
+namespace {
+enum : uint32_t {
+  EmptyMatchSlot = 0xffffFFFF
+};
+}
+
+size_t WordSearchRequest::matchIndexSlot( wstring const & word )
+{
+  // Keep the table at most half full, so the probe sequences stay short
+  if ( ( matchIndexUsed + 1 ) * 2 > matchIndex.size() ) {
+    vector< uint32_t > oldIndex( std::max< size_t >( 64, matchIndex.size() * 2 ), EmptyMatchSlot );
+    oldIndex.swap( matchIndex );
+
+    size_t mask = matchIndex.size() - 1;
+
+    for ( uint32_t n : oldIndex ) {
+      if ( n == EmptyMatchSlot )
+        continue;
+
+      size_t slot = std::hash< wstring >()( matches[ n ].word ) & mask;
+
+      while ( matchIndex[ slot ] != EmptyMatchSlot )
+        slot = ( slot + 1 ) & mask;
+
+      matchIndex[ slot ] = n;
+    }
+  }
+
+  size_t mask = matchIndex.size() - 1;
+  size_t slot = std::hash< wstring >()( word ) & mask;
+
+  while ( matchIndex[ slot ] != EmptyMatchSlot && matches[ matchIndex[ slot ] ].word != word )
+    slot = ( slot + 1 ) & mask;
+
+  return slot;
+}
+
+void WordSearchRequest::matchesChanged()
+{
+  matchIndex.clear();
+  matchIndexUsed = 0;
+  indexedMatches = 0;
+}
+
 void WordSearchRequest::addMatch( WordMatch const & match )
 {
-  unsigned n;
-  for ( n = 0; n < matches.size(); n++ )
-    if ( matches[ n ].word.compare( match.word ) == 0 )
-      break;
+  // Index whatever was appended directly. Duplicates among those are left
+  // alone, as they always were.
+  for ( ; indexedMatches < matches.size(); ++indexedMatches ) {
+    size_t slot = matchIndexSlot( matches[ indexedMatches ].word );
+
+    if ( matchIndex[ slot ] == EmptyMatchSlot ) {
+      matchIndex[ slot ] = indexedMatches;
+      ++matchIndexUsed;
+    }
+  }
+
+  size_t slot = matchIndexSlot( match.word );
 
-  if ( n >= matches.size() )
-    matches.push_back( match );
+  if ( matchIndex[ slot ] != EmptyMatchSlot )
+    return;
+
+  matchIndex[ slot ] = matches.size();
+  ++matchIndexUsed;
+
+  matches.push_back( match );
+  ++indexedMatches;
 }
 
 ////////////// DataRequest
@@ -575,6 +639,13 @@ string getFtsSuffix()
   return "_FTS_x";
 }
 
+int dictzipCacheSize()
+{
+  Config::Preferences const * preferences = GlobalBroadcaster::instance()->getPreference();
+
+  return preferences ? preferences->dictzipCacheSize : DICT_CACHE_SIZE;
+}
+
 QString generateRandomDictionaryId()
 {
   return QString(
@@ -583,14 +654,42 @@ QString generateRandomDictionaryId()
       .toHex() );
 }
 
-QMap< std::string, sptr< Dictionary::Class > > dictToMap( std::vector< sptr< Dictionary::Class > > const & dicts )
+Registry::Registry( vector< sptr< Class > > const & dictionaries )
 {
-  QMap< std::string, sptr< Dictionary::Class > > dictMap;
-  for ( auto & dict : dicts ) {
-    if ( !dict )
-      continue;
-    dictMap.insert( dict.get()->getId(), dict );
+  byId.reserve( dictionaries.size() );
+
+  for ( auto const & dict : dictionaries ) {
+    if ( dict )
+      byId.insert_or_assign( dict->getId(), dict );
   }
-  return dictMap;
 }
+
+sptr< Class > Registry::find( string const & id ) const
+{
+  auto i = byId.find( id );
+
+  return i != byId.end() ? i->second : sptr< Class >();
+}
+
+namespace {
+/// The registry published last
+sptr< Registry const > currentRegistry = std::make_shared< Registry const >( vector< sptr< Class > >() );
+}
+
+sptr< Registry const > Registry::publish( vector< sptr< Class > > const & dictionaries )
+{
+  auto registry = std::make_shared< Registry const >( dictionaries );
+
+  std::atomic_store( &currentRegistry, registry );
+
+  emit GlobalBroadcaster::instance()->dictionaryRegistryPublished();
+
+  return registry;
+}
+
+sptr< Registry const > Registry::current()
+{
+  return std::atomic_load( &currentRegistry );
+}
+
 } // namespace Dictionary
@@ -6,6 +6,8 @@
 
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <QMutex>
@@ -190,6 +192,27 @@ protected:
 
   vector< WordMatch > matches;
   bool uncertain;
+
+  /// Subclasses call this after changing 'matches' in any other way than by
+  /// appending to it, e.g. sorting, removing or replacing them. It drops the
+  /// index addMatch() uses, which is rebuilt on the next call then.
+  void matchesChanged();
+
+private:
+
+  /// Indices into 'matches', hashed by their words, which lets addMatch()
+  /// find duplicates without scanning all the matches. This is an
+  /// open-addressing table with linear probing, its size is a power of two.
+  vector< uint32_t > matchIndex;
+  size_t matchIndexUsed = 0;
+  /// How many of the first 'matches' are in matchIndex. Subclasses may also
+  /// append to 'matches' directly, those get indexed on the next addMatch().
+  /// Any other change has to be followed by matchesChanged().
+  size_t indexedMatches = 0;
+
+  /// Returns the slot of matchIndex holding the given word, or the empty slot
+  /// where it should go. Grows the table beforehand if it's getting full.
+  size_t matchIndexSlot( wstring const & word );
 };
 
 /// This request type corresponds to any kinds of data responses where a
@@ -248,6 +271,9 @@ public:
 
   vector< WordMatch > & getMatches()
   {
+    // The caller may change them in any way
+    matchesChanged();
+
     return matches;
   }
 
@@ -346,7 +372,7 @@ public:
   virtual void deferredInit();
 
   /// Returns the dictionary's id.
-  string getId() noexcept
+  string const & getId() const noexcept
   {
     return id;
   }
@@ -438,6 +464,18 @@ public:
   /// dictionaries, the network ones particularly, may of course be slow.
   virtual sptr< WordSearchRequest > prefixMatch( wstring const &, unsigned long maxResults ) = 0;
 
+  /// Returns true if the prefixMatch() results of this dictionary only narrow
+  /// down as the word grows. That is, unless cut short by maxResults, the
+  /// matches for a word include all the matches for the words extending it,
+  /// which are those having the extended word starting the folded match or
+  /// any of its parts following whitespace or punctuation, and whether the
+  /// result is uncertain doesn't depend on the word. This lets the results
+  /// for the words being typed be found by filtering the earlier ones.
+  virtual bool prefixMatchNarrowsDown()
+  {
+    return false;
+  }
+
   /// Looks up a given word in the dictionary, aiming to find different forms
   /// of the given word by allowing suffix variations. This means allowing words
   /// which can be as short as the input word size minus maxSuffixVariation, or as
@@ -518,6 +556,14 @@ public:
     return Utils::AtomicInt::loadAcquire( FTS_index_completed ) != 0;
   }
 
+  /// Returns true if the full-text search uses an index embedded into the
+  /// dictionary file, rather than the Xapian one built for the dictionary.
+  /// Such dictionaries can't be searched together with the others.
+  virtual bool ftsIndexIsEmbedded()
+  {
+    return false;
+  }
+
   /// Make index for full-text search
   virtual void makeFTSIndex( QAtomicInt &, bool ) {}
 
@@ -570,11 +616,53 @@ string makeDictionaryId( vector< string > const & dictionaryFiles ) noexcept;
 bool needToRebuildIndex( vector< string > const & dictionaryFiles, string const & indexFile ) noexcept;
 
 string getFtsSuffix();
+
+/// Returns the number of inflated chunks each opened .dz file is to cache, as
+/// set in the preferences. The dictionaries pass it to dict_data_set_cache_size().
+int dictzipCacheSize();
 /// Returns a random dictionary id useful for interactively created
 /// dictionaries.
 QString generateRandomDictionaryId();
 
-QMap< std::string, sptr< Dictionary::Class > > dictToMap( std::vector< sptr< Dictionary::Class > > const & dicts );
+/// An immutable index of dictionaries by their ids, so that routing an
+/// article or a resource to its dictionary doesn't have to scan them all.
+/// The one made of the currently loaded dictionaries is published with
+/// publish() and can be obtained from any thread with current().
+class Registry
+{
+public:
+
+  explicit Registry( vector< sptr< Class > > const & dictionaries );
+
+  /// Returns the dictionary with the given id, or an empty pointer.
+  sptr< Class > find( string const & id ) const;
+
+  bool contains( string const & id ) const
+  {
+    return byId.find( id ) != byId.end();
+  }
+
+  bool empty() const
+  {
+    return byId.empty();
+  }
+
+  /// Replaces the current registry with the one made of the given
+  /// dictionaries and returns it, announcing it with
+  /// GlobalBroadcaster::dictionaryRegistryPublished(). Meant to be called
+  /// after the dictionaries were (re)loaded, and with no dictionaries before
+  /// reloading them, so that the old ones can be released.
+  static sptr< Registry const > publish( vector< sptr< Class > > const & dictionaries );
+
+  /// Returns the registry published last, or an empty one if there was
+  /// none yet. Never returns a null pointer.
+  static sptr< Registry const > current();
+
+private:
+
+  /// The keys refer to the ids stored in the dictionaries themselves
+  std::unordered_map< std::string_view, sptr< Class > > byId;
+};
 
 } // namespace Dictionary
 
@@ -11,7 +11,7 @@
 #include "htmlescape.hh"
 
 #include <QRegularExpression>
-#include <QtConcurrent>
+#include "scheduler.hh"
 
 namespace DictServer {
 
@@ -342,7 +342,7 @@ class DictServerWordSearchRequest: public Dictionary::WordSearchRequest
   QAtomicInt isCancelled;
   wstring word;
   QString errorString;
-  QFuture< void > f;
+  Scheduler::Future f;
   DictServerDictionary & dict;
   QTcpSocket * socket;
 
@@ -353,7 +353,7 @@ public:
     dict( dict_ ),
     socket( 0 )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -503,6 +503,7 @@ void DictServerWordSearchRequest::run()
 void DictServerWordSearchRequest::cancel()
 {
   isCancelled.ref();
+  f.cancel();
 
   QMutexLocker _( &dataMutex );
   finish();
@@ -513,7 +514,7 @@ class DictServerArticleRequest: public Dictionary::DataRequest
   QAtomicInt isCancelled;
   wstring word;
   QString errorString;
-  QFuture< void > f;
+  Scheduler::Future f;
   DictServerDictionary & dict;
   QTcpSocket * socket;
 
@@ -524,7 +525,7 @@ public:
     dict( dict_ ),
     socket( 0 )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -800,6 +801,7 @@ void DictServerArticleRequest::run()
 void DictServerArticleRequest::cancel()
 {
   isCancelled.ref();
+  f.cancel();
 
   QMutexLocker _( &dataMutex );
   finish();
@@ -51,7 +51,6 @@
 // For SVG handling
 #include <QtSvg/QSvgRenderer>
 
-#include <QtConcurrent>
 
 #include "utils.hh"
 
@@ -136,8 +135,12 @@ bool indexIsOldOrBad( string const & indexFile, bool hasZipFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion || (bool)header.hasZipFile != hasZipFile
-    || ( hasZipFile && header.zipSupportVersion != CurrentZipSupportVersion );
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || (bool)header.hasZipFile != hasZipFile
+    || ( hasZipFile && header.zipSupportVersion != CurrentZipSupportVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.zipIndexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 class DslDictionary: public BtreeIndexing::BtreeDictionary
@@ -148,7 +151,6 @@ class DslDictionary: public BtreeIndexing::BtreeDictionary
   sptr< ChunkedStorage::Reader > chunks;
   string preferredSoundDictionary;
   map< string, string > abrv;
-  QMutex dzMutex;
   dictData * dz;
   QMutex resourceZipMutex;
   IndexedZip resourceZip;
@@ -349,7 +351,7 @@ void DslDictionary::deferredInit()
       return;
 
     if ( !deferredInitRunnableStarted ) {
-      QThreadPool::globalInstance()->start(
+      Scheduler::pool( Scheduler::Background ).start(
         [ this ]() {
           this->doDeferredInit();
         },
@@ -393,12 +395,14 @@ void DslDictionary::doDeferredInit()
       if ( !dz )
         throw exDictzipError( string( dz_error_str( error ) ) + "(" + getDictionaryFilenames()[ 0 ] + ")" );
 
+      dict_data_set_cache_size( dz, Dictionary::dictzipCacheSize() );
+
       // Read the abrv, if any
 
       if ( idxHeader.hasAbrv ) {
-        vector< char > chunk;
+        ChunkedStorage::Chunk chunk;
 
-        char * abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
+        char const * abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
 
         uint32_t total;
         memcpy( &total, abrvBlock, sizeof( uint32_t ) );
@@ -411,7 +415,7 @@ void DslDictionary::doDeferredInit()
           memcpy( &keySz, abrvBlock, sizeof( uint32_t ) );
           abrvBlock += sizeof( uint32_t );
 
-          char * key = abrvBlock;
+          char const * key = abrvBlock;
 
           abrvBlock += keySz;
 
@@ -505,15 +509,9 @@ void DslDictionary::loadArticle( uint32_t address,
   wstring articleData;
 
   {
-    vector< char > chunk;
-
-    char * articleProps;
-
-    {
-      QMutexLocker _( &idxMutex );
+    ChunkedStorage::Chunk chunk;
 
-      articleProps = chunks->getBlock( address, chunk );
-    }
+    char const * articleProps = chunks->getBlock( address, chunk );
 
     uint32_t articleOffset, articleSize;
 
@@ -525,11 +523,7 @@ void DslDictionary::loadArticle( uint32_t address,
 
     char * articleBody;
 
-    {
-      QMutexLocker _( &dzMutex );
-
-      articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-    }
+    articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
     if ( !articleBody ) {
       //      throw exCantReadFile( getDictionaryFilenames()[ 0 ] );
@@ -1126,7 +1120,7 @@ QString DslDictionary::getMainFilename()
 void DslDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
 
@@ -1156,16 +1150,11 @@ void DslDictionary::getArticleText( uint32_t articleAddress, QString & headword,
   headword.clear();
   text.clear();
 
-  vector< char > chunk;
+  ChunkedStorage::Chunk chunk;
 
-  char * articleProps;
+  char const * articleProps = chunks->getBlock( articleAddress, chunk );
   wstring articleData;
 
-  {
-    QMutexLocker _( &idxMutex );
-    articleProps = chunks->getBlock( articleAddress, chunk );
-  }
-
   uint32_t articleOffset, articleSize;
 
   memcpy( &articleOffset, articleProps, sizeof( articleOffset ) );
@@ -1173,10 +1162,7 @@ void DslDictionary::getArticleText( uint32_t articleAddress, QString & headword,
 
   char * articleBody;
 
-  {
-    QMutexLocker _( &dzMutex );
-    articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-  }
+  articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
   if ( !articleBody ) {
     return;
@@ -1404,7 +1390,7 @@ class DslArticleRequest: public Dictionary::DataRequest
 
   QAtomicInt isCancelled;
   QSemaphore hasExited;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1417,7 +1403,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1427,6 +1413,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~DslArticleRequest()
@@ -1449,15 +1438,7 @@ void DslArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   // Some synonyms make it that the articles appear several times. We combat
   // this by only allowing them to appear once. Dsl treats different headwords
@@ -1573,7 +1554,7 @@ class DslResourceRequest: public Dictionary::DataRequest
 
   QAtomicInt isCancelled;
   QSemaphore hasExited;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1581,7 +1562,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1591,6 +1572,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~DslResourceRequest()
@@ -2143,7 +2127,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
           // That concludes it. Update the header.
 
           idxHeader.signature         = Signature;
-          idxHeader.formatVersion     = CurrentFormatVersion;
+          idxHeader.formatVersion     =
+            BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
           idxHeader.zipSupportVersion = CurrentZipSupportVersion;
 
           idxHeader.articleCount = articleCount;
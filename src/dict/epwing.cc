@@ -11,7 +11,6 @@
   #include <QSemaphore>
 
   #include <map>
-  #include <QtConcurrent>
   #include <set>
   #include <string>
 
@@ -75,7 +74,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 class EpwingHeadwordsRequest;
 
@@ -167,6 +168,11 @@ public:
 
   sptr< Dictionary::WordSearchRequest > prefixMatch( wstring const &, unsigned long ) override;
 
+  bool prefixMatchNarrowsDown() override
+  {
+    return false;
+  }
+
   sptr< Dictionary::WordSearchRequest >
   stemmedMatch( wstring const &, unsigned minLength, unsigned maxSuffixVariation, unsigned long maxResults ) override;
 
@@ -278,14 +284,9 @@ void EpwingDictionary::loadIcon() noexcept
 void EpwingDictionary::loadArticle(
   quint32 address, string & articleHeadword, string & articleText, int & articlePage, int & articleOffset )
 {
-  vector< char > chunk;
-
-  char * articleProps;
+  ChunkedStorage::Chunk chunk;
 
-  {
-    QMutexLocker _( &idxMutex );
-    articleProps = chunks.getBlock( address, chunk );
-  }
+  char const * articleProps = chunks.getBlock( address, chunk );
 
   memcpy( &articlePage, articleProps, sizeof( articlePage ) );
   memcpy( &articleOffset, articleProps + sizeof( articlePage ), sizeof( articleOffset ) );
@@ -425,7 +426,7 @@ QString const & EpwingDictionary::getDescription()
 void EpwingDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
 
@@ -454,13 +455,8 @@ void EpwingDictionary::getArticleText( uint32_t articleAddress, QString & headwo
   headword.clear();
   text.clear();
 
-  vector< char > chunk;
-  char * articleProps;
-
-  {
-    QMutexLocker _( &idxMutex );
-    articleProps = chunks.getBlock( articleAddress, chunk );
-  }
+  ChunkedStorage::Chunk chunk;
+  char const * articleProps = chunks.getBlock( articleAddress, chunk );
 
   uint32_t articlePage, articleOffset;
 
@@ -483,7 +479,7 @@ class EpwingHeadwordsRequest: public Dictionary::WordSearchRequest
   EpwingDictionary & dict;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -491,7 +487,7 @@ public:
     str( word_ ),
     dict( dict_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -501,6 +497,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~EpwingHeadwordsRequest()
@@ -578,7 +577,7 @@ class EpwingArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -591,7 +590,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -606,6 +605,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~EpwingArticleRequest()
@@ -622,14 +624,7 @@ void EpwingArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( auto & alt : alts ) {
-    /// Make an additional query for each alt
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -815,7 +810,7 @@ class EpwingResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -823,7 +818,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -833,6 +828,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~EpwingResourceRequest()
@@ -967,7 +965,7 @@ public:
     BtreeWordSearchRequest( dict_, str_, minLength_, maxSuffixVariation_, allowMiddleMatches_, maxResults_, false ),
     edict( dict_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1260,7 +1258,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
           // That concludes it. Update the header.
 
           idxHeader.signature     = Signature;
-          idxHeader.formatVersion = CurrentFormatVersion;
+          idxHeader.formatVersion =
+            BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
           idxHeader.wordCount    = wordCount;
           idxHeader.articleCount = articleCount;
@@ -68,6 +68,11 @@ public:
     return sr;
   }
 
+  bool prefixMatchNarrowsDown() override
+  {
+    return true;
+  }
+
   sptr< DataRequest > getArticle( wstring const &, vector< wstring > const & alts, wstring const &, bool ) override;
 
 protected:
@@ -337,8 +337,12 @@ bool indexIsOldOrBad( string const & indexFile, bool hasZipFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion || (bool)header.hasZipFile != hasZipFile
-    || ( hasZipFile && header.zipSupportVersion != CurrentZipSupportVersion );
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || (bool)header.hasZipFile != hasZipFile
+    || ( hasZipFile && header.zipSupportVersion != CurrentZipSupportVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.zipIndexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 class GlsDictionary: public BtreeIndexing::BtreeDictionary
@@ -348,7 +352,6 @@ class GlsDictionary: public BtreeIndexing::BtreeDictionary
   IdxHeader idxHeader;
   dictData * dz;
   ChunkedStorage::Reader chunks;
-  QMutex dzMutex;
   QMutex resourceZipMutex;
   IndexedZip resourceZip;
 
@@ -448,6 +451,8 @@ GlsDictionary::GlsDictionary( string const & id, string const & indexFile, vecto
   if ( !dz )
     throw exDictzipError( string( dz_error_str( error ) ) + "(" + getDictionaryFilenames()[ 0 ] + ")" );
 
+  dict_data_set_cache_size( dz, Dictionary::dictzipCacheSize() );
+
   // Read the dictionary name
 
   idx.seek( sizeof( idxHeader ) );
@@ -545,7 +550,7 @@ QString GlsDictionary::getMainFilename()
 void GlsDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -571,13 +576,8 @@ void GlsDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration
 
 void GlsDictionary::loadArticleText( uint32_t address, vector< string > & headwords, string & articleText )
 {
-  vector< char > chunk;
-  char * articleProps;
-  {
-    QMutexLocker _( &idxMutex );
-
-    articleProps = chunks.getBlock( address, chunk );
-  }
+  ChunkedStorage::Chunk chunk;
+  char const * articleProps = chunks.getBlock( address, chunk );
 
   uint32_t articleOffset, articleSize;
 
@@ -586,11 +586,7 @@ void GlsDictionary::loadArticleText( uint32_t address, vector< string > & headwo
 
   char * articleBody;
 
-  {
-    QMutexLocker _( &dzMutex );
-
-    articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-  }
+  articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
   headwords.clear();
   articleText.clear();
@@ -804,7 +800,7 @@ class GlsHeadwordsRequest: public Dictionary::WordSearchRequest
   GlsDictionary & dict;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -812,7 +808,7 @@ public:
     word( word_ ),
     dict( dict_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -822,6 +818,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~GlsHeadwordsRequest()
@@ -891,7 +890,7 @@ class GlsArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -904,7 +903,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -914,6 +913,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~GlsArticleRequest()
@@ -930,15 +932,7 @@ void GlsArticleRequest::run()
     return;
   }
   try {
-    vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-    for ( const auto & alt : alts ) {
-      /// Make an additional query for each alt
-
-      vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-      chain.insert( chain.end(), altChain.begin(), altChain.end() );
-    }
+    vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
     multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1031,7 +1025,7 @@ class GlsResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1039,7 +1033,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1049,6 +1043,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~GlsResourceRequest()
@@ -1357,7 +1354,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
           // That concludes it. Update the header.
 
           idxHeader.signature         = Signature;
-          idxHeader.formatVersion     = CurrentFormatVersion;
+          idxHeader.formatVersion     =
+            BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
           idxHeader.zipSupportVersion = CurrentZipSupportVersion;
 
           idxHeader.articleCount = articleCount;
@@ -13,16 +13,16 @@
 #include <QRunnable>
 #include <QThreadPool>
 #include <QSemaphore>
-#if ( QT_VERSION >= QT_VERSION_CHECK( 6, 0, 0 ) )
-  #include <QtCore5Compat/QRegExp>
-#else
-  #include <QRegExp>
-#endif
+#include <QWaitCondition>
+#include <QRegularExpression>
 #include <QDir>
 #include <QCoreApplication>
 #include <QFileInfo>
 
+#include <list>
+#include <memory>
 #include <set>
+#include <unordered_map>
 #ifndef INCLUDE_LIBRARY_PATH
   #include <hunspell.hxx>
 #else
@@ -31,7 +31,7 @@
 #include "gddebug.hh"
 
 #include "utils.hh"
-#include <QtConcurrent>
+#include "scheduler.hh"
 
 namespace HunspellMorpho {
 
@@ -41,10 +41,121 @@ using gd::wchar;
 
 namespace {
 
-class HunspellDictionary: public Dictionary::Class
+enum {
+  /// The number of the recent results remembered by each dictionary
+  RecentResultsCount = 256
+};
+
+/// Remembers the results of the recent calls for the given words, so that the
+/// same words looked up again on the next keystrokes don't go to Hunspell
+template< typename T >
+class RecentResults
 {
-  string name;
-  Hunspell hunspell;
+public:
+
+  bool find( wstring const & word, T & result )
+  {
+    QMutexLocker _( &mutex );
+
+    auto i = index.find( word );
+
+    if ( i == index.end() )
+      return false;
+
+    // Make it the most recent one
+    entries.splice( entries.begin(), entries, i->second );
+    result = i->second->second;
+
+    return true;
+  }
+
+  void insert( wstring const & word, T const & result )
+  {
+    QMutexLocker _( &mutex );
+
+    auto i = index.find( word );
+
+    if ( i != index.end() ) {
+      entries.splice( entries.begin(), entries, i->second );
+      i->second->second = result;
+      return;
+    }
+
+    entries.emplace_front( word, result );
+    index.emplace( word, entries.begin() );
+
+    if ( entries.size() > RecentResultsCount ) {
+      index.erase( entries.back().first );
+      entries.pop_back();
+    }
+  }
+
+private:
+
+  typedef std::list< std::pair< wstring, T > > Entries;
+
+  QMutex mutex;
+  /// The most recent ones go first
+  Entries entries;
+  std::unordered_map< wstring, typename Entries::iterator > index;
+};
+
+/// What Hunspell says about the spelling of a word
+struct Spelling
+{
+  bool correct = false;
+  /// Whether the suggestions were asked for. The prefix matching only needs to
+  /// know if the word is correct, so it leaves them out
+  bool suggested = false;
+  vector< string > suggestions;
+};
+
+#ifndef HUNSPELL_IS_REENTRANT
+/// We used to have a separate mutex for each Hunspell instance, assuming that
+/// its code was reentrant (though probably not thread-safe). However, crashes
+/// were discovered later when using several Hunspell dictionaries
+/// simultaneously, so with the Hunspell versions before 1.7.0 all the calls
+/// still go through a single mutex - evidently they're not really reentrant.
+static QMutex & getHunspellMutex()
+{
+  static QMutex mutex;
+  return mutex;
+}
+#endif
+
+/// The Hunspell instances of one dictionary. An instance can only be used by
+/// one thread at a time, so the pool makes more of them on demand, up to the
+/// given number, and the threads wait for a free one past that.
+class HunspellPool
+{
+public:
+
+  /// files[ 0 ] should be .aff file, files[ 1 ] should be .dic file.
+  HunspellPool( vector< string > const & files, unsigned maxInstances_ ):
+#ifdef Q_OS_WIN32
+    affFile( Utf8ToLocal8Bit( files[ 0 ] ) ),
+    dicFile( Utf8ToLocal8Bit( files[ 1 ] ) ),
+#else
+    affFile( files[ 0 ] ),
+    dicFile( files[ 1 ] ),
+#endif
+    maxInstances( qMax( maxInstances_, 1u ) )
+  {
+    // The first one is made right away, as it used to be
+    instances.emplace_back( makeInstance() );
+    idle.push_back( instances.back().get() );
+  }
+
+  /// Takes a free instance, waiting for one if needed
+  Hunspell * acquire();
+
+  /// Gives back an instance taken with acquire()
+  void release( Hunspell * );
+
+  RecentResults< QVector< wstring > > stems;
+  RecentResults< Spelling > spellings;
+
+private:
 
 #ifdef Q_OS_WIN32
   static string Utf8ToLocal8Bit( string const & name )
@@ -53,17 +164,130 @@ class HunspellDictionary: public Dictionary::Class
   }
 #endif
 
+  std::unique_ptr< Hunspell > makeInstance();
+
+  string const affFile, dicFile;
+  unsigned const maxInstances;
+
+  QMutex mutex;
+  QWaitCondition released;
+  vector< std::unique_ptr< Hunspell > > instances;
+  vector< Hunspell * > idle;
+  /// The number of the instances being made at the moment
+  unsigned pending = 0;
+};
+
+std::unique_ptr< Hunspell > HunspellPool::makeInstance()
+{
+  // Older Hunspell versions set up some global tables when an instance is
+  // made, so the instances are made one at a time
+#ifdef HUNSPELL_IS_REENTRANT
+  static QMutex constructionMutex;
+  QMutexLocker _( &constructionMutex );
+#else
+  QMutexLocker _( &getHunspellMutex() );
+#endif
+
+  return std::make_unique< Hunspell >( affFile.c_str(), dicFile.c_str() );
+}
+
+Hunspell * HunspellPool::acquire()
+{
+  QMutexLocker _( &mutex );
+
+  for ( ;; ) {
+    if ( !idle.empty() ) {
+      Hunspell * hunspell = idle.back();
+      idle.pop_back();
+      return hunspell;
+    }
+
+    if ( instances.size() + pending < maxInstances ) {
+      ++pending;
+      _.unlock();
+
+      std::unique_ptr< Hunspell > hunspell;
+
+      try {
+        hunspell = makeInstance();
+      }
+      catch ( ... ) {
+        _.relock();
+        --pending;
+        released.wakeOne();
+        throw;
+      }
+
+      _.relock();
+      --pending;
+      instances.emplace_back( std::move( hunspell ) );
+      return instances.back().get();
+    }
+
+    released.wait( &mutex );
+  }
+}
+
+void HunspellPool::release( Hunspell * hunspell )
+{
+  QMutexLocker _( &mutex );
+
+  idle.push_back( hunspell );
+  released.wakeOne();
+}
+
+/// Takes an instance out of the pool for the time of its own life
+class HunspellLease
+{
+public:
+
+  explicit HunspellLease( HunspellPool & pool_ ):
+    pool( pool_ ),
+    hunspell( pool_.acquire() )
+  {
+#ifndef HUNSPELL_IS_REENTRANT
+    getHunspellMutex().lock();
+#endif
+  }
+
+  ~HunspellLease()
+  {
+#ifndef HUNSPELL_IS_REENTRANT
+    getHunspellMutex().unlock();
+#endif
+    pool.release( hunspell );
+  }
+
+  Hunspell & operator*() const
+  {
+    return *hunspell;
+  }
+
+  Hunspell * operator->() const
+  {
+    return hunspell;
+  }
+
+private:
+
+  Q_DISABLE_COPY( HunspellLease )
+
+  HunspellPool & pool;
+  Hunspell * hunspell;
+};
+
+class HunspellDictionary: public Dictionary::Class
+{
+  string name;
+  HunspellPool pool;
+
 public:
 
   /// files[ 0 ] should be .aff file, files[ 1 ] should be .dic file.
-  HunspellDictionary( string const & id, string const & name_, vector< string > const & files ):
+  HunspellDictionary( string const & id, string const & name_, vector< string > const & files, unsigned maxInstances ):
     Dictionary::Class( id, files ),
     name( name_ ),
-#ifdef Q_OS_WIN32
-    hunspell( Utf8ToLocal8Bit( files[ 0 ] ).c_str(), Utf8ToLocal8Bit( files[ 1 ] ).c_str() )
-#else
-    hunspell( files[ 0 ].c_str(), files[ 1 ].c_str() )
-#endif
+    pool( files, maxInstances )
   {
   }
 
@@ -103,20 +327,6 @@ public:
 protected:
 
   void loadIcon() noexcept override;
-
-private:
-
-  // We used to have a separate mutex for each Hunspell instance, assuming
-  // that its code was reentrant (though probably not thread-safe). However,
-  // crashes were discovered later when using several Hunspell dictionaries
-  // simultaneously, and we've switched to have a single mutex for all hunspell
-  // calls - evidently it's not really reentrant.
-  static QMutex & getHunspellMutex()
-  {
-    static QMutex mutex;
-    return mutex;
-  }
-  //  QMutex hunspellMutex;
 };
 
 /// Encodes the given string to be passed to the hunspell object. May throw
@@ -128,13 +338,10 @@ string encodeToHunspell( Hunspell &, wstring const & );
 wstring decodeFromHunspell( Hunspell &, char const * );
 
 /// Generates suggestions via hunspell
-QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & hunspell );
+QVector< wstring > suggest( wstring & word, HunspellPool & pool );
 
 /// Generates suggestions for compound expression
-void getSuggestionsForExpression( wstring const & expression,
-                                  vector< wstring > & suggestions,
-                                  QMutex & hunspellMutex,
-                                  Hunspell & hunspell );
+void getSuggestionsForExpression( wstring const & expression, vector< wstring > & suggestions, HunspellPool & pool );
 
 /// Returns true if the string contains whitespace, false otherwise
 bool containsWhitespace( wstring const & str )
@@ -171,7 +378,7 @@ vector< wstring > HunspellDictionary::getAlternateWritings( wstring const & word
   vector< wstring > results;
 
   if ( containsWhitespace( word ) ) {
-    getSuggestionsForExpression( word, results, getHunspellMutex(), hunspell );
+    getSuggestionsForExpression( word, results, pool );
   }
 
   return results;
@@ -182,21 +389,19 @@ vector< wstring > HunspellDictionary::getAlternateWritings( wstring const & word
 class HunspellArticleRequest: public Dictionary::DataRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & pool;
   wstring word;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
-  HunspellArticleRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellArticleRequest( wstring const & word_, HunspellPool & pool_ ):
+    pool( pool_ ),
     word( word_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -206,6 +411,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~HunspellArticleRequest()
@@ -222,8 +430,6 @@ void HunspellArticleRequest::run()
     return;
   }
 
-  vector< string > suggestions;
-
   try {
     wstring trimmedWord = Folding::trimWhitespaceOrPunct( word );
 
@@ -233,17 +439,29 @@ void HunspellArticleRequest::run()
       return;
     }
 
-    QMutexLocker _( &hunspellMutex );
+    HunspellLease hunspell( pool );
+
+    Spelling spelling;
+
+    if ( !pool.spellings.find( trimmedWord, spelling ) || ( !spelling.correct && !spelling.suggested ) ) {
+      string encodedWord = encodeToHunspell( *hunspell, trimmedWord );
 
-    string encodedWord = encodeToHunspell( hunspell, trimmedWord );
+      spelling.correct = hunspell->spell( encodedWord );
 
-    if ( hunspell.spell( encodedWord ) ) {
+      if ( !spelling.correct )
+        spelling.suggestions = hunspell->suggest( encodedWord );
+
+      spelling.suggested = true;
+      pool.spellings.insert( trimmedWord, spelling );
+    }
+
+    if ( spelling.correct ) {
       // Good word -- no spelling suggestions then.
       finish();
       return;
     }
 
-    suggestions = hunspell.suggest( encodedWord );
+    vector< string > const & suggestions = spelling.suggestions;
     if ( !suggestions.empty() ) {
       // There were some suggestions made for us. Make an appropriate output.
 
@@ -253,7 +471,7 @@ void HunspellArticleRequest::run()
       wstring lowercasedWord = Folding::applySimpleCaseOnly( word );
 
       for ( vector< string >::size_type x = 0; x < suggestions.size(); ++x ) {
-        wstring suggestion = decodeFromHunspell( hunspell, suggestions[ x ].c_str() );
+        wstring suggestion = decodeFromHunspell( *hunspell, suggestions[ x ].c_str() );
 
         if ( Folding::applySimpleCaseOnly( suggestion ) == lowercasedWord ) {
           // If among suggestions we see the same word just with the different
@@ -295,7 +513,7 @@ sptr< DataRequest >
 HunspellDictionary::getArticle( wstring const & word, vector< wstring > const &, wstring const &, bool )
 
 {
-  return std::make_shared< HunspellArticleRequest >( word, getHunspellMutex(), hunspell );
+  return std::make_shared< HunspellArticleRequest >( word, pool );
 }
 
 /// HunspellDictionary::findHeadwordsForSynonym()
@@ -303,22 +521,20 @@ HunspellDictionary::getArticle( wstring const & word, vector< wstring > const &,
 class HunspellHeadwordsRequest: public Dictionary::WordSearchRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & pool;
   wstring word;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 
 public:
 
-  HunspellHeadwordsRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellHeadwordsRequest( wstring const & word_, HunspellPool & pool_ ):
+    pool( pool_ ),
     word( word_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -328,6 +544,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~HunspellHeadwordsRequest()
@@ -357,14 +576,14 @@ void HunspellHeadwordsRequest::run()
   if ( containsWhitespace( trimmedWord ) ) {
     vector< wstring > results;
 
-    getSuggestionsForExpression( trimmedWord, results, hunspellMutex, hunspell );
+    getSuggestionsForExpression( trimmedWord, results, pool );
 
     QMutexLocker _( &dataMutex );
     for ( const auto & result : results )
       matches.push_back( result );
   }
   else {
-    QVector< wstring > suggestions = suggest( trimmedWord, hunspellMutex, hunspell );
+    QVector< wstring > suggestions = suggest( trimmedWord, pool );
 
     if ( !suggestions.empty() ) {
       QMutexLocker _( &dataMutex );
@@ -377,27 +596,31 @@ void HunspellHeadwordsRequest::run()
   finish();
 }
 
-QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & hunspell )
+QVector< wstring > suggest( wstring & word, HunspellPool & pool )
 {
   QVector< wstring > result;
 
+  if ( pool.stems.find( word, result ) )
+    return result;
+
   vector< string > suggestions;
 
   try {
-    QMutexLocker _( &hunspellMutex );
+    HunspellLease hunspell( pool );
 
-    string encodedWord = encodeToHunspell( hunspell, word );
+    string encodedWord = encodeToHunspell( *hunspell, word );
 
-    suggestions = hunspell.analyze( encodedWord );
+    suggestions = hunspell->analyze( encodedWord );
     if ( !suggestions.empty() ) {
       // There were some suggestions made for us. Make an appropriate output.
 
       wstring lowercasedWord = Folding::applySimpleCaseOnly( word );
 
-      static QRegExp cutStem( R"(^\s*st:(((\s+(?!\w{2}:)(?!-)(?!\+))|\S+)+))" );
+      // Matching a const QRegularExpression is thread-safe, unlike QRegExp which keeps the last match in itself
+      static const QRegularExpression cutStem( R"(^\s*st:(((\s+(?!\w{2}:)(?!-)(?!\+))|\S+)+))" );
 
       for ( const auto & x : suggestions ) {
-        QString suggestion = QString::fromStdU32String( decodeFromHunspell( hunspell, x.c_str() ) );
+        QString suggestion = QString::fromStdU32String( decodeFromHunspell( *hunspell, x.c_str() ) );
 
         // Strip comments
         int n = suggestion.indexOf( '#' );
@@ -406,8 +629,9 @@ QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & h
 
         GD_DPRINTF( ">>>Sugg: %s\n", suggestion.toLocal8Bit().data() );
 
-        if ( cutStem.indexIn( suggestion.trimmed() ) != -1 ) {
-          wstring alt = gd::toWString( cutStem.cap( 1 ) );
+        QRegularExpressionMatch match = cutStem.match( suggestion.trimmed() );
+        if ( match.hasMatch() ) {
+          wstring alt = gd::toWString( match.captured( 1 ) );
 
           if ( Folding::applySimpleCaseOnly( alt ) != lowercasedWord ) // No point in providing same word
           {
@@ -419,6 +643,8 @@ QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & h
         }
       }
     }
+
+    pool.stems.insert( word, result );
   }
   catch ( Iconv::Ex & e ) {
     gdWarning( "Hunspell: charset conversion error, no processing's done: %s\n", e.what() );
@@ -431,7 +657,7 @@ QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & h
 sptr< WordSearchRequest > HunspellDictionary::findHeadwordsForSynonym( wstring const & word )
 
 {
-  return std::make_shared< HunspellHeadwordsRequest >( word, getHunspellMutex(), hunspell );
+  return std::make_shared< HunspellHeadwordsRequest >( word, pool );
 }
 
 
@@ -440,21 +666,19 @@ sptr< WordSearchRequest > HunspellDictionary::findHeadwordsForSynonym( wstring c
 class HunspellPrefixMatchRequest: public Dictionary::WordSearchRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & pool;
   wstring word;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
-  HunspellPrefixMatchRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellPrefixMatchRequest( wstring const & word_, HunspellPool & pool_ ):
+    pool( pool_ ),
     word( word_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -464,6 +688,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~HunspellPrefixMatchRequest()
@@ -490,11 +717,19 @@ void HunspellPrefixMatchRequest::run()
       return;
     }
 
-    QMutexLocker _( &hunspellMutex );
+    Spelling spelling;
+
+    if ( !pool.spellings.find( trimmedWord, spelling ) ) {
+      HunspellLease hunspell( pool );
 
-    string encodedWord = encodeToHunspell( hunspell, trimmedWord );
+      spelling.correct = hunspell->spell( encodeToHunspell( *hunspell, trimmedWord ) );
+
+      // A correct word has no suggestions, so the entry is complete then
+      spelling.suggested = spelling.correct;
+      pool.spellings.insert( trimmedWord, spelling );
+    }
 
-    if ( hunspell.spell( encodedWord ) ) {
+    if ( spelling.correct ) {
       // Known word -- add it to the result
 
       QMutexLocker _( &dataMutex );
@@ -512,13 +747,10 @@ void HunspellPrefixMatchRequest::run()
 sptr< WordSearchRequest > HunspellDictionary::prefixMatch( wstring const & word, unsigned long /*maxResults*/ )
 
 {
-  return std::make_shared< HunspellPrefixMatchRequest >( word, getHunspellMutex(), hunspell );
+  return std::make_shared< HunspellPrefixMatchRequest >( word, pool );
 }
 
-void getSuggestionsForExpression( wstring const & expression,
-                                  vector< wstring > & suggestions,
-                                  QMutex & hunspellMutex,
-                                  Hunspell & hunspell )
+void getSuggestionsForExpression( wstring const & expression, vector< wstring > & suggestions, HunspellPool & pool )
 {
   // Analyze each word separately and use the first two suggestions, if any.
   // This is useful for compound expressions where some words is
@@ -569,7 +801,7 @@ void getSuggestionsForExpression( wstring const & expression,
         result.append( word );
     }
     else {
-      QVector< wstring > sugg = suggest( word, hunspellMutex, hunspell );
+      QVector< wstring > sugg = suggest( word, pool );
       int suggNum             = sugg.size() + 1;
       if ( suggNum > 3 )
         suggNum = 3;
@@ -654,7 +886,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::Hunspell const & c
 
         result.push_back( std::make_shared< HunspellDictionary >( Dictionary::makeDictionaryId( dictFiles ),
                                                                   dataFiles[ d ].dictName.toUtf8().data(),
-                                                                  dictFiles ) );
+                                                                  dictFiles,
+                                                                  cfg.maxInstances ) );
         break;
       }
     }
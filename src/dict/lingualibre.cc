@@ -153,6 +153,11 @@ WHERE {
     return sr;
   }
 
+  bool prefixMatchNarrowsDown() override
+  {
+    return true;
+  }
+
   sptr< DataRequest > getArticle( wstring const & word, vector< wstring > const & alts, wstring const &, bool ) override
   {
     if ( word.size() < 50 ) {
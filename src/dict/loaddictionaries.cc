@@ -44,7 +44,11 @@
 
 #include <QMessageBox>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QThreadPool>
 
+#include <functional>
+#include <stdexcept>
 #include <set>
 
 using std::set;
@@ -60,7 +64,8 @@ LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
   exceptionText( "Load did not finish" ), // Will be cleared upon success
   maxPictureWidth( cfg.maxPictureWidth ),
   maxHeadwordSize( cfg.maxHeadwordSize ),
-  maxHeadwordToExpand( cfg.maxHeadwordsToExpand )
+  maxHeadwordToExpand( cfg.maxHeadwordsToExpand ),
+  zimEmbeddedIndexes( cfg.zimEmbeddedIndexes )
 {
   // Populate name filters
 
@@ -93,11 +98,20 @@ LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
 void LoadDictionaries::run()
 {
   try {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Find all the files first, then make the dictionaries out of them
+    vector< vector< string > > filesByDir;
+    QSet< QString > handledDirs;
+
     for ( const auto & path : paths ) {
       qDebug() << "handle path:" << path.path;
-      handlePath( path );
+      handlePath( path, filesByDir, handledDirs );
     }
 
+    makeDictionaries( filesByDir );
+
     // Make soundDirs
     {
       vector< sptr< Dictionary::Class > > soundDirDictionaries =
@@ -106,6 +120,8 @@ void LoadDictionaries::run()
       dictionaries.insert( dictionaries.end(), soundDirDictionaries.begin(), soundDirDictionaries.end() );
     }
 
+    qDebug() << "Loaded" << dictionaries.size() << "local dictionaries in" << timer.elapsed() << "ms";
+
     // Make hunspells
     {
       vector< sptr< Dictionary::Class > > hunspellDictionaries = HunspellMorpho::makeDictionaries( hunspell );
@@ -142,12 +158,30 @@ void LoadDictionaries::addDicts( const std::vector< sptr< Dictionary::Class > >
   std::move( dicts.begin(), dicts.end(), std::back_inserter( dictionaries ) );
 }
 
-void LoadDictionaries::handlePath( Config::Path const & path )
+void LoadDictionaries::handlePath( Config::Path const & path,
+                                   vector< vector< string > > & filesByDir,
+                                   QSet< QString > & handledDirs )
 {
-  vector< string > allFiles;
-
   QDir dir( path.path );
 
+  // The same directory may be reached through several paths. Making its
+  // dictionaries twice would also mean building the same index files
+  // concurrently.
+  QString canonicalPath = dir.canonicalPath();
+
+  if ( !canonicalPath.isEmpty() ) {
+    if ( handledDirs.contains( canonicalPath ) )
+      return;
+
+    handledDirs.insert( canonicalPath );
+  }
+
+  // Reserve our place before the subdirectories, to keep the order
+  size_t dirIndex = filesByDir.size();
+  filesByDir.emplace_back();
+
+  vector< string > allFiles;
+
   QFileInfoList entries = dir.entryInfoList( nameFilters, QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot );
 
   for ( QFileInfoList::const_iterator i = entries.constBegin(); i != entries.constEnd(); ++i ) {
@@ -157,32 +191,120 @@ void LoadDictionaries::handlePath( Config::Path const & path )
       // Make sure the path doesn't look like with dsl resources
       if ( !fullName.endsWith( ".dsl.files", Qt::CaseInsensitive )
            && !fullName.endsWith( ".dsl.dz.files", Qt::CaseInsensitive ) )
-        handlePath( Config::Path( fullName, true ) );
+        handlePath( Config::Path( fullName, true ), filesByDir, handledDirs );
     }
 
     if ( !i->isDir() )
       allFiles.push_back( QDir::toNativeSeparators( fullName ).toStdString() );
   }
 
-  addDicts( Bgl::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Stardict::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
-  addDicts( Lsa::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts(
-    Dsl::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxPictureWidth, maxHeadwordSize ) );
-  addDicts( DictdFiles::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Xdxf::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Sdict::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Aard::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
-  addDicts( ZipSounds::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Mdx::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Gls::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
-  addDicts( Slob::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
+  filesByDir[ dirIndex ] = std::move( allFiles );
+}
+
+void LoadDictionaries::makeDictionaries( vector< vector< string > > const & filesByDir )
+{
+  string const indexDir = Config::getIndexDir().toStdString();
+
+  using Maker = std::function< vector< sptr< Dictionary::Class > >( vector< string > const & ) >;
+
+  struct Format
+  {
+    Maker make;
+    bool serial; // The format's library doesn't allow concurrent use
+  };
+
+  // In the order the dictionaries of each directory are added
+  vector< Format > const formats = {
+    { [ & ]( vector< string > const & files ) { return Bgl::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) {
+        return Stardict::makeDictionaries( files, indexDir, *this, maxHeadwordToExpand );
+      },
+      false },
+    { [ & ]( vector< string > const & files ) { return Lsa::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) {
+        return Dsl::makeDictionaries( files, indexDir, *this, maxPictureWidth, maxHeadwordSize );
+      },
+      false },
+    { [ & ]( vector< string > const & files ) {
+        return DictdFiles::makeDictionaries( files, indexDir, *this );
+      },
+      false },
+    { [ & ]( vector< string > const & files ) { return Xdxf::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) { return Sdict::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) {
+        return Aard::makeDictionaries( files, indexDir, *this, maxHeadwordToExpand );
+      },
+      false },
+    { [ & ]( vector< string > const & files ) {
+        return ZipSounds::makeDictionaries( files, indexDir, *this );
+      },
+      false },
+    { [ & ]( vector< string > const & files ) { return Mdx::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) { return Gls::makeDictionaries( files, indexDir, *this ); }, false },
+    { [ & ]( vector< string > const & files ) {
+        return Slob::makeDictionaries( files, indexDir, *this, maxHeadwordToExpand );
+      },
+      false },
 #ifdef MAKE_ZIM_SUPPORT
-  addDicts( Zim::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
+    { [ & ]( vector< string > const & files ) {
+        return Zim::makeDictionaries( files, indexDir, *this, maxHeadwordToExpand, zimEmbeddedIndexes );
+      },
+      false },
 #endif
 #ifndef NO_EPWING_SUPPORT
-  addDicts( Epwing::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
+    { [ & ]( vector< string > const & files ) { return Epwing::makeDictionaries( files, indexDir, *this ); }, true },
 #endif
+  };
+
+  // One task per directory and format. Each one only touches the files of
+  // its own directory, so they are independent of each other.
+  struct Task
+  {
+    vector< string > const * files;
+    Format const * format;
+    vector< sptr< Dictionary::Class > > dictionaries;
+    string error;
+  };
+
+  vector< Task > tasks;
+  tasks.reserve( filesByDir.size() * formats.size() );
+
+  for ( auto const & files : filesByDir ) {
+    if ( files.empty() )
+      continue;
+
+    for ( auto const & format : formats )
+      tasks.push_back( { &files, &format, {}, {} } );
+  }
+
+  QMutex serialMutex;
+  QThreadPool pool;
+  pool.setMaxThreadCount( QThread::idealThreadCount() );
+
+  for ( auto & task : tasks ) {
+    pool.start( [ &serialMutex, &task ]() {
+      try {
+        if ( task.format->serial ) {
+          QMutexLocker _( &serialMutex );
+          task.dictionaries = task.format->make( *task.files );
+        }
+        else
+          task.dictionaries = task.format->make( *task.files );
+      }
+      catch ( std::exception & e ) {
+        task.error = e.what();
+      }
+    } );
+  }
+
+  pool.waitForDone();
+
+  for ( auto & task : tasks ) {
+    if ( !task.error.empty() )
+      throw std::runtime_error( task.error );
+
+    addDicts( task.dictionaries );
+  }
 }
 
 void LoadDictionaries::indexingDictionary( string const & dictionaryName ) noexcept
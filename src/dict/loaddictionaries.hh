@@ -10,6 +10,7 @@
 
 #include <QThread>
 #include <QNetworkAccessManager>
+#include <QSet>
 
 /// Use loadDictionaries() function below -- this is a helper thread class
 class LoadDictionaries: public QThread, public Dictionary::Initializing
@@ -26,6 +27,7 @@ class LoadDictionaries: public QThread, public Dictionary::Initializing
   int maxPictureWidth;
   unsigned int maxHeadwordSize;
   unsigned int maxHeadwordToExpand;
+  bool zimEmbeddedIndexes;
 
 public:
 
@@ -52,7 +54,17 @@ public:
 
 private:
 
-  void handlePath( Config::Path const & );
+  /// Collects the files in the path, and in its subdirectories if it's
+  /// recursive, appending one list per directory to filesByDir. Directories
+  /// listed in handledDirs already are skipped.
+  void handlePath( Config::Path const &,
+                   std::vector< std::vector< std::string > > & filesByDir,
+                   QSet< QString > & handledDirs );
+
+  /// Makes the dictionaries of every format out of each list of files. The
+  /// lists are processed concurrently on a bounded thread pool, but the
+  /// dictionaries are added in the same order as if it was done one by one.
+  void makeDictionaries( std::vector< std::vector< std::string > > const & filesByDir );
 
   // Helper function that will add a vector of dictionary::Class to the dictionary list
   void addDicts( const std::vector< sptr< Dictionary::Class > > & dicts );
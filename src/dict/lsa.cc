@@ -70,7 +70,8 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements );
 }
 
 string stripExtension( string const & str )
@@ -207,15 +208,7 @@ sptr< Dictionary::DataRequest > LsaDictionary::getArticle( wstring const & word,
                                                            bool ignoreDiacritics )
 
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, string > mainArticles, alternateArticles;
 
@@ -587,7 +580,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         idx.rewind();
 
@@ -36,7 +36,6 @@
 #include <QRegularExpression>
 #include <QString>
 #include <QThreadPool>
-#include <QtConcurrent>
 
 namespace Mdx {
 
@@ -98,20 +97,100 @@ __attribute__( ( packed ) )
 #endif
 ;
 
+/// Keeps the most recently decompressed record blocks of the .mdx and .mdd
+/// files of a dictionary. Neighbouring headwords and resources usually share
+/// their blocks, so this saves decompressing the same block over and over.
+class RecordBlockCache
+{
+public:
+
+  using Block = sptr< QByteArray const >;
+
+  /// Returns the decompressed block the given record is in. The file is only
+  /// accessed with fileMutex locked, the decompression is done without it.
+  /// Returns nullptr if the block can't be read or is corrupted.
+  Block get( QFile & file, QMutex & fileMutex, MdictParser::RecordInfo const & recordInfo );
+
+private:
+
+  enum {
+    MaxBlocks = 16
+  };
+
+  using Key = pair< QFile const *, qint64 >;
+
+  QMutex mutex;
+  vector< pair< Key, Block > > blocks; // Most recently used first
+};
+
+RecordBlockCache::Block
+RecordBlockCache::get( QFile & file, QMutex & fileMutex, MdictParser::RecordInfo const & recordInfo )
+{
+  Key key( &file, recordInfo.compressedBlockPos );
+
+  {
+    QMutexLocker _( &mutex );
+
+    for ( auto i = blocks.begin(); i != blocks.end(); ++i )
+      if ( i->first == key ) {
+        std::rotate( blocks.begin(), i, i + 1 );
+        return blocks.front().second;
+      }
+  }
+
+  QByteArray compressed;
+
+  {
+    QMutexLocker _( &fileMutex );
+
+    if ( !file.seek( recordInfo.compressedBlockPos ) )
+      return {};
+
+    compressed = file.read( recordInfo.compressedBlockSize );
+  }
+
+  if ( compressed.size() != recordInfo.compressedBlockSize )
+    return {};
+
+  auto decompressed = std::make_shared< QByteArray >();
+
+  if ( !MdictParser::parseCompressedBlock( recordInfo.compressedBlockSize,
+                                           compressed.constData(),
+                                           recordInfo.decompressedBlockSize,
+                                           *decompressed ) )
+    return {};
+
+  QMutexLocker _( &mutex );
+
+  // Another thread might have decompressed the same block meanwhile
+  for ( auto const & block : blocks )
+    if ( block.first == key )
+      return block.second;
+
+  if ( blocks.size() >= MaxBlocks )
+    blocks.pop_back();
+
+  blocks.emplace( blocks.begin(), key, decompressed );
+
+  return decompressed;
+}
+
 // A helper method to read resources from .mdd file
 class IndexedMdd: public BtreeIndexing::BtreeIndex
 {
   QMutex & idxMutex;
   QMutex fileMutex;
   ChunkedStorage::Reader & chunks;
+  RecordBlockCache & recordBlocks;
   QFile mddFile;
   bool isFileOpen;
 
 public:
 
-  IndexedMdd( QMutex & idxMutex, ChunkedStorage::Reader & chunks ):
+  IndexedMdd( QMutex & idxMutex, ChunkedStorage::Reader & chunks, RecordBlockCache & recordBlocks ):
     idxMutex( idxMutex ),
     chunks( chunks ),
+    recordBlocks( recordBlocks ),
     isFileOpen( false )
   {
   }
@@ -155,7 +234,7 @@ public:
       return false;
 
     MdictParser::RecordInfo indexEntry;
-    vector< char > chunk;
+    ChunkedStorage::Chunk chunk;
     // QMutexLocker _( &idxMutex );
     const char * indexEntryPtr = chunks.getBlock( links[ 0 ].articleOffset, chunk );
     memcpy( &indexEntry, indexEntryPtr, sizeof( indexEntry ) );
@@ -165,25 +244,14 @@ public:
       return false;
     }
 
-    QByteArray decompressed;
+    RecordBlockCache::Block decompressed = recordBlocks.get( mddFile, idxMutex, indexEntry );
 
-    {
-      QMutexLocker _( &idxMutex );
-      ScopedMemMap compressed( mddFile, indexEntry.compressedBlockPos, indexEntry.compressedBlockSize );
-      if ( !compressed.startAddress() ) {
-        return false;
-      }
-
-      if ( !MdictParser::parseCompressedBlock( indexEntry.compressedBlockSize,
-                                               (char *)compressed.startAddress(),
-                                               indexEntry.decompressedBlockSize,
-                                               decompressed ) ) {
-        return false;
-      }
+    if ( !decompressed || decompressed->size() < indexEntry.recordOffset + indexEntry.recordSize ) {
+      return false;
     }
 
     result.resize( indexEntry.recordSize );
-    memcpy( &result.front(), decompressed.constData() + indexEntry.recordOffset, indexEntry.recordSize );
+    memcpy( result.data(), decompressed->constData() + indexEntry.recordOffset, indexEntry.recordSize );
     return true;
   }
 };
@@ -197,6 +265,7 @@ class MdxDictionary: public BtreeIndexing::BtreeDictionary
   string encoding;
   ChunkedStorage::Reader chunks;
   QFile dictFile;
+  RecordBlockCache recordBlocks; // Shared with mddResources, so goes before them
   vector< sptr< IndexedMdd > > mddResources;
   MdictParser::StyleSheets styleSheets;
 
@@ -347,7 +416,7 @@ void MdxDictionary::deferredInit()
       return;
 
     if ( !deferredInitRunnableStarted ) {
-      QThreadPool::globalInstance()->start(
+      Scheduler::pool( Scheduler::Background ).start(
         [ this ]() {
           this->doDeferredInit();
         },
@@ -418,7 +487,7 @@ void MdxDictionary::doDeferredInit()
         if ( fi.fileName() != mddFileName || !fi.exists() )
           continue;
 
-        sptr< IndexedMdd > mdd = std::make_shared< IndexedMdd >( idxMutex, chunks );
+        sptr< IndexedMdd > mdd = std::make_shared< IndexedMdd >( idxMutex, chunks, recordBlocks );
         mdd->openIndex( mddIndexInfos[ i - 1 ], idx, idxMutex );
         mdd->open( dictFiles[ i ].c_str() );
         mddResources.push_back( mdd );
@@ -438,7 +507,7 @@ void MdxDictionary::doDeferredInit()
 void MdxDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -502,7 +571,7 @@ class MdxArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -515,7 +584,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -525,6 +594,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~MdxArticleRequest() override
@@ -548,13 +620,7 @@ void MdxArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   // Some synonims make it that the articles appear several times. We combat this
   // by only allowing them to appear once.
@@ -645,7 +711,7 @@ class MddResourceRequest: public Dictionary::DataRequest
   MdxDictionary & dict;
   wstring resourceName;
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -654,7 +720,7 @@ public:
     dict( dict_ ),
     resourceName( Utf8::decode( resourceName_ ) )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -665,6 +731,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~MddResourceRequest()
@@ -818,8 +887,8 @@ const QString & MdxDictionary::getDescription()
   }
   else {
     // QMutexLocker _( &idxMutex );
-    vector< char > chunk;
-    char * dictDescription = chunks.getBlock( idxHeader.descriptionAddress, chunk );
+    ChunkedStorage::Chunk chunk;
+    char const * dictDescription = chunks.getBlock( idxHeader.descriptionAddress, chunk );
     string str( dictDescription );
     dictionaryDescription = QString::fromUtf8( str.c_str(), str.size() );
   }
@@ -848,7 +917,7 @@ void MdxDictionary::loadIcon() noexcept
 
 void MdxDictionary::loadArticle( uint32_t offset, string & articleText, bool noFilter )
 {
-  vector< char > chunk;
+  ChunkedStorage::Chunk chunk;
   // QMutexLocker _( &idxMutex );
 
   // Load record info from index
@@ -856,23 +925,13 @@ void MdxDictionary::loadArticle( uint32_t offset, string & articleText, bool noF
   const char * pRecordInfo = chunks.getBlock( offset, chunk );
   memcpy( &recordInfo, pRecordInfo, sizeof( recordInfo ) );
 
-  QByteArray decompressed;
+  RecordBlockCache::Block decompressed = recordBlocks.get( dictFile, idxMutex, recordInfo );
 
-  {
-    QMutexLocker _( &idxMutex );
-    ScopedMemMap compressed( dictFile, recordInfo.compressedBlockPos, recordInfo.compressedBlockSize );
-    if ( !compressed.startAddress() )
-      throw exCorruptDictionary();
-
-    if ( !MdictParser::parseCompressedBlock( recordInfo.compressedBlockSize,
-                                             (char *)compressed.startAddress(),
-                                             recordInfo.decompressedBlockSize,
-                                             decompressed ) )
-      throw exCorruptDictionary();
-  }
+  if ( !decompressed || decompressed->size() < recordInfo.recordOffset + recordInfo.recordSize )
+    throw exCorruptDictionary();
 
   QString article =
-    MdictParser::toUtf16( encoding.c_str(), decompressed.constData() + recordInfo.recordOffset, recordInfo.recordSize );
+    MdictParser::toUtf16( encoding.c_str(), decompressed->constData() + recordInfo.recordOffset, recordInfo.recordSize );
 
   if ( !noFilter ) {
     article = MdictParser::substituteStylesheet( article, styleSheets );
@@ -1236,8 +1295,11 @@ static bool indexIsOldOrBad( vector< string > const & dictFiles, string const &
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != kSignature
-    || header.formatVersion != kCurrentFormatVersion || header.parserVersion != MdictParser::kParserVersion
-    || header.foldingVersion != Folding::Version || header.mddIndexInfosCount != dictFiles.size() - 1;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, kCurrentFormatVersion )
+    || header.parserVersion != MdictParser::kParserVersion
+    || header.foldingVersion != Folding::Version || header.mddIndexInfosCount != dictFiles.size() - 1
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 static void findResourceFiles( string const & mdx, vector< string > & dictFiles )
@@ -1436,7 +1498,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
 
       // That concludes it. Update the header.
       idxHeader.signature      = kSignature;
-      idxHeader.formatVersion  = kCurrentFormatVersion;
+      idxHeader.formatVersion  =
+        BtreeIndexing::formatVersionToWrite( kCurrentFormatVersion, idxHeader.indexBtreeMaxElements );
       idxHeader.parserVersion  = MdictParser::kParserVersion;
       idxHeader.foldingVersion = Folding::Version;
       idxHeader.articleCount   = parser.wordCount();
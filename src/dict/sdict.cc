@@ -117,7 +117,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 class SdictDictionary: public BtreeIndexing::BtreeDictionary
@@ -378,7 +380,7 @@ void SdictDictionary::loadArticle( uint32_t address, string & articleText )
 void SdictDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -445,7 +447,7 @@ class SdictArticleRequest: public Dictionary::DataRequest
 
   QAtomicInt isCancelled;
 
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -458,7 +460,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -468,6 +470,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~SdictArticleRequest()
@@ -484,15 +489,7 @@ void SdictArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -763,7 +760,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         idxHeader.articleCount = articleOffsets.size();
         idxHeader.wordCount    = wordCount;
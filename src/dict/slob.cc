@@ -34,6 +34,7 @@
 #endif
 #include <QProcess>
 #include <QVector>
+#include <QMutex>
 
 #include <QRegularExpression>
 
@@ -42,6 +43,7 @@
 #include <map>
 #include <set>
 #include <algorithm>
+#include <list>
 
 namespace Slob {
 
@@ -108,7 +110,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.resourceIndexBtreeMaxElements );
 }
 
 
@@ -127,6 +131,12 @@ private:
     LZMA2
   };
 
+  enum {
+    /// The number of decompressed items (bins) kept, the most recently used
+    /// ones. An article and its pictures are often stored in different ones.
+    ItemCacheSize = 8
+  };
+
   QFile file;
   QString fileName, dictionaryName;
   Compressions compression;
@@ -139,15 +149,35 @@ private:
   quint64 storeOffset, fileSize, refsOffset;
   quint32 refsCount, itemsCount;
   quint64 itemsOffset, itemsDataOffset;
-  quint32 currentItem;
   quint32 contentTypesCount;
-  string currentItemData;
   RefOffsetsVector refsOffsetVector;
 
+  // The whole file mapped to memory, or nullptr if it couldn't be
+  uchar const * mapping;
+  qint64 mappingSize;
+  /// Guards the file, which is only read when it isn't mapped
+  QMutex fileMutex;
+
+  /// Decompressed items by their indices, most recently used first
+  std::list< pair< quint32, sptr< string const > > > itemCache;
+  QMutex itemCacheMutex;
+
   QString readTinyText();
   QString readText();
   QString readLargeText();
   QString readString( unsigned length );
+  QString decodeString( QByteArray const & data ) const;
+
+  /// Reads the given number of bytes at the given offset, from the mapping
+  /// if there's one. Throws on failure. Can be called from several threads.
+  void readAt( quint64 offset, void * buffer, quint64 size );
+
+  /// Reads a string of the given length at the given offset
+  QString readStringAt( quint64 offset, unsigned length );
+
+  /// Returns the decompressed data of the item, its compressed data being
+  /// at the given offset. Returns nullptr if it can't be decompressed.
+  sptr< string const > getItemData( quint32 itemIndex, quint64 offset );
 
 public:
   SlobFile():
@@ -161,8 +191,9 @@ public:
     itemsCount( 0 ),
     itemsOffset( 0 ),
     itemsDataOffset( 0 ),
-    currentItem( 0xFFFFFFFF ),
-    contentTypesCount( 0 )
+    contentTypesCount( 0 ),
+    mapping( nullptr ),
+    mappingSize( 0 )
   {
   }
 
@@ -227,6 +258,8 @@ public:
 
   void open( const QString & name );
 
+  /// The functions below can be called from several threads at once
+
   void getRefEntryAtOffset( quint64 offset, RefEntry & entry );
 
   void getRefEntry( quint32 ref_nom, RefEntry & entry );
@@ -241,7 +274,11 @@ SlobFile::~SlobFile()
 
 QString SlobFile::readString( unsigned length )
 {
-  QByteArray data = file.read( length );
+  return decodeString( file.read( length ) );
+}
+
+QString SlobFile::decodeString( QByteArray const & data ) const
+{
   QString str;
 
   if ( codec != 0 && !data.isEmpty() )
@@ -287,10 +324,40 @@ QString SlobFile::readLargeText()
   return readString( qFromBigEndian( len ) );
 }
 
+void SlobFile::readAt( quint64 offset, void * buffer, quint64 size )
+{
+  if ( mapping ) {
+    if ( offset > (quint64)mappingSize || size > (quint64)mappingSize - offset )
+      throw exCantReadFile( string( ( fileName + ": out of file bounds" ).toUtf8().data() ) );
+
+    memcpy( buffer, mapping + offset, size );
+    return;
+  }
+
+  QMutexLocker _( &fileMutex );
+
+  if ( !file.seek( offset ) || file.read( (char *)buffer, size ) != (qint64)size ) {
+    QString error = fileName + ": " + file.errorString();
+    throw exCantReadFile( string( error.toUtf8().data() ) );
+  }
+}
+
+QString SlobFile::readStringAt( quint64 offset, unsigned length )
+{
+  QByteArray data( length, 0 );
+  readAt( offset, data.data(), length );
+  return decodeString( data );
+}
+
 void SlobFile::open( const QString & name )
 {
   QString error( name + ": " );
 
+  // Closing the file unmaps it
+  mapping     = nullptr;
+  mappingSize = 0;
+  itemCache.clear();
+
   if ( file.isOpen() )
     file.close();
 
@@ -399,6 +466,13 @@ void SlobFile::open( const QString & name )
     itemsOffset     = storeOffset + sizeof( itemsCount );
     itemsDataOffset = itemsOffset + itemsCount * sizeof( quint64 );
 
+    // Map the file, so the tables and items can be read without seeking it.
+    // That may well fail for the large files on 32-bit systems, in which case
+    // they are read as usual.
+    mapping = file.map( 0, file.size() );
+    if ( mapping )
+      mappingSize = file.size();
+
     return;
   }
   error += file.errorString();
@@ -414,159 +488,174 @@ const SlobFile::RefOffsetsVector & SlobFile::getSortedRefOffsets()
   refsOffsetVector.clear();
   refsOffsetVector.reserve( refsCount );
 
-  for ( ;; ) {
-    QByteArray offsets;
-    offsets.resize( size );
+  QByteArray offsets;
+  offsets.resize( size );
 
-    if ( !file.seek( refsOffset ) || file.read( offsets.data(), size ) != size )
-      break;
+  readAt( refsOffset, offsets.data(), size );
 
-    for ( quint32 i = 0; i < refsCount; i++ ) {
-      memcpy( &tmp, offsets.data() + i * sizeof( quint64 ), sizeof( tmp ) );
-      refsOffsetVector.append( RefEntryOffsetItem( base + qFromBigEndian( tmp ), i ) );
-    }
-
-    std::sort( refsOffsetVector.begin(), refsOffsetVector.end() );
-    return refsOffsetVector;
+  for ( quint32 i = 0; i < refsCount; i++ ) {
+    memcpy( &tmp, offsets.data() + i * sizeof( quint64 ), sizeof( tmp ) );
+    refsOffsetVector.append( RefEntryOffsetItem( base + qFromBigEndian( tmp ), i ) );
   }
-  QString error = fileName + ": " + file.errorString();
-  throw exCantReadFile( string( error.toUtf8().data() ) );
+
+  std::sort( refsOffsetVector.begin(), refsOffsetVector.end() );
+  return refsOffsetVector;
 }
 
 void SlobFile::getRefEntryAtOffset( quint64 offset, RefEntry & entry )
 {
-  for ( ;; ) {
-    if ( !file.seek( offset ) )
-      break;
+  quint16 keyLength;
+  readAt( offset, &keyLength, sizeof( keyLength ) );
+  offset += sizeof( keyLength );
 
-    entry.key = readText();
+  entry.key = readStringAt( offset, qFromBigEndian( keyLength ) );
+  offset += qFromBigEndian( keyLength );
 
-    quint32 index;
-    if ( file.read( (char *)&index, sizeof( index ) ) != sizeof( index ) )
-      break;
-    entry.itemIndex = qFromBigEndian( index );
+  quint32 index;
+  readAt( offset, &index, sizeof( index ) );
+  offset += sizeof( index );
+  entry.itemIndex = qFromBigEndian( index );
 
-    quint16 binIndex;
-    if ( file.read( (char *)&binIndex, sizeof( binIndex ) ) != sizeof( binIndex ) )
-      break;
-    entry.binIndex = qFromBigEndian( binIndex );
+  quint16 binIndex;
+  readAt( offset, &binIndex, sizeof( binIndex ) );
+  offset += sizeof( binIndex );
+  entry.binIndex = qFromBigEndian( binIndex );
 
-    entry.fragment = readTinyText();
+  unsigned char fragmentLength;
+  readAt( offset, &fragmentLength, sizeof( fragmentLength ) );
+  offset += sizeof( fragmentLength );
 
-    return;
-  }
-  QString error = fileName + ": " + file.errorString();
-  throw exCantReadFile( string( error.toUtf8().data() ) );
+  entry.fragment = readStringAt( offset, fragmentLength );
 }
 
 void SlobFile::getRefEntry( quint32 ref_nom, RefEntry & entry )
 {
-  quint64 pos = refsOffset + ref_nom * sizeof( quint64 );
-  quint64 offset, tmp;
+  quint64 tmp;
 
-  for ( ;; ) {
-    if ( !file.seek( pos ) || file.read( (char *)&tmp, sizeof( tmp ) ) != sizeof( tmp ) )
-      break;
+  readAt( refsOffset + ref_nom * sizeof( quint64 ), &tmp, sizeof( tmp ) );
 
-    offset = qFromBigEndian( tmp ) + refsOffset + refsCount * sizeof( quint64 );
+  getRefEntryAtOffset( qFromBigEndian( tmp ) + refsOffset + refsCount * sizeof( quint64 ), entry );
+}
 
-    getRefEntryAtOffset( offset, entry );
+sptr< string const > SlobFile::getItemData( quint32 itemIndex, quint64 offset )
+{
+  {
+    QMutexLocker _( &itemCacheMutex );
 
-    return;
+    for ( auto i = itemCache.begin(); i != itemCache.end(); ++i ) {
+      if ( i->first == itemIndex ) {
+        itemCache.splice( itemCache.begin(), itemCache, i );
+        return i->second;
+      }
+    }
   }
-  QString error = fileName + ": " + file.errorString();
-  throw exCantReadFile( string( error.toUtf8().data() ) );
+
+  // Not cached -- read and decompress it without holding any lock
+
+  quint32 length, length_be;
+  readAt( offset, &length_be, sizeof( length_be ) );
+  length = qFromBigEndian( length_be );
+  offset += sizeof( length_be );
+
+  QByteArray buffer;
+  char const * compressedData;
+
+  if ( mapping ) {
+    if ( offset + length > (quint64)mappingSize )
+      return {};
+
+    compressedData = (char const *)mapping + offset;
+  }
+  else {
+    buffer.resize( length );
+    readAt( offset, buffer.data(), length );
+    compressedData = buffer.constData();
+  }
+
+  auto itemData = std::make_shared< string >();
+
+  if ( compression == NONE )
+    itemData->assign( compressedData, length );
+  else if ( compression == ZLIB )
+    *itemData = decompressZlib( compressedData, length );
+  else if ( compression == BZ2 )
+    *itemData = decompressBzip2( compressedData, length );
+  else
+    *itemData = decompressLzma2( compressedData, length, true );
+
+  if ( itemData->empty() )
+    return {};
+
+  QMutexLocker _( &itemCacheMutex );
+
+  for ( auto const & cached : itemCache ) {
+    if ( cached.first == itemIndex )
+      return cached.second; // Another thread has decompressed it meanwhile
+  }
+
+  itemCache.emplace_front( itemIndex, itemData );
+
+  if ( itemCache.size() > ItemCacheSize )
+    itemCache.pop_back();
+
+  return itemData;
 }
 
 quint8 SlobFile::getItem( RefEntry const & entry, string * data )
 {
-  quint64 pos = itemsOffset + entry.itemIndex * sizeof( quint64 );
-  quint64 offset, tmp;
+  quint64 tmp;
 
-  for ( ;; ) {
-    // Read item data types
+  // Read item data types
 
-    if ( !file.seek( pos ) || file.read( (char *)&tmp, sizeof( tmp ) ) != sizeof( tmp ) )
-      break;
+  readAt( itemsOffset + entry.itemIndex * sizeof( quint64 ), &tmp, sizeof( tmp ) );
 
-    offset = qFromBigEndian( tmp ) + itemsDataOffset;
+  quint64 offset = qFromBigEndian( tmp ) + itemsDataOffset;
 
-    if ( !file.seek( offset ) )
-      break;
+  quint32 bins, bins_be;
+  readAt( offset, &bins_be, sizeof( bins_be ) );
+  bins = qFromBigEndian( bins_be );
 
-    quint32 bins, bins_be;
-    if ( file.read( (char *)&bins_be, sizeof( bins_be ) ) != sizeof( bins_be ) )
-      break;
-    bins = qFromBigEndian( bins_be );
+  if ( entry.binIndex >= bins )
+    return 0xFF;
 
-    if ( entry.binIndex >= bins )
-      return 0xFF;
+  quint8 id;
+  readAt( offset + sizeof( bins_be ) + entry.binIndex, &id, sizeof( id ) );
 
-    QVector< quint8 > ids;
-    ids.resize( bins );
-    if ( file.read( (char *)ids.data(), bins ) != bins )
-      break;
+  if ( id >= (unsigned)contentTypes.size() )
+    return 0xFF;
 
-    quint8 id = ids[ entry.binIndex ];
+  if ( data != 0 ) {
+    // Read item data
+    sptr< string const > itemData = getItemData( entry.itemIndex, offset + sizeof( bins_be ) + bins );
 
-    if ( id >= (unsigned)contentTypes.size() )
+    if ( !itemData )
       return 0xFF;
 
-    if ( data != 0 ) {
-      // Read item data
-      if ( currentItem != entry.itemIndex ) {
-        currentItemData.clear();
-        quint32 length, length_be;
-        if ( file.read( (char *)&length_be, sizeof( length_be ) ) != sizeof( length_be ) )
-          break;
-        length = qFromBigEndian( length_be );
-
-        QByteArray compressedData = file.read( length );
-
-        if ( compression == NONE )
-          currentItemData = string( compressedData.data(), compressedData.length() );
-        else if ( compression == ZLIB )
-          currentItemData = decompressZlib( compressedData.data(), length );
-        else if ( compression == BZ2 )
-          currentItemData = decompressBzip2( compressedData.data(), length );
-        else
-          currentItemData = decompressLzma2( compressedData.data(), length, true );
-
-        if ( currentItemData.empty() ) {
-          currentItem = 0xFFFFFFFF;
-          return 0xFF;
-        }
-        currentItem = entry.itemIndex;
-      }
-
-      // Find bin data inside item
-
-      const char * ptr = currentItemData.c_str();
-      quint32 pos      = entry.binIndex * sizeof( quint32 );
+    // Find bin data inside item
 
-      if ( pos >= currentItemData.length() - sizeof( quint32 ) )
-        return 0xFF;
+    const char * ptr = itemData->c_str();
+    quint32 pos      = entry.binIndex * sizeof( quint32 );
 
-      quint32 offset, offset_be;
-      memcpy( &offset_be, ptr + pos, sizeof( offset_be ) );
-      offset = qFromBigEndian( offset_be );
+    if ( pos >= itemData->length() - sizeof( quint32 ) )
+      return 0xFF;
 
-      pos = bins * sizeof( quint32 ) + offset;
+    quint32 binOffset, offset_be;
+    memcpy( &offset_be, ptr + pos, sizeof( offset_be ) );
+    binOffset = qFromBigEndian( offset_be );
 
-      if ( pos >= currentItemData.length() - sizeof( quint32 ) )
-        return 0xFF;
+    pos = bins * sizeof( quint32 ) + binOffset;
 
-      quint32 length, len_be;
-      memcpy( &len_be, ptr + pos, sizeof( len_be ) );
-      length = qFromBigEndian( len_be );
+    if ( pos >= itemData->length() - sizeof( quint32 ) )
+      return 0xFF;
 
-      *data = currentItemData.substr( pos + sizeof( len_be ), length );
-    }
+    quint32 length, len_be;
+    memcpy( &len_be, ptr + pos, sizeof( len_be ) );
+    length = qFromBigEndian( len_be );
 
-    return ids[ entry.binIndex ];
+    *data = itemData->substr( pos + sizeof( len_be ), length );
   }
-  QString error = fileName + ": " + file.errorString();
-  throw exCantReadFile( string( error.toUtf8().data() ) );
+
+  return id;
 }
 
 // SlobDictionary
@@ -574,7 +663,7 @@ quint8 SlobFile::getItem( RefEntry const & entry, string * data )
 class SlobDictionary: public BtreeIndexing::BtreeDictionary
 {
   QMutex idxMutex;
-  QMutex slobMutex, idxResourceMutex;
+  QMutex idxResourceMutex;
   File::Class idx;
   BtreeIndex resourceIndex;
   IdxHeader idxHeader;
@@ -998,12 +1087,9 @@ quint32 SlobDictionary::readArticle( quint32 articleNumber, std::string & result
   string data;
   quint8 contentId;
 
-  {
-    QMutexLocker _( &slobMutex );
-    if ( entry.key.isEmpty() )
-      sf.getRefEntry( articleNumber, entry );
-    contentId = sf.getItem( entry, &data );
-  }
+  if ( entry.key.isEmpty() )
+    sf.getRefEntry( articleNumber, entry );
+  contentId = sf.getItem( entry, &data );
 
   if ( contentId == 0xFF )
     return 0xFFFFFFFF;
@@ -1028,10 +1114,7 @@ quint32 SlobDictionary::readArticle( quint32 articleNumber, std::string & result
 quint64 SlobDictionary::getArticlePos( uint32_t articleNumber )
 {
   RefEntry entry;
-  {
-    QMutexLocker _( &slobMutex );
-    sf.getRefEntry( articleNumber, entry );
-  }
+  sf.getRefEntry( articleNumber, entry );
   return ( ( (quint64)( entry.binIndex ) ) << 32 ) | entry.itemIndex;
 }
 
@@ -1043,7 +1126,7 @@ void SlobDictionary::sortArticlesOffsetsForFTS( QVector< uint32_t > & offsets, Q
 void SlobDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -1120,7 +1203,7 @@ class SlobArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1133,7 +1216,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1143,6 +1226,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~SlobArticleRequest()
@@ -1160,15 +1246,7 @@ void SlobArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1269,7 +1347,7 @@ class SlobResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1277,7 +1355,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1287,6 +1365,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~SlobResourceRequest()
@@ -1456,7 +1537,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         }
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         idxHeader.articleCount = articleCount;
         idxHeader.wordCount    = wordCount;
@@ -15,6 +15,7 @@
 #include "utils.hh"
 
 #include <set>
+#include <string.h>
 #include <QDir>
 #include <QFileInfo>
 
@@ -57,7 +58,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 class SoundDirDictionary: public BtreeIndexing::BtreeDictionary
@@ -130,15 +133,7 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getArticle( wstring const &
                                                                 wstring const &,
                                                                 bool ignoreDiacritics )
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   // maps to the chain number
   multimap< wstring, unsigned > mainArticles, alternateArticles;
@@ -180,8 +175,8 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getArticle( wstring const &
   multimap< wstring, uint32_t >::const_iterator i;
 
   string displayedName;
-  vector< char > chunk;
-  char * nameBlock;
+  ChunkedStorage::Chunk chunk;
+  char const * nameBlock;
 
   result += "<table class=\"lsa_play\">";
 
@@ -192,17 +187,16 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getArticle( wstring const &
       displayedName = chain[ i->second ].word;
     else {
       try {
-        QMutexLocker _( &idxMutex );
         nameBlock = chunks.getBlock( address, chunk );
 
-        if ( nameBlock >= &chunk.front() + chunk.size() ) {
+        if ( nameBlock >= chunk->data() + chunk->size() ) {
           // chunks reader thinks it's okay since zero-sized records can exist,
           // but we don't allow that.
           throw ChunkedStorage::exAddressOutOfRange();
         }
 
-        chunk.back()  = 0; // It must end with 0 anyway, but just in case
-        displayedName = string( nameBlock );
+        // It must end with 0 anyway, but never read past the chunk just in case
+        displayedName = string( nameBlock, strnlen( nameBlock, chunk->data() + chunk->size() - nameBlock ) );
       }
       catch ( ChunkedStorage::exAddressOutOfRange & ) {
         // Bad address
@@ -239,17 +233,16 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getArticle( wstring const &
       displayedName = chain[ i->second ].word;
     else {
       try {
-        QMutexLocker _( &idxMutex );
         nameBlock = chunks.getBlock( address, chunk );
 
-        if ( nameBlock >= &chunk.front() + chunk.size() ) {
+        if ( nameBlock >= chunk->data() + chunk->size() ) {
           // chunks reader thinks it's okay since zero-sized records can exist,
           // but we don't allow that.
           throw ChunkedStorage::exAddressOutOfRange();
         }
 
-        chunk.back()  = 0; // It must end with 0 anyway, but just in case
-        displayedName = string( nameBlock );
+        // It must end with 0 anyway, but never read past the chunk just in case
+        displayedName = string( nameBlock, strnlen( nameBlock, chunk->data() + chunk->size() - nameBlock ) );
       }
       catch ( ChunkedStorage::exAddressOutOfRange & ) {
         // Bad address
@@ -305,15 +298,13 @@ void SoundDirDictionary::loadIcon() noexcept
 
 bool SoundDirDictionary::get_file_name( uint32_t articleOffset, QString & file_name )
 {
-  vector< char > chunk;
-  char * articleData;
+  ChunkedStorage::Chunk chunk;
+  char const * articleData;
 
   try {
-    QMutexLocker _( &idxMutex );
-
     articleData = chunks.getBlock( articleOffset, chunk );
 
-    if ( articleData >= &chunk.front() + chunk.size() ) {
+    if ( articleData >= chunk->data() + chunk->size() ) {
       // chunks reader thinks it's okay since zero-sized records can exist,
       // but we don't allow that.
       throw ChunkedStorage::exAddressOutOfRange();
@@ -323,8 +314,8 @@ bool SoundDirDictionary::get_file_name( uint32_t articleOffset, QString & file_n
     return false; // No such resource
   }
 
-  chunk.back() = 0; // It must end with 0 anyway, but just in case
-  file_name    = QString::fromUtf8( articleData );
+  // It must end with 0 anyway, but never read past the chunk just in case
+  file_name = QString::fromUtf8( articleData, strnlen( articleData, chunk->data() + chunk->size() - articleData ) );
   return true;
 }
 
@@ -480,7 +471,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
       // That concludes it. Update the header.
 
       idxHeader.signature     = Signature;
-      idxHeader.formatVersion = CurrentFormatVersion;
+      idxHeader.formatVersion =
+        BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
       idx.rewind();
 
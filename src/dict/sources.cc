@@ -353,6 +353,7 @@ Config::Hunspell Sources::getHunspell() const
 
   h.dictionariesPath    = ui.hunspellPath->text();
   h.enabledDictionaries = hunspellDictsModel.getEnabledDictionaries();
+  h.maxInstances        = hunspellDictsModel.getMaxInstances();
 
   return h;
 }
@@ -1308,7 +1309,8 @@ bool SoundDirsModel::setData( QModelIndex const & index, const QVariant & value,
 
 HunspellDictsModel::HunspellDictsModel( QWidget * parent, Config::Hunspell const & hunspell ):
   QAbstractItemModel( parent ),
-  enabledDictionaries( hunspell.enabledDictionaries )
+  enabledDictionaries( hunspell.enabledDictionaries ),
+  maxInstances( hunspell.maxInstances )
 {
   changePath( hunspell.dictionariesPath );
 }
@@ -244,6 +244,12 @@ public:
     return enabledDictionaries;
   }
 
+  /// Returns the configured number of instances, which isn't edited here
+  unsigned getMaxInstances() const
+  {
+    return maxInstances;
+  }
+
   QModelIndex index( int row, int column, QModelIndex const & parent ) const;
   QModelIndex parent( QModelIndex const & parent ) const;
   Qt::ItemFlags flags( QModelIndex const & index ) const;
@@ -256,6 +262,7 @@ public:
 private:
 
   Config::Hunspell::Dictionaries enabledDictionaries;
+  unsigned maxInstances;
   std::vector< HunspellMorpho::DataFiles > dataFiles;
 };
 
@@ -128,7 +128,10 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.zipIndexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 class StardictDictionary: public BtreeIndexing::BtreeDictionary
@@ -139,7 +142,6 @@ class StardictDictionary: public BtreeIndexing::BtreeDictionary
   string bookName;
   string sameTypeSequence;
   ChunkedStorage::Reader chunks;
-  QMutex dzMutex;
   dictData * dz;
   QMutex resourceZipMutex;
   IndexedZip resourceZip;
@@ -251,6 +253,8 @@ StardictDictionary::StardictDictionary( string const & id,
   if ( !dz )
     throw exDictzipError( string( dz_error_str( error ) ) + "(" + dictionaryFiles[ 2 ] + ")" );
 
+  dict_data_set_cache_size( dz, Dictionary::dictzipCacheSize() );
+
   // Initialize the index
 
   openIndex( IndexInfo( idxHeader.indexBtreeMaxElements, idxHeader.indexRootOffset ), idx, idxMutex );
@@ -314,11 +318,9 @@ void StardictDictionary::getArticleProps( uint32_t articleAddress,
                                           uint32_t & offset,
                                           uint32_t & size )
 {
-  vector< char > chunk;
-
-  QMutexLocker _( &idxMutex );
+  ChunkedStorage::Chunk chunk;
 
-  char * articleData = chunks.getBlock( articleAddress, chunk );
+  char const * articleData = chunks.getBlock( articleAddress, chunk );
 
   memcpy( &offset, articleData, sizeof( uint32_t ) );
   articleData += sizeof( uint32_t );
@@ -878,12 +880,8 @@ void StardictDictionary::loadArticle( uint32_t address, string & headword, strin
 
   char * articleBody;
 
-  {
-    QMutexLocker _( &dzMutex );
-
-    // Note that the function always zero-pads the result.
-    articleBody = dict_data_read_( dz, offset, size, 0, 0 );
-  }
+  // Note that the function always zero-pads the result.
+  articleBody = dict_data_read_( dz, offset, size, 0, 0 );
 
   if ( !articleBody ) {
     //    throw exCantReadFile( getDictionaryFilenames()[ 2 ] );
@@ -1089,7 +1087,7 @@ QString StardictDictionary::getMainFilename()
 void StardictDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -1151,7 +1149,7 @@ class StardictHeadwordsRequest: public Dictionary::WordSearchRequest
   StardictDictionary & dict;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1159,7 +1157,7 @@ public:
     word( word_ ),
     dict( dict_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1169,6 +1167,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~StardictHeadwordsRequest()
@@ -1239,7 +1240,7 @@ class StardictArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 
 public:
@@ -1253,7 +1254,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1263,6 +1264,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~StardictArticleRequest()
@@ -1280,20 +1284,26 @@ void StardictArticleRequest::run()
   }
 
   try {
-    vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
+    vector< WordArticleLink > chain;
 
     //if alts has more than 100 , great probability that the dictionary is wrong produced or parsed.
     if ( alts.size() < 100 ) {
-      for ( const auto & alt : alts ) {
-        /// Make an additional query for each alt
+      vector< wstring > words( 1, word );
+      words.insert( words.end(), alts.begin(), alts.end() );
+
+      vector< vector< WordArticleLink > > chains = dict.findArticlesBatch( words, ignoreDiacritics );
+
+      chain = chains[ 0 ];
 
-        vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-        if ( altChain.size() > 100 ) {
+      for ( size_t x = 1; x < chains.size(); ++x ) {
+        if ( chains[ x ].size() > 100 ) {
           continue;
         }
-        chain.insert( chain.end(), altChain.begin(), altChain.end() );
+        chain.insert( chain.end(), chains[ x ].begin(), chains[ x ].end() );
       }
     }
+    else
+      chain = dict.findArticles( word, ignoreDiacritics );
 
     multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1479,7 +1489,7 @@ class StardictResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -1487,7 +1497,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -1497,6 +1507,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~StardictResourceRequest()
@@ -1900,7 +1913,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // That concludes it. Update the header.
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
         idxHeader.wordCount            = ifo.wordcount;
         idxHeader.synWordCount         = ifo.synwordcount;
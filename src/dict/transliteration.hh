@@ -41,6 +41,11 @@ public:
 
   virtual sptr< Dictionary::WordSearchRequest > prefixMatch( wstring const &, unsigned long );
 
+  virtual bool prefixMatchNarrowsDown()
+  {
+    return true;
+  }
+
   virtual sptr< Dictionary::DataRequest >
   getArticle( wstring const &, vector< wstring > const &, wstring const &, bool );
 };
@@ -63,6 +63,11 @@ public:
 
   sptr< WordSearchRequest > prefixMatch( wstring const & word, unsigned long maxResults ) override;
 
+  bool prefixMatchNarrowsDown() override
+  {
+    return true;
+  }
+
   sptr< DataRequest > getArticle( wstring const &, vector< wstring > const & alts, wstring const &, bool ) override;
 
 protected:
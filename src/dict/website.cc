@@ -74,6 +74,11 @@ public:
 
   sptr< WordSearchRequest > prefixMatch( wstring const & word, unsigned long ) override;
 
+  bool prefixMatchNarrowsDown() override
+  {
+    return true;
+  }
+
   sptr< DataRequest >
   getArticle( wstring const &, vector< wstring > const & alts, wstring const & context, bool ) override;
 
@@ -134,7 +134,10 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion || !header.articleFormat;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion ) || !header.articleFormat
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.zipIndexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 
@@ -144,7 +147,6 @@ class XdxfDictionary: public BtreeIndexing::BtreeDictionary
   File::Class idx;
   IdxHeader idxHeader;
   sptr< ChunkedStorage::Reader > chunks;
-  QMutex dzMutex;
   dictData * dz;
   QMutex resourceZipMutex;
   IndexedZip resourceZip;
@@ -235,7 +237,7 @@ XdxfDictionary::XdxfDictionary( string const & id, string const & indexFile, vec
   chunks = std::shared_ptr< ChunkedStorage::Reader >( new ChunkedStorage::Reader( idx, idxHeader.chunksOffset ) );
 
   if ( idxHeader.nameSize ) {
-    vector< char > chunk;
+    ChunkedStorage::Chunk chunk;
 
     dictionaryName = string( chunks->getBlock( idxHeader.nameAddress, chunk ), idxHeader.nameSize );
   }
@@ -248,12 +250,14 @@ XdxfDictionary::XdxfDictionary( string const & id, string const & indexFile, vec
   if ( !dz )
     throw exDictzipError( string( dz_error_str( error ) ) + "(" + dictionaryFiles[ 0 ] + ")" );
 
+  dict_data_set_cache_size( dz, Dictionary::dictzipCacheSize() );
+
   // Read the abrv, if any
 
   if ( idxHeader.hasAbrv ) {
-    vector< char > chunk;
+    ChunkedStorage::Chunk chunk;
 
-    char * abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
+    char const * abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
 
     uint32_t total;
     memcpy( &total, abrvBlock, sizeof( uint32_t ) );
@@ -264,7 +268,7 @@ XdxfDictionary::XdxfDictionary( string const & id, string const & indexFile, vec
       memcpy( &keySz, abrvBlock, sizeof( uint32_t ) );
       abrvBlock += sizeof( uint32_t );
 
-      char * key = abrvBlock;
+      char const * key = abrvBlock;
 
       abrvBlock += keySz;
 
@@ -344,12 +348,8 @@ QString const & XdxfDictionary::getDescription()
     dictionaryDescription = "NONE";
   else {
     try {
-      vector< char > chunk;
-      char * descr;
-      {
-        QMutexLocker _( &idxMutex );
-        descr = chunks->getBlock( idxHeader.descriptionAddress, chunk );
-      }
+      ChunkedStorage::Chunk chunk;
+      char const * descr = chunks->getBlock( idxHeader.descriptionAddress, chunk );
       dictionaryDescription = QString::fromUtf8( descr, idxHeader.descriptionSize );
     }
     catch ( ... ) {
@@ -366,7 +366,7 @@ QString XdxfDictionary::getMainFilename()
 void XdxfDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -425,7 +425,7 @@ class XdxfArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -438,7 +438,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -448,6 +448,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~XdxfArticleRequest()
@@ -465,15 +468,7 @@ void XdxfArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -572,17 +567,11 @@ void XdxfDictionary::loadArticle( uint32_t address, string & articleText, QStrin
 {
   // Read the properties
 
-  vector< char > chunk;
+  ChunkedStorage::Chunk chunk;
 
-  char * propertiesData;
+  char const * propertiesData = chunks->getBlock( address, chunk );
 
-  {
-    QMutexLocker _( &idxMutex );
-
-    propertiesData = chunks->getBlock( address, chunk );
-  }
-
-  if ( &chunk.front() + chunk.size() - propertiesData < 9 ) {
+  if ( chunk->data() + chunk->size() - propertiesData < 9 ) {
     articleText = string( "<div class=\"xdxf\">Index seems corrupted</div>" );
     return;
   }
@@ -598,12 +587,8 @@ void XdxfDictionary::loadArticle( uint32_t address, string & articleText, QStrin
 
   char * articleBody;
 
-  {
-    QMutexLocker _( &dzMutex );
-
-    // Note that the function always zero-pads the result.
-    articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
-  }
+  // Note that the function always zero-pads the result.
+  articleBody = dict_data_read_( dz, articleOffset, articleSize, 0, 0 );
 
   if ( !articleBody ) {
     //    throw exCantReadFile( getDictionaryFilenames()[ 0 ] );
@@ -896,7 +881,7 @@ class XdxfResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -904,7 +889,7 @@ public:
     dict( dict_ ),
     resourceName( resourceName_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -914,6 +899,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~XdxfResourceRequest()
@@ -1295,7 +1283,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
               // That concludes it. Update the header.
 
               idxHeader.signature     = Signature;
-              idxHeader.formatVersion = CurrentFormatVersion;
+              idxHeader.formatVersion =
+                BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
               idxHeader.articleCount = articleCount;
               idxHeader.wordCount    = wordCount;
@@ -16,6 +16,7 @@
   #include "tiff.hh"
   #include "ftshelpers.hh"
   #include "htmlescape.hh"
+  #include "wstring_qt.hh"
 
   #ifdef _MSC_VER
     #include <stub_msvc.h>
@@ -34,7 +35,6 @@
   #include <set>
   #include <map>
   #include <algorithm>
-  #include <QtConcurrent>
   #include <utility>
   #include "globalregex.hh"
   #include <zim/zim.h>
@@ -42,6 +42,8 @@
   #include <zim/entry.h>
   #include <zim/item.h>
   #include <zim/error.h>
+  #include <zim/search.h>
+  #include <zim/suggestion.h>
 
 namespace Zim {
 
@@ -62,6 +64,13 @@ using Dictionary::exCantReadFile;
 DEF_EX_STR( exInvalidZimHeader, "Invalid Zim header", Dictionary::Ex )
 DEF_EX( exUserAbort, "User abort", Dictionary::Ex )
 
+enum {
+  /// The number of titles looked at to find the ones equal to the word
+  MaxTitleCandidates = 20,
+  /// The number of full-text matches given, as many as FtsHelpers does
+  MaxFulltextMatches = 100
+};
+
 
 using ZimFile = zim::Archive;
 
@@ -70,7 +79,15 @@ using ZimFile = zim::Archive;
 
 enum {
   Signature            = 0x584D495A, // ZIMX on little-endian, XMIZ on big-endian
-  CurrentFormatVersion = 4 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 5 + BtreeIndexing::FormatVersion + Folding::Version
+};
+
+/// The indexes of the ZIM file used instead of our own ones
+enum EmbeddedIndexes {
+  /// Words are looked up in the title index, and no btree index is built
+  EmbeddedTitleIndex = 1,
+  /// The full-text search goes to the full-text index
+  EmbeddedFulltextIndex = 2
 };
 
 struct IdxHeader
@@ -85,8 +102,9 @@ struct IdxHeader
   quint32 articleCount;
   quint32 namePtr;
   quint32 descriptionPtr;
-  quint32 langFrom; // Source language
-  quint32 langTo;   // Target language
+  quint32 langFrom;        // Source language
+  quint32 langTo;          // Target language
+  quint32 embeddedIndexes; // EmbeddedIndexes flags
 }
   #ifndef _MSC_VER
 __attribute__( ( packed ) )
@@ -96,14 +114,27 @@ __attribute__( ( packed ) )
   #pragma pack( pop )
 
 // Some supporting functions
-bool indexIsOldOrBad( string const & indexFile )
+bool indexIsOldOrBad( string const & indexFile, quint32 embeddedIndexes )
 {
   File::Class idx( indexFile, "rb" );
 
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || header.embeddedIndexes != embeddedIndexes
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !BtreeIndexing::isCodecSupported( header.resourceIndexBtreeMaxElements );
+}
+
+/// Returns the embedded indexes of the file to be used, as EmbeddedIndexes flags
+quint32 usableEmbeddedIndexes( ZimFile const & file, bool embeddedIndexes )
+{
+  if ( !embeddedIndexes )
+    return 0;
+
+  return ( file.hasTitleIndex() ? EmbeddedTitleIndex : 0 )
+    | ( file.hasFulltextIndex() ? EmbeddedFulltextIndex : 0 );
 }
 
 quint32 getArticleCluster( ZimFile const & file, quint32 articleNumber )
@@ -167,6 +198,12 @@ class ZimDictionary: public BtreeIndexing::BtreeDictionary
   ZimFile df;
   set< quint32 > articlesIndexedForFTS;
 
+  /// Guards the searchers of the embedded indexes, which are created on
+  /// first use and aren't thread-safe
+  QMutex searchMutex;
+  sptr< zim::SuggestionSearcher > suggestionSearcher;
+  sptr< zim::Searcher > fulltextSearcher;
+
 public:
 
   ZimDictionary( string const & id, string const & indexFile, vector< string > const & dictionaryFiles );
@@ -203,6 +240,17 @@ public:
     return idxHeader.langTo;
   }
 
+  sptr< Dictionary::WordSearchRequest > prefixMatch( wstring const &, unsigned long maxResults ) override;
+
+  bool prefixMatchNarrowsDown() override
+  {
+    // The title index matches the words by its own rules
+    return !( idxHeader.embeddedIndexes & EmbeddedTitleIndex );
+  }
+
+  sptr< Dictionary::WordSearchRequest >
+  stemmedMatch( wstring const &, unsigned minLength, unsigned maxSuffixVariation, unsigned long maxResults ) override;
+
   sptr< Dictionary::DataRequest >
   getArticle( wstring const &, vector< wstring > const & alts, wstring const &, bool ignoreDiacritics ) override;
 
@@ -221,10 +269,34 @@ public:
 
   void setFTSParameters( Config::FullTextSearch const & fts ) override
   {
-    can_FTS = enable_FTS && fts.enabled && !fts.disabledTypes.contains( "ZIM", Qt::CaseInsensitive )
+    // Our own full-text index is built from the btree one, so there's none
+    // without the embedded full-text index if the title index is used
+    bool const canIndex = !( idxHeader.embeddedIndexes & EmbeddedTitleIndex )
       && ( fts.maxDictionarySize == 0 || getArticleCount() <= fts.maxDictionarySize );
+
+    can_FTS = enable_FTS && fts.enabled && !fts.disabledTypes.contains( "ZIM", Qt::CaseInsensitive )
+      && ( ftsIndexIsEmbedded() || canIndex );
   }
 
+  bool ftsIndexIsEmbedded() override
+  {
+    return idxHeader.embeddedIndexes & EmbeddedFulltextIndex;
+  }
+
+  /// Looks up the titles starting with the given string in the title index,
+  /// most relevant first. Gives the title and the index of the article for
+  /// each.
+  vector< WordArticleLink > suggestTitles( string const & str, unsigned long maxResults, bool resolveArticles );
+
+  /// Searches the embedded full-text index, returning the titles of the most
+  /// relevant articles found.
+  vector< string > searchFulltext( string const & query, unsigned maxResults, int & estimatedMatches );
+
+  /// Finds the articles for the word and its alternate writings, using either
+  /// the btree index or the title index.
+  vector< WordArticleLink >
+  findWordArticles( wstring const & word, vector< wstring > const & alts, bool ignoreDiacritics );
+
   void sortArticlesOffsetsForFTS( QVector< uint32_t > & offsets, QAtomicInt & isCancelled ) override;
 
 protected:
@@ -249,7 +321,8 @@ ZimDictionary::ZimDictionary( string const & id, string const & indexFile, vecto
 {
   // Initialize the indexes
 
-  openIndex( IndexInfo( idxHeader.indexBtreeMaxElements, idxHeader.indexRootOffset ), idx, idxMutex );
+  if ( !( idxHeader.embeddedIndexes & EmbeddedTitleIndex ) )
+    openIndex( IndexInfo( idxHeader.indexBtreeMaxElements, idxHeader.indexRootOffset ), idx, idxMutex );
 
   // Read dictionary name
 
@@ -480,8 +553,14 @@ QString const & ZimDictionary::getDescription()
 
 void ZimDictionary::makeFTSIndex( QAtomicInt & isCancelled, bool firstIteration )
 {
+  if ( ftsIndexIsEmbedded() ) {
+    // Nothing to build, the file has it all
+    FTS_index_completed.ref();
+    return;
+  }
+
   if ( !( Dictionary::needToRebuildIndex( getDictionaryFilenames(), ftsIdxName )
-          || FtsHelpers::ftsIndexIsOldOrBad( this ) ) )
+          || FtsHelpers::ftsIndexIsOldOrBad( this, isCancelled ) ) )
     FTS_index_completed.ref();
 
   if ( haveFTSIndex() )
@@ -537,9 +616,252 @@ void ZimDictionary::getArticleText( uint32_t articleAddress, QString & headword,
   }
 }
 
+vector< WordArticleLink >
+ZimDictionary::suggestTitles( string const & str, unsigned long maxResults, bool resolveArticles )
+{
+  vector< WordArticleLink > result;
+
+  QMutexLocker _( &searchMutex );
+
+  if ( !suggestionSearcher )
+    suggestionSearcher = std::make_shared< zim::SuggestionSearcher >( df );
+
+  auto search  = suggestionSearcher->suggest( str );
+  auto results = search.getResults( 0, maxResults );
+
+  for ( auto it = results.begin(); it != results.end(); ++it ) {
+    quint32 articleNumber = 0xFFFFFFFF;
+
+    if ( resolveArticles ) {
+      QMutexLocker _( &zimMutex );
+      articleNumber = it.getEntry().getItem( true ).getIndex();
+    }
+
+    result.emplace_back( it->getTitle(), articleNumber );
+  }
+
+  return result;
+}
+
+vector< string > ZimDictionary::searchFulltext( string const & query, unsigned maxResults, int & estimatedMatches )
+{
+  vector< string > result;
+
+  QMutexLocker _( &searchMutex );
+
+  if ( !fulltextSearcher )
+    fulltextSearcher = std::make_shared< zim::Searcher >( df );
+
+  auto search      = fulltextSearcher->search( zim::Query( query ) );
+  auto results     = search.getResults( 0, maxResults );
+  estimatedMatches = search.getEstimatedMatches();
+
+  for ( auto it = results.begin(); it != results.end(); ++it )
+    result.push_back( it.getTitle() );
+
+  return result;
+}
+
+vector< WordArticleLink >
+ZimDictionary::findWordArticles( wstring const & word, vector< wstring > const & alts, bool ignoreDiacritics )
+{
+  if ( !( idxHeader.embeddedIndexes & EmbeddedTitleIndex ) )
+    return findArticlesWithAlts( word, alts, ignoreDiacritics );
+
+  // The title index matches the words loosely, so only the titles equal to
+  // the word once case-folded are kept, just like the btree index does
+  vector< WordArticleLink > result;
+
+  vector< wstring > words( 1, word );
+  words.insert( words.end(), alts.begin(), alts.end() );
+
+  for ( auto const & w : words ) {
+    wstring folded = Folding::applySimpleCaseOnly( gd::normalize( gd::removeTrailingZero( w ) ) );
+    if ( ignoreDiacritics )
+      folded = Folding::applyDiacriticsOnly( folded );
+
+    if ( folded.empty() )
+      continue;
+
+    for ( auto & link : suggestTitles( Utf8::encode( folded ), MaxTitleCandidates, true ) ) {
+      wstring title = Folding::applySimpleCaseOnly( gd::normalize( Utf8::decode( link.word ) ) );
+      if ( ignoreDiacritics )
+        title = Folding::applyDiacriticsOnly( title );
+
+      if ( title == folded && link.articleOffset != 0xFFFFFFFF )
+        result.push_back( std::move( link ) );
+    }
+  }
+
+  return result;
+}
+
+/// ZimDictionary::prefixMatch()
+
+class ZimPrefixMatchRequest: public Dictionary::WordSearchRequest
+{
+  wstring word;
+  unsigned long maxResults;
+  ZimDictionary & dict;
+
+  QAtomicInt isCancelled;
+  Scheduler::Future f;
+
+public:
+
+  ZimPrefixMatchRequest( wstring word_, unsigned long maxResults_, ZimDictionary & dict_ ):
+    word( std::move( word_ ) ),
+    maxResults( maxResults_ ),
+    dict( dict_ )
+  {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
+      this->run();
+    } );
+  }
+
+  void run();
+
+  void cancel() override
+  {
+    isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
+  }
+
+  ~ZimPrefixMatchRequest()
+  {
+    isCancelled.ref();
+    f.waitForFinished();
+  }
+};
+
+void ZimPrefixMatchRequest::run()
+{
+  if ( Utils::AtomicInt::loadAcquire( isCancelled ) ) {
+    finish();
+    return;
+  }
+
+  try {
+    vector< WordArticleLink > titles = dict.suggestTitles( Utf8::encode( word ), maxResults, false );
+
+    QMutexLocker _( &dataMutex );
+
+    for ( auto const & title : titles )
+      addMatch( Utf8::decode( title.word ) );
+  }
+  catch ( std::exception & e ) {
+    setErrorString( QString::fromUtf8( e.what() ) );
+  }
+
+  finish();
+}
+
+sptr< Dictionary::WordSearchRequest > ZimDictionary::prefixMatch( wstring const & word, unsigned long maxResults )
+{
+  if ( !( idxHeader.embeddedIndexes & EmbeddedTitleIndex ) )
+    return BtreeDictionary::prefixMatch( word, maxResults );
+
+  if ( Folding::applyWhitespaceOnly( word ).empty() )
+    return std::make_shared< Dictionary::WordSearchRequestInstant >();
+
+  return std::make_shared< ZimPrefixMatchRequest >( word, maxResults, *this );
+}
+
+sptr< Dictionary::WordSearchRequest > ZimDictionary::stemmedMatch( wstring const & word,
+                                                                  unsigned minLength,
+                                                                  unsigned maxSuffixVariation,
+                                                                  unsigned long maxResults )
+{
+  // The title index can't do that
+  if ( idxHeader.embeddedIndexes & EmbeddedTitleIndex )
+    return std::make_shared< Dictionary::WordSearchRequestInstant >();
+
+  return BtreeDictionary::stemmedMatch( word, minLength, maxSuffixVariation, maxResults );
+}
+
+/// ZimDictionary::getSearchResults()
+
+class ZimFulltextRequest: public Dictionary::DataRequest
+{
+  ZimDictionary & dict;
+  QString searchString;
+  bool matchCase;
+
+  QAtomicInt isCancelled;
+  Scheduler::Future f;
+
+public:
+
+  ZimFulltextRequest( ZimDictionary & dict_, QString const & searchString_, bool matchCase_ ):
+    dict( dict_ ),
+    searchString( searchString_ ),
+    matchCase( matchCase_ )
+  {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
+      this->run();
+    } );
+  }
+
+  void run();
+
+  void cancel() override
+  {
+    isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
+  }
+
+  ~ZimFulltextRequest()
+  {
+    isCancelled.ref();
+    f.waitForFinished();
+  }
+};
+
+void ZimFulltextRequest::run()
+{
+  if ( Utils::AtomicInt::loadAcquire( isCancelled ) ) {
+    finish();
+    return;
+  }
+
+  try {
+    int estimatedMatches = 0;
+    vector< string > titles =
+      dict.searchFulltext( searchString.toStdString(), MaxFulltextMatches, estimatedMatches );
+
+    emit matchCount( estimatedMatches );
+
+    if ( !titles.empty() && !Utils::AtomicInt::loadAcquire( isCancelled ) ) {
+      // Passed the same way FtsHelpers::FTSResultsRequest does
+      auto * foundHeadwords = new QList< FTS::FtsHeadword >;
+      QString id            = QString::fromUtf8( dict.getId().c_str() );
+
+      for ( auto const & title : titles )
+        foundHeadwords->append( FTS::FtsHeadword( QString::fromStdString( title ), id, QStringList(), matchCase ) );
+
+      QMutexLocker _( &dataMutex );
+      data.resize( sizeof( foundHeadwords ) );
+      memcpy( &data.front(), &foundHeadwords, sizeof( foundHeadwords ) );
+      hasAnyData = true;
+    }
+  }
+  catch ( std::exception & e ) {
+    gdWarning( "Zim: Failed full-text search for \"%s\", reason: %s\n", dict.getName().c_str(), e.what() );
+  }
+
+  finish();
+}
+
 sptr< Dictionary::DataRequest >
 ZimDictionary::getSearchResults( QString const & searchString, int searchMode, bool matchCase, bool ignoreDiacritics )
 {
+  if ( ftsIndexIsEmbedded() )
+    return std::make_shared< ZimFulltextRequest >( *this, searchString, matchCase );
+
   return std::make_shared< FtsHelpers::FTSResultsRequest >( *this,
                                                             searchString,
                                                             searchMode,
@@ -557,7 +879,7 @@ class ZimArticleRequest: public Dictionary::DataRequest
   bool ignoreDiacritics;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
 
@@ -567,7 +889,7 @@ public:
     dict( dict_ ),
     ignoreDiacritics( ignoreDiacritics_ )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -577,6 +899,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~ZimArticleRequest()
@@ -593,14 +918,15 @@ void ZimArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alt, ignoreDiacritics );
+  vector< WordArticleLink > chain;
 
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
+  try {
+    chain = dict.findWordArticles( word, alts, ignoreDiacritics );
+  }
+  catch ( std::exception & e ) {
+    setErrorString( QString::fromUtf8( e.what() ) );
+    finish();
+    return;
   }
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
@@ -713,14 +1039,14 @@ class ZimResourceRequest: public Dictionary::DataRequest
   string resourceName;
 
   QAtomicInt isCancelled;
-  QFuture< void > f;
+  Scheduler::Future f;
 
 public:
   ZimResourceRequest( ZimDictionary & dict_, string resourceName_ ):
     dict( dict_ ),
     resourceName( std::move( resourceName_ ) )
   {
-    f = QtConcurrent::run( [ this ]() {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -730,6 +1056,9 @@ public:
   void cancel() override
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~ZimResourceRequest()
@@ -797,7 +1126,8 @@ wstring normalizeWord( const std::string & url );
 vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & fileNames,
                                                       string const & indicesDir,
                                                       Dictionary::Initializing & initializing,
-                                                      unsigned maxHeadwordsToExpand )
+                                                      unsigned maxHeadwordsToExpand,
+                                                      bool embeddedIndexes )
 
 {
   vector< sptr< Dictionary::Class > > dictionaries;
@@ -830,8 +1160,10 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
     initializing.indexingDictionary( df.getFilename() );
 
     try {
+      quint32 const usedIndexes = usableEmbeddedIndexes( df, embeddedIndexes );
+
       //only check zim file.
-      if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) ) {
+      if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile, usedIndexes ) ) {
         gdDebug( "Zim: Building the index for dictionary: %s\n", fileName.c_str() );
 
         unsigned articleCount = df.getArticleCount();
@@ -858,57 +1190,66 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         // will be rewritten with the right values.
         idx.write( idxHeader );
 
-        IndexedWords indexedWords;
-
-        //only iterate the article
-        for ( const auto & entry : df.iterByTitle() ) {
-          auto item     = entry.getItem( true );
-          auto mimeType = item.getMimetype();
-          auto url      = item.getPath();
-          auto title    = item.getTitle();
-          auto index    = item.getIndex();
-          // Read article url and title
-          if ( !isArticleMime( mimeType ) ) {
-            continue;
-          }
-
-          if ( maxHeadwordsToExpand > 0 && ( articleCount >= maxHeadwordsToExpand ) ) {
-            if ( !title.empty() ) {
-              wstring word = Utf8::decode( title );
-              indexedWords.addSingleWord( word, index );
-            }
-            else if ( !url.empty() ) {
-              indexedWords.addSingleWord( normalizeWord( url ), index );
+        if ( usedIndexes & EmbeddedTitleIndex ) {
+          // The words are looked up in the title index of the file, so there's
+          // nothing to build. The headwords can't be listed then.
+          gdDebug( "Zim: Using the title index of dictionary: %s\n", fileName.c_str() );
+        }
+        else {
+          IndexedWords indexedWords;
+
+          //only iterate the article
+          for ( const auto & entry : df.iterByTitle() ) {
+            auto item     = entry.getItem( true );
+            auto mimeType = item.getMimetype();
+            auto url      = item.getPath();
+            auto title    = item.getTitle();
+            auto index    = item.getIndex();
+            // Read article url and title
+            if ( !isArticleMime( mimeType ) ) {
+              continue;
             }
-          }
-          else {
-            if ( !title.empty() ) {
-              auto word = Utf8::decode( title );
-              indexedWords.addWord( word, index );
-              wordCount++;
+
+            if ( maxHeadwordsToExpand > 0 && ( articleCount >= maxHeadwordsToExpand ) ) {
+              if ( !title.empty() ) {
+                wstring word = Utf8::decode( title );
+                indexedWords.addSingleWord( word, index );
+              }
+              else if ( !url.empty() ) {
+                indexedWords.addSingleWord( normalizeWord( url ), index );
+              }
             }
-            else if ( !url.empty() ) {
-              indexedWords.addWord( normalizeWord( url ), index );
-              wordCount++;
+            else {
+              if ( !title.empty() ) {
+                auto word = Utf8::decode( title );
+                indexedWords.addWord( word, index );
+                wordCount++;
+              }
+              else if ( !url.empty() ) {
+                indexedWords.addWord( normalizeWord( url ), index );
+                wordCount++;
+              }
             }
           }
-        }
 
-        // Build index
-        {
-          IndexInfo idxInfo = BtreeIndexing::buildIndex( indexedWords, idx );
+          // Build index
+          {
+            IndexInfo idxInfo = BtreeIndexing::buildIndex( indexedWords, idx );
 
-          idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
-          idxHeader.indexRootOffset       = idxInfo.rootOffset;
+            idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
+            idxHeader.indexRootOffset       = idxInfo.rootOffset;
 
-          indexedWords.clear(); // Release memory -- no need for this data
+            indexedWords.clear(); // Release memory -- no need for this data
+          }
         }
 
         idxHeader.signature     = Signature;
-        idxHeader.formatVersion = CurrentFormatVersion;
+        idxHeader.formatVersion =
+          BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
-        idxHeader.articleCount = articleCount;
-        idxHeader.wordCount    = wordCount;
+        idxHeader.articleCount    = articleCount;
+        idxHeader.wordCount       = wordCount;
+        idxHeader.embeddedIndexes = usedIndexes;
 
         idx.rewind();
 
@@ -14,7 +14,8 @@ using std::string;
 vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & fileNames,
                                                       string const & indicesDir,
                                                       Dictionary::Initializing &,
-                                                      unsigned maxHeadwordsToExpand );
+                                                      unsigned maxHeadwordsToExpand,
+                                                      bool embeddedIndexes );
 
 } // namespace Zim
 
@@ -66,7 +66,9 @@ bool indexIsOldOrBad( string const & indexFile )
   IdxHeader header;
 
   return idx.readRecords( &header, sizeof( header ), 1 ) != 1 || header.signature != Signature
-    || header.formatVersion != CurrentFormatVersion;
+    || !BtreeIndexing::isCurrentFormatVersion( header.formatVersion, CurrentFormatVersion )
+    || !BtreeIndexing::isCodecSupported( header.indexBtreeMaxElements )
+    || !ChunkedStorage::isCodecSupported( idx, header.chunksOffset );
 }
 
 wstring stripExtension( string const & str )
@@ -169,15 +171,7 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getArticle( wstring const &
                                                                  bool ignoreDiacritics )
 
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for ( const auto & alt : alts ) {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alt, ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticlesWithAlts( word, alts, ignoreDiacritics );
 
   multimap< wstring, uint32_t > mainArticles, alternateArticles;
 
@@ -219,15 +213,14 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getArticle( wstring const &
 
   result += "<table class=\"lsa_play\">";
 
-  vector< char > chunk;
-  char * nameBlock;
+  ChunkedStorage::Chunk chunk;
+  char const * nameBlock;
 
   for ( i = mainArticles.begin(); i != mainArticles.end(); ++i ) {
     try {
-      QMutexLocker _( &idxMutex );
       nameBlock = chunks->getBlock( i->second, chunk );
 
-      if ( nameBlock >= &chunk.front() + chunk.size() ) {
+      if ( nameBlock >= chunk->data() + chunk->size() ) {
         // chunks reader thinks it's okay since zero-sized records can exist,
         // but we don't allow that.
         throw ChunkedStorage::exAddressOutOfRange();
@@ -266,10 +259,9 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getArticle( wstring const &
 
   for ( i = alternateArticles.begin(); i != alternateArticles.end(); ++i ) {
     try {
-      QMutexLocker _( &idxMutex );
       nameBlock = chunks->getBlock( i->second, chunk );
 
-      if ( nameBlock >= &chunk.front() + chunk.size() ) {
+      if ( nameBlock >= chunk->data() + chunk->size() ) {
         // chunks reader thinks it's okay since zero-sized records can exist,
         // but we don't allow that.
         throw ChunkedStorage::exAddressOutOfRange();
@@ -329,8 +321,8 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getResource( string const &
 
   uint32_t dataOffset = 0;
   for ( int x = chain.size() - 1; x >= 0; x-- ) {
-    vector< char > chunk;
-    char * nameBlock = chunks->getBlock( chain[ x ].articleOffset, chunk );
+    ChunkedStorage::Chunk chunk;
+    char const * nameBlock = chunks->getBlock( chain[ x ].articleOffset, chunk );
 
     uint16_t sz;
     memcpy( &sz, nameBlock, sizeof( uint16_t ) );
@@ -446,7 +438,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
           idxHeader.indexRootOffset       = idxInfo.rootOffset;
 
           idxHeader.signature     = Signature;
-          idxHeader.formatVersion = CurrentFormatVersion;
+          idxHeader.formatVersion =
+            BtreeIndexing::formatVersionToWrite( CurrentFormatVersion, idxHeader.indexBtreeMaxElements );
 
           idxHeader.soundsCount = namesCount;
 
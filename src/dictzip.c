@@ -139,6 +139,20 @@
 
 #include <sys/stat.h>
 
+#ifdef _WIN32
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+  #define DICT_THREAD_LOCAL __declspec( thread )
+#else
+  #define DICT_THREAD_LOCAL __thread
+#endif
+
 #define USE_CACHE 1
 
 #define dict_data_filter( ... )
@@ -449,11 +463,191 @@ static enum DZ_ERRORS dict_read_header( const char * filename, dictData * header
   return DZ_NOERROR;
 }
 
+/* Errors are reported per thread, since the readers run concurrently */
+static DICT_THREAD_LOCAL char errorString[ 512 ];
+
+/* The lock guarding the shared state of dictData */
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION dict_lock_t;
+#else
+typedef pthread_mutex_t dict_lock_t;
+#endif
+
+static void * dict_lock_create( void )
+{
+  dict_lock_t * lock = xmalloc( sizeof( dict_lock_t ) );
+  if ( !lock )
+    return NULL;
+#ifdef _WIN32
+  InitializeCriticalSection( lock );
+#else
+  pthread_mutex_init( lock, NULL );
+#endif
+  return lock;
+}
+
+static void dict_lock_destroy( void * lock )
+{
+  if ( !lock )
+    return;
+#ifdef _WIN32
+  DeleteCriticalSection( (dict_lock_t *)lock );
+#else
+  pthread_mutex_destroy( (dict_lock_t *)lock );
+#endif
+  xfree( lock );
+}
+
+static void dict_lock( dictData * h )
+{
+#ifdef _WIN32
+  EnterCriticalSection( (dict_lock_t *)h->lock );
+#else
+  pthread_mutex_lock( (dict_lock_t *)h->lock );
+#endif
+}
+
+static void dict_unlock( dictData * h )
+{
+#ifdef _WIN32
+  LeaveCriticalSection( (dict_lock_t *)h->lock );
+#else
+  pthread_mutex_unlock( (dict_lock_t *)h->lock );
+#endif
+}
+
+/* Reads exactly size bytes at the given offset without moving the file
+   pointer, so it can be done from several threads at once. Returns 0 on
+   failure. */
+static int dict_read_at( dictData * h, void * buffer, unsigned long size, unsigned long offset )
+{
+#ifdef _WIN32
+  OVERLAPPED overlapped;
+  DWORD readed = 0;
+  #ifdef __WIN32
+  HANDLE handle = h->fd;
+  #else
+  HANDLE handle = (HANDLE)_get_osfhandle( _fileno( h->fd ) );
+  #endif
+
+  memset( &overlapped, 0, sizeof( overlapped ) );
+  overlapped.Offset = offset;
+
+  return ReadFile( handle, buffer, size, &readed, &overlapped ) && readed == size;
+#else
+  char * pt = buffer;
+  int fd    = fileno( h->fd );
+
+  while ( size ) {
+    ssize_t result = pread( fd, pt, size, offset );
+    if ( result < 0 && errno == EINTR )
+      continue;
+    if ( result <= 0 )
+      return 0;
+    pt += result;
+    offset += result;
+    size -= result;
+  }
+  return 1;
+#endif
+}
+
+/* Takes an idle inflate stream from the pool, or makes a new one */
+static z_stream * dict_take_inflater( dictData * h )
+{
+  z_stream * zStream = NULL;
+
+  dict_lock( h );
+  if ( h->inflaterCount )
+    zStream = h->inflaters[ --h->inflaterCount ];
+  dict_unlock( h );
+
+  if ( zStream ) {
+    inflateReset( zStream );
+    return zStream;
+  }
+
+  zStream = xmalloc( sizeof( z_stream ) );
+  if ( !zStream ) {
+    strcpy( errorString, dz_error_str( DZ_ERR_NOMEMORY ) );
+    return NULL;
+  }
+
+  memset( zStream, 0, sizeof( z_stream ) );
+  if ( inflateInit2( zStream, -15 ) != Z_OK ) {
+    sprintf( errorString, "Cannot initialize inflation engine: %s", zStream->msg );
+    xfree( zStream );
+    return NULL;
+  }
+
+  return zStream;
+}
+
+static void dict_free_inflater( z_stream * zStream )
+{
+  if ( inflateEnd( zStream ) )
+    err_internal( __func__, "Cannot shut down inflation engine: %s\n", zStream->msg );
+  xfree( zStream );
+}
+
+static void dict_return_inflater( dictData * h, z_stream * zStream )
+{
+  dict_lock( h );
+  if ( h->inflaterCount < DICT_INFLATER_POOL_SIZE ) {
+    h->inflaters[ h->inflaterCount++ ] = zStream;
+    zStream                           = NULL;
+  }
+  dict_unlock( h );
+
+  if ( zStream )
+    dict_free_inflater( zStream );
+}
+
+/* Drops the cached chunks and resizes the cache. Must be called with the
+   lock held, or before the data is shared. */
+static int dict_resize_cache( dictData * h, int chunks )
+{
+  int j;
+
+  for ( j = 0; j < h->cacheSize; ++j ) {
+    if ( h->cache[ j ].inBuffer )
+      xfree( h->cache[ j ].inBuffer );
+  }
+  if ( h->cache )
+    xfree( h->cache );
+
+  h->cache     = NULL;
+  h->cacheSize = 0;
+
+  if ( chunks <= 0 )
+    return 1;
+
+  h->cache = xmalloc( chunks * sizeof( dictCache ) );
+  if ( !h->cache )
+    return 0;
+
+  h->cacheSize = chunks;
+  for ( j = 0; j < chunks; j++ ) {
+    h->cache[ j ].chunk    = -1;
+    h->cache[ j ].stamp    = -1;
+    h->cache[ j ].inBuffer = NULL;
+    h->cache[ j ].count    = 0;
+  }
+  return 1;
+}
+
+void dict_data_set_cache_size( dictData * h, int chunks )
+{
+  dict_lock( h );
+  dict_resize_cache( h, chunks );
+  dict_unlock( h );
+}
+
 dictData * dict_data_open( const char * filename, enum DZ_ERRORS * error, int computeCRC )
 {
   dictData * h = NULL;
   //   struct stat sb;
-  int j;
 
   if ( !filename ) {
     *error = DZ_ERR_OPENFILE;
@@ -470,7 +664,6 @@ dictData * dict_data_open( const char * filename, enum DZ_ERRORS * error, int co
 #ifdef __WIN32
   h->fd = INVALID_HANDLE_VALUE;
 #endif
-  h->initialized = 0;
 
   for ( ;; ) {
 #ifdef __WIN32
@@ -517,11 +710,10 @@ dictData * dict_data_open( const char * filename, enum DZ_ERRORS * error, int co
     h->size = ftell( h->fd );
 #endif
 
-    for ( j = 0; j < DICT_CACHE_SIZE; j++ ) {
-      h->cache[ j ].chunk    = -1;
-      h->cache[ j ].stamp    = -1;
-      h->cache[ j ].inBuffer = NULL;
-      h->cache[ j ].count    = 0;
+    h->lock = dict_lock_create();
+    if ( !h->lock || !dict_resize_cache( h, DICT_CACHE_SIZE ) ) {
+      *error = DZ_ERR_NOMEMORY;
+      break;
     }
 
     *error = DZ_NOERROR;
@@ -551,17 +743,131 @@ void dict_data_close( dictData * header )
   if ( header->offsets )
     xfree( header->offsets );
 
-  if ( header->initialized ) {
-    if ( inflateEnd( &header->zStream ) )
-      err_internal( __func__, "Cannot shut down inflation engine: %s\n", header->zStream.msg );
+  for ( i = 0; i < header->inflaterCount; ++i )
+    dict_free_inflater( header->inflaters[ i ] );
+
+  dict_resize_cache( header, 0 );
+  dict_lock_destroy( header->lock );
+
+  xfree( header );
+}
+
+/* Inflates the given chunk into inBuffer, which must be chunkLength bytes
+   long. Returns the number of bytes inflated, or -1 on error. Doesn't touch
+   any shared state but the inflater pool. */
+static int dict_inflate_chunk( dictData * h, int i, char * inBuffer, const char * preFilter, const char * postFilter )
+{
+  char outBuffer[ OUT_BUFFER_SIZE ];
+  z_stream * zStream;
+  int count;
+  (void)preFilter;
+  (void)postFilter;
+
+  if ( h->chunks[ i ] >= OUT_BUFFER_SIZE ) {
+    /*
+       err_internal( __func__,
+             "h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)\n",
+             i, h->chunks[i], OUT_BUFFER_SIZE );
+*/
+    sprintf( errorString, "h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)\n", i, h->chunks[ i ], OUT_BUFFER_SIZE );
+    return -1;
   }
 
-  for ( i = 0; i < DICT_CACHE_SIZE; ++i ) {
-    if ( header->cache[ i ].inBuffer )
-      xfree( header->cache[ i ].inBuffer );
+  if ( !dict_read_at( h, outBuffer, h->chunks[ i ], h->offsets[ i ] ) ) {
+    strcpy( errorString, dz_error_str( DZ_ERR_READFILE ) );
+    return -1;
   }
 
-  xfree( header );
+  dict_data_filter( outBuffer, &count, OUT_BUFFER_SIZE, preFilter );
+
+  zStream = dict_take_inflater( h );
+  if ( !zStream )
+    return -1;
+
+  zStream->next_in   = (Bytef *)outBuffer;
+  zStream->avail_in  = h->chunks[ i ];
+  zStream->next_out  = (Bytef *)inBuffer;
+  zStream->avail_out = h->chunkLength;
+  if ( inflate( zStream, Z_PARTIAL_FLUSH ) != Z_OK ) {
+    //	       err_fatal( __func__, "inflate: %s\n", zStream->msg );
+    sprintf( errorString, "inflate: %s\n", zStream->msg );
+    dict_return_inflater( h, zStream );
+    return -1;
+  }
+  if ( zStream->avail_in )
+  /*
+       err_internal( __func__,
+             "inflate did not flush (%d pending, %d avail)\n",
+             zStream->avail_in, zStream->avail_out );
+*/
+  {
+    sprintf( errorString,
+             "inflate did not flush (%d pending, %d avail)\n",
+             zStream->avail_in,
+             zStream->avail_out );
+    dict_return_inflater( h, zStream );
+    return -1;
+  }
+
+  count = h->chunkLength - zStream->avail_out;
+  dict_return_inflater( h, zStream );
+
+  dict_data_filter( inBuffer, &count, h->chunkLength, postFilter );
+
+  return count;
+}
+
+/* Marks the cached chunk as the most recently used one. Must be called with
+   the lock held. */
+static void dict_touch_cached( dictData * h, int target )
+{
+  int j;
+
+  h->cache[ target ].stamp = ++h->stamp;
+  if ( h->stamp < 0 ) {
+    h->stamp = 0;
+    for ( j = 0; j < h->cacheSize; j++ )
+      h->cache[ j ].stamp = -1;
+  }
+}
+
+/* Copies the part of chunk i which falls into the requested range to pt.
+   Returns the number of bytes copied, or -1 if the chunk is too short. */
+static int dict_copy_chunk( dictData * h,
+                            char * pt,
+                            const char * inBuffer,
+                            int count,
+                            int i,
+                            int firstChunk,
+                            int firstOffset,
+                            int lastChunk,
+                            int lastOffset )
+{
+  if ( i == firstChunk ) {
+    if ( i == lastChunk ) {
+      memcpy( pt, inBuffer + firstOffset, lastOffset - firstOffset );
+      return lastOffset - firstOffset;
+    }
+    if ( count != h->chunkLength )
+    /*
+      err_internal( __func__,
+            "Length = %d instead of %d\n",
+            count, h->chunkLength );
+*/
+    {
+      sprintf( errorString, "Length = %d instead of %d\n", count, h->chunkLength );
+      return -1;
+    }
+    memcpy( pt, inBuffer + firstOffset, h->chunkLength - firstOffset );
+    return h->chunkLength - firstOffset;
+  }
+  if ( i == lastChunk ) {
+    memcpy( pt, inBuffer, lastOffset );
+    return lastOffset;
+  }
+  assert( count == h->chunkLength );
+  memcpy( pt, inBuffer, h->chunkLength );
+  return h->chunkLength;
 }
 
 char * dict_data_read_(
@@ -570,21 +876,18 @@ char * dict_data_read_(
   char * buffer;
   char * pt;
   unsigned long end;
-  int count;
+  int count, copied;
   char * inBuffer;
-  char outBuffer[ OUT_BUFFER_SIZE ];
   int firstChunk, lastChunk;
   int firstOffset, lastOffset;
   int i, j;
   int found, target, lastStamp;
-  (void)preFilter;
-  (void)postFilter;
 
   end = start + size;
 
   buffer = xmalloc( size + 1 );
   if ( !buffer ) {
-    strcpy( h->errorString, dz_error_str( DZ_ERR_NOMEMORY ) );
+    strcpy( errorString, dz_error_str( DZ_ERR_NOMEMORY ) );
     return 0;
   }
 
@@ -605,50 +908,19 @@ char * dict_data_read_(
 		 " or dzip format (for space savings).\n" );
       break;
 */
-      strcpy( h->errorString, "Cannot seek on pure gzip format files" );
+      strcpy( errorString, "Cannot seek on pure gzip format files" );
       xfree( buffer );
       return 0;
-    case DICT_TEXT: {
-#ifdef __WIN32
-      long hiPtr   = 0;
-      DWORD pos    = SetFilePointer( h->fd, start, &hiPtr, FILE_BEGIN );
-      DWORD readed = 0;
-      if ( pos != INVALID_SET_FILE_POINTER || GetLastError() != NO_ERROR )
-        ReadFile( h->fd, buffer, size, &readed, 0 );
-      if ( size != readed )
-#else
-      if ( fseek( h->fd, start, SEEK_SET ) != 0 || fread( buffer, size, 1, h->fd ) != 1 )
-#endif
-      {
-        strcpy( h->errorString, dz_error_str( DZ_ERR_READFILE ) );
+    case DICT_TEXT:
+      if ( !dict_read_at( h, buffer, size, start ) ) {
+        strcpy( errorString, dz_error_str( DZ_ERR_READFILE ) );
         xfree( buffer );
         return 0;
       }
 
       buffer[ size ] = '\0';
-    } break;
+      break;
     case DICT_DZIP:
-      if ( !h->initialized ) {
-        h->zStream.zalloc    = NULL;
-        h->zStream.zfree     = NULL;
-        h->zStream.opaque    = NULL;
-        h->zStream.next_in   = 0;
-        h->zStream.avail_in  = 0;
-        h->zStream.next_out  = NULL;
-        h->zStream.avail_out = 0;
-        if ( inflateInit2( &h->zStream, -15 ) != Z_OK )
-        /*
-	    err_internal( __func__,
-			  "Cannot initialize inflation engine: %s\n",
-			  h->zStream.msg );
-*/
-        {
-          sprintf( h->errorString, "Cannot initialize inflation engine: %s", h->zStream.msg );
-          xfree( buffer );
-          return 0;
-        }
-        ++h->initialized;
-      }
       firstChunk  = start / h->chunkLength;
       firstOffset = start - firstChunk * h->chunkLength;
       lastChunk   = end / h->chunkLength;
@@ -665,159 +937,101 @@ char * dict_data_read_(
                 lastOffset ) );
       for ( pt = buffer, i = firstChunk; i <= lastChunk; i++ ) {
 
-        /* Access cache */
-        found     = 0;
-        target    = 0;
-        lastStamp = INT_MAX;
-        for ( j = 0; j < DICT_CACHE_SIZE; j++ ) {
+        /* Access cache. Cached chunks are copied out with the lock held,
+           since they may get evicted as soon as it's released. */
+        found = 0;
 #if USE_CACHE
+        dict_lock( h );
+        for ( j = 0; j < h->cacheSize; j++ ) {
           if ( h->cache[ j ].chunk == i ) {
+            dict_touch_cached( h, j );
+            copied = dict_copy_chunk( h,
+                                      pt,
+                                      h->cache[ j ].inBuffer,
+                                      h->cache[ j ].count,
+                                      i,
+                                      firstChunk,
+                                      firstOffset,
+                                      lastChunk,
+                                      lastOffset );
             found  = 1;
-            target = j;
             break;
           }
-#endif
-          if ( h->cache[ j ].stamp < lastStamp ) {
-            lastStamp = h->cache[ j ].stamp;
-            target    = j;
-          }
         }
-
-        h->cache[ target ].stamp = ++h->stamp;
-        if ( h->stamp < 0 ) {
-          h->stamp = 0;
-          for ( j = 0; j < DICT_CACHE_SIZE; j++ )
-            h->cache[ j ].stamp = -1;
-        }
-        if ( found ) {
-          count    = h->cache[ target ].count;
-          inBuffer = h->cache[ target ].inBuffer;
-        }
-        else {
-#ifdef __WIN32
-          DWORD pos;
-          DWORD readed;
+        dict_unlock( h );
 #endif
-          h->cache[ target ].chunk = -1;
-          if ( !h->cache[ target ].inBuffer )
-            h->cache[ target ].inBuffer = xmalloc( h->chunkLength );
-          inBuffer = h->cache[ target ].inBuffer;
-          if ( !inBuffer ) {
-            strcpy( h->errorString, dz_error_str( DZ_ERR_NOMEMORY ) );
-            xfree( buffer );
-            return 0;
-          }
 
-          if ( h->chunks[ i ] >= OUT_BUFFER_SIZE ) {
-            /*
-	       err_internal( __func__,
-			     "h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)\n",
-			     i, h->chunks[i], OUT_BUFFER_SIZE );
-*/
-            sprintf( h->errorString,
-                     "h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)\n",
-                     i,
-                     h->chunks[ i ],
-                     OUT_BUFFER_SIZE );
+        if ( !found ) {
+          /* Inflate without holding the lock, into a buffer of our own */
+          inBuffer = xmalloc( h->chunkLength );
+          if ( !inBuffer ) {
+            strcpy( errorString, dz_error_str( DZ_ERR_NOMEMORY ) );
             xfree( buffer );
             return 0;
           }
 
-#ifdef __WIN32
-          pos    = SetFilePointer( h->fd, h->offsets[ i ], 0, FILE_BEGIN );
-          readed = 0;
-          if ( pos != INVALID_SET_FILE_POINTER || GetLastError() != NO_ERROR )
-            ReadFile( h->fd, outBuffer, h->chunks[ i ], &readed, 0 );
-          if ( h->chunks[ i ] != (int)readed )
-#else
-          if ( fseek( h->fd, h->offsets[ i ], SEEK_SET ) != 0 || fread( outBuffer, h->chunks[ i ], 1, h->fd ) != 1 )
-#endif
-          {
-            strcpy( h->errorString, dz_error_str( DZ_ERR_READFILE ) );
+          count = dict_inflate_chunk( h, i, inBuffer, preFilter, postFilter );
+          if ( count < 0 ) {
+            xfree( inBuffer );
             xfree( buffer );
             return 0;
           }
 
-          dict_data_filter( outBuffer, &count, OUT_BUFFER_SIZE, preFilter );
-
-          h->zStream.next_in   = (Bytef *)outBuffer;
-          h->zStream.avail_in  = h->chunks[ i ];
-          h->zStream.next_out  = (Bytef *)inBuffer;
-          h->zStream.avail_out = h->chunkLength;
-          if ( inflate( &h->zStream, Z_PARTIAL_FLUSH ) != Z_OK ) {
-            //	       err_fatal( __func__, "inflate: %s\n", h->zStream.msg );
-            sprintf( h->errorString, "inflate: %s\n", h->zStream.msg );
-            xfree( buffer );
-            return 0;
+          copied = dict_copy_chunk( h, pt, inBuffer, count, i, firstChunk, firstOffset, lastChunk, lastOffset );
+
+          /* Hand the buffer over to the cache, replacing the least recently
+             used chunk there */
+          dict_lock( h );
+          target    = -1;
+          lastStamp = INT_MAX;
+          for ( j = 0; j < h->cacheSize; j++ ) {
+            if ( h->cache[ j ].chunk == i ) {
+              /* Another thread has inflated it meanwhile */
+              target = -1;
+              break;
+            }
+            if ( h->cache[ j ].stamp < lastStamp ) {
+              lastStamp = h->cache[ j ].stamp;
+              target    = j;
+            }
           }
-          if ( h->zStream.avail_in )
-          /*
-	       err_internal( __func__,
-			     "inflate did not flush (%d pending, %d avail)\n",
-			     h->zStream.avail_in, h->zStream.avail_out );
-*/
-          {
-            sprintf( h->errorString,
-                     "inflate did not flush (%d pending, %d avail)\n",
-                     h->zStream.avail_in,
-                     h->zStream.avail_out );
-            xfree( buffer );
-            return 0;
+          if ( target >= 0 ) {
+            dict_touch_cached( h, target );
+            if ( h->cache[ target ].inBuffer )
+              xfree( h->cache[ target ].inBuffer );
+            h->cache[ target ].inBuffer = inBuffer;
+            h->cache[ target ].count    = count;
+            h->cache[ target ].chunk    = i;
+            inBuffer                    = NULL;
           }
+          dict_unlock( h );
 
-          count = h->chunkLength - h->zStream.avail_out;
-          dict_data_filter( inBuffer, &count, h->chunkLength, postFilter );
-
-          h->cache[ target ].count = count;
-          h->cache[ target ].chunk = i;
+          if ( inBuffer )
+            xfree( inBuffer );
         }
 
-        if ( i == firstChunk ) {
-          if ( i == lastChunk ) {
-            memcpy( pt, inBuffer + firstOffset, lastOffset - firstOffset );
-            pt += lastOffset - firstOffset;
-          }
-          else {
-            if ( count != h->chunkLength )
-            /*
-		  err_internal( __func__,
-				"Length = %d instead of %d\n",
-				count, h->chunkLength );
-*/
-            {
-              sprintf( h->errorString, "Length = %d instead of %d\n", count, h->chunkLength );
-              xfree( buffer );
-              return 0;
-            }
-            memcpy( pt, inBuffer + firstOffset, h->chunkLength - firstOffset );
-            pt += h->chunkLength - firstOffset;
-          }
-        }
-        else if ( i == lastChunk ) {
-          memcpy( pt, inBuffer, lastOffset );
-          pt += lastOffset;
-        }
-        else {
-          assert( count == h->chunkLength );
-          memcpy( pt, inBuffer, h->chunkLength );
-          pt += h->chunkLength;
+        if ( copied < 0 ) {
+          xfree( buffer );
+          return 0;
         }
+        pt += copied;
       }
       *pt = '\0';
       break;
     case DICT_UNKNOWN:
       //      err_fatal( __func__, "Cannot read unknown file type\n" );
-      strcpy( h->errorString, "Cannot read unknown file type" );
+      strcpy( errorString, "Cannot read unknown file type" );
       xfree( buffer );
       return 0;
   }
-  h->errorString[ 0 ] = 0;
+  errorString[ 0 ] = 0;
   return buffer;
 }
 
 char * dict_error_str( dictData * data )
 {
-  return data->errorString;
+  (void)data;
+  return errorString;
 }
 
 const char * dz_error_str( enum DZ_ERRORS error )
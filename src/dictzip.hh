@@ -38,8 +38,12 @@ extern "C" {
 
 /* Excerpts from defs.h */
 
+/* Default number of inflated chunks cached, see dict_data_set_cache_size() */
 #define DICT_CACHE_SIZE 5
 
+/* Number of idle inflate streams kept around for reuse */
+#define DICT_INFLATER_POOL_SIZE 4
+
 typedef struct dictCache
 {
   int chunk;
@@ -70,8 +74,6 @@ typedef struct dictData
 
   int type;
   const char * filename;
-  z_stream zStream;
-  int initialized;
 
   int headerLength;
   int method;
@@ -89,9 +91,16 @@ typedef struct dictData
   unsigned long crc;
   unsigned long length;
   unsigned long compressedLength;
+  /* The following are shared by all the readers and guarded by the lock.
+     The file itself is only accessed with positional reads, and each reader
+     inflates with its own stream, so any number of threads may call
+     dict_data_read_() at once. */
+  void * lock;
   int stamp;
-  dictCache cache[ DICT_CACHE_SIZE ];
-  char errorString[ 512 ];
+  dictCache * cache;
+  int cacheSize;
+  z_stream * inflaters[ DICT_INFLATER_POOL_SIZE ];
+  int inflaterCount;
 } dictData;
 
 
@@ -100,9 +109,14 @@ extern dictData * dict_data_open( const char * filename, enum DZ_ERRORS * error,
 /* */
 extern void dict_data_close( dictData * data );
 
+/* Thread-safe. */
 extern char * dict_data_read_(
   dictData * data, unsigned long start, unsigned long end, const char * preFilter, const char * postFilter );
 
+/* Sets the number of inflated chunks cached, dropping the cached ones. */
+extern void dict_data_set_cache_size( dictData * data, int chunks );
+
+/* Returns the error of the last dict_data_read_() call made by this thread. */
 extern char * dict_error_str( dictData * data );
 
 extern const char * dz_error_str( enum DZ_ERRORS error );
@@ -11,6 +11,15 @@
 #include "folding.hh"
 #include "utils.hh"
 
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QScopeGuard>
+#include <QWaitCondition>
+
+#include <list>
+#include <map>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -23,20 +32,405 @@ namespace FtsHelpers {
 // finished  reversed   dehsinif
 const static std::string finish_mark = std::string( "dehsinif" );
 
-bool ftsIndexIsOldOrBad( BtreeIndexing::BtreeDictionary * dict )
+/// The file put into a full-text index once it's complete, so that checking
+/// the index doesn't need opening it. Its modification time tells whether the
+/// index has been rebuilt.
+const static std::string completion_marker = std::string( "/gd_complete" );
+
+/// The file in a full-text index which maps the article offsets to their
+/// headwords, so that the matches don't need looking up in the btree. It holds
+/// the number of the articles, then that many { offset, headword position }
+/// pairs sorted by the offset, then the headwords, each ending with a zero.
+const static std::string headword_map = std::string( "/gd_headwords" );
+
+namespace {
+
+enum {
+  /// The number of the full-text indexes kept open between the searches
+  MaxIdleIndexes = 64
+};
+
+struct HeadwordMapEntry
+{
+  uint32_t offset;
+  uint32_t position;
+
+  bool operator<( HeadwordMapEntry const & other ) const
+  {
+    return offset < other.offset;
+  }
+};
+
+/// Makes the headword map of the given dictionary's full-text index.
+/// Returns false on failure or cancellation.
+bool writeHeadwordMap( BtreeIndexing::BtreeDictionary & dict, QAtomicInt & isCancelled )
+{
+  QHash< uint32_t, uint32_t > positions;
+  string words;
+
+  // The first headword of an article in the index order is the one
+  // getHeadwordsFromOffsets() would give
+  dict.forEachArticleLink(
+    [ & ]( BtreeIndexing::WordArticleLink const & link ) {
+      if ( positions.contains( link.articleOffset ) )
+        return;
+
+      positions.insert( link.articleOffset, words.size() );
+      words.append( link.prefix );
+      words.append( link.word );
+      words.push_back( 0 );
+    },
+    &isCancelled );
+
+  if ( Utils::AtomicInt::loadAcquire( isCancelled ) )
+    return false;
+
+  vector< HeadwordMapEntry > entries;
+  entries.reserve( positions.size() );
+
+  for ( auto i = positions.constBegin(); i != positions.constEnd(); ++i )
+    entries.push_back( { i.key(), i.value() } );
+
+  std::sort( entries.begin(), entries.end() );
+
+  QSaveFile file( QString::fromStdString( dict.ftsIndexName() + headword_map ) );
+
+  if ( !file.open( QFile::WriteOnly ) ) {
+    qWarning() << "can't write" << file.fileName();
+    return false;
+  }
+
+  uint32_t const count = entries.size();
+
+  file.write( (char const *)&count, sizeof( count ) );
+  file.write( (char const *)entries.data(), entries.size() * sizeof( HeadwordMapEntry ) );
+  file.write( words.data(), words.size() );
+
+  return file.commit();
+}
+
+/// Returns the modification time of the completion marker of the given
+/// index, or -1 if there's none
+qint64 completionStamp( string const & indexName )
+{
+  QFileInfo info( QString::fromStdString( indexName + completion_marker ) );
+
+  return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+void markComplete( string const & indexName )
+{
+  QFile marker( QString::fromStdString( indexName + completion_marker ) );
+
+  if ( marker.open( QFile::WriteOnly | QFile::Truncate ) )
+    marker.write( finish_mark.c_str() );
+  else
+    qWarning() << "can't write" << marker.fileName();
+}
+
+/// A full-text index opened for searching
+struct OpenedIndex
+{
+  string name;
+  qint64 stamp;
+  Xapian::Database db;
+  Xapian::QueryParser qp;
+
+  /// Maps the headword map of the index, if it has one
+  void loadHeadwordMap();
+
+  /// Looks the headword of the given article up in the headword map. Returns
+  /// false if it isn't there.
+  bool findHeadword( uint32_t offset, QString & headword ) const;
+
+  bool hasHeadwordMap() const
+  {
+    return entries != nullptr;
+  }
+
+private:
+
+  QFile headwordFile;
+  HeadwordMapEntry const * entries = nullptr;
+  uint32_t entryCount              = 0;
+  char const * words               = nullptr;
+  qint64 wordsSize                 = 0;
+};
+
+void OpenedIndex::loadHeadwordMap()
+{
+  entries = nullptr;
+  headwordFile.close();
+  headwordFile.setFileName( QString::fromStdString( name + headword_map ) );
+
+  if ( !headwordFile.open( QFile::ReadOnly ) )
+    return;
+
+  qint64 const size = headwordFile.size();
+  uchar const * map = size >= (qint64)sizeof( uint32_t ) ? headwordFile.map( 0, size ) : nullptr;
+
+  if ( !map ) {
+    headwordFile.close();
+    return;
+  }
+
+  memcpy( &entryCount, map, sizeof( entryCount ) );
+
+  qint64 const wordsStart = sizeof( uint32_t ) + (qint64)entryCount * sizeof( HeadwordMapEntry );
+
+  if ( wordsStart > size ) {
+    qWarning() << "corrupted headword map" << headwordFile.fileName();
+    headwordFile.close();
+    return;
+  }
+
+  entries   = (HeadwordMapEntry const *)( map + sizeof( uint32_t ) );
+  words     = (char const *)map + wordsStart;
+  wordsSize = size - wordsStart;
+}
+
+bool OpenedIndex::findHeadword( uint32_t offset, QString & headword ) const
+{
+  if ( !entries )
+    return false;
+
+  HeadwordMapEntry const * end = entries + entryCount;
+  HeadwordMapEntry const * i   = std::lower_bound( entries, end, HeadwordMapEntry{ offset, 0 } );
+
+  if ( i == end || i->offset != offset || i->position >= wordsSize )
+    return false;
+
+  char const * word     = words + i->position;
+  char const * wordsEnd = (char const *)memchr( word, 0, wordsSize - i->position );
+
+  if ( !wordsEnd )
+    return false;
+
+  headword = QString::fromUtf8( word, wordsEnd - word );
+
+  return true;
+}
+
+/// Finds the headwords of the given articles in the headword map of the
+/// index, and in the btree for the articles missing there
+void getHeadwords( OpenedIndex & index,
+                   BtreeIndexing::BtreeDictionary & dict,
+                   QList< uint32_t > & offsets,
+                   QVector< QString > & headwords,
+                   QAtomicInt & isCancelled )
+{
+  // The indexes made before the headword maps were get one once the indexing
+  // checks them, which may be after the index was opened
+  if ( !index.hasHeadwordMap() )
+    index.loadHeadwordMap();
+
+  QList< uint32_t > unmapped;
+  QSet< QString > found;
+  QString headword;
+
+  for ( uint32_t offset : offsets ) {
+    if ( !index.findHeadword( offset, headword ) )
+      unmapped.append( offset );
+    else if ( !found.contains( headword ) ) {
+      found.insert( headword );
+      headwords.append( headword );
+    }
+  }
+
+  if ( !unmapped.isEmpty() )
+    dict.getHeadwordsFromOffsets( unmapped, headwords, &isCancelled );
+}
+
+/// Finds the headwords of the given articles like getHeadwords(), but keeps
+/// which article each one belongs to. The btree only gives the headwords of
+/// the articles missing in the headword map all at once, so these come apart.
+void mapHeadwords( OpenedIndex & index,
+                   BtreeIndexing::BtreeDictionary & dict,
+                   QList< uint32_t > const & offsets,
+                   QHash< uint32_t, QString > & headwordOf,
+                   QVector< QString > & unmappedHeadwords,
+                   QAtomicInt & isCancelled )
+{
+  if ( !index.hasHeadwordMap() )
+    index.loadHeadwordMap();
+
+  QList< uint32_t > unmapped;
+  QString headword;
+
+  for ( uint32_t offset : offsets ) {
+    if ( index.findHeadword( offset, headword ) )
+      headwordOf.insert( offset, headword );
+    else
+      unmapped.append( offset );
+  }
+
+  if ( !unmapped.isEmpty() )
+    dict.getHeadwordsFromOffsets( unmapped, unmappedHeadwords, &isCancelled );
+}
+
+/// Keeps the full-text indexes open between the searches. An opened index
+/// can't be used by several threads at once, so a search takes it out of the
+/// cache and puts it back when done, and the concurrent searches of the same
+/// index open their own copies.
+class IndexCache
+{
+public:
+
+  /// Takes the index out of the cache, or opens it. Throws Xapian::Error.
+  sptr< OpenedIndex > take( string const & name )
+  {
+    qint64 const stamp = completionStamp( name );
+
+    {
+      QMutexLocker _( &mutex );
+
+      for ( auto i = idle.begin(); i != idle.end(); ++i ) {
+        if ( ( *i )->name != name )
+          continue;
+
+        sptr< OpenedIndex > index = *i;
+        idle.erase( i );
+
+        if ( index->stamp == stamp )
+          return index;
+
+        // The index has been rebuilt since
+        break;
+      }
+    }
+
+    auto index   = std::make_shared< OpenedIndex >();
+    index->name  = name;
+    index->stamp = stamp;
+    index->db    = Xapian::Database( name );
+    index->qp.set_database( index->db );
+    index->loadHeadwordMap();
+
+    return index;
+  }
+
+  /// Puts the index taken back into the cache
+  void putBack( sptr< OpenedIndex > const & index )
+  {
+    QMutexLocker _( &mutex );
+
+    idle.push_front( index );
+
+    if ( idle.size() > MaxIdleIndexes )
+      idle.pop_back();
+  }
+
+  /// Closes the idle copies of the given index, which is about to be removed
+  /// or rebuilt
+  void close( string const & name )
+  {
+    QMutexLocker _( &mutex );
+
+    idle.remove_if( [ &name ]( sptr< OpenedIndex > const & index ) {
+      return index->name == name;
+    } );
+  }
+
+private:
+
+  QMutex mutex;
+  /// The most recently used ones go first
+  std::list< sptr< OpenedIndex > > idle;
+};
+
+IndexCache & indexCache()
+{
+  static IndexCache cache;
+
+  return cache;
+}
+
+/// The indexes whose headword maps couldn't be made, so that it isn't tried
+/// again on every check. An index is forgotten once it's rebuilt.
+class HeadwordMapFailures
+{
+public:
+
+  bool contains( string const & name )
+  {
+    QMutexLocker _( &mutex );
+    return names.count( name ) != 0;
+  }
+
+  void insert( string const & name )
+  {
+    QMutexLocker _( &mutex );
+    names.insert( name );
+  }
+
+  void remove( string const & name )
+  {
+    QMutexLocker _( &mutex );
+    names.erase( name );
+  }
+
+private:
+
+  QMutex mutex;
+  std::set< string > names;
+};
+
+HeadwordMapFailures & headwordMapFailures()
+{
+  static HeadwordMapFailures failures;
+
+  return failures;
+}
+
+/// Makes the headword map of the dictionary's full-text index, remembering
+/// the failure unless it was cancelled
+void makeHeadwordMap( BtreeIndexing::BtreeDictionary & dict, QAtomicInt & isCancelled )
+{
+  if ( !writeHeadwordMap( dict, isCancelled ) && !Utils::AtomicInt::loadAcquire( isCancelled ) ) {
+    qWarning() << "can't make the headword map of" << QString::fromStdString( dict.ftsIndexName() );
+    headwordMapFailures().insert( dict.ftsIndexName() );
+  }
+}
+
+/// Makes the headword map of a complete index made before the maps were,
+/// unless it has one already or making it failed before
+void ensureHeadwordMap( BtreeIndexing::BtreeDictionary & dict, QAtomicInt & isCancelled )
 {
+  if ( QFileInfo::exists( QString::fromStdString( dict.ftsIndexName() + headword_map ) )
+       || headwordMapFailures().contains( dict.ftsIndexName() ) )
+    return;
+
+  makeHeadwordMap( dict, isCancelled );
+}
+
+} // namespace
+
+bool ftsIndexIsOldOrBad( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancelled )
+{
+  if ( completionStamp( dict->ftsIndexName() ) >= 0 ) {
+    ensureHeadwordMap( *dict, isCancelled );
+    return false;
+  }
+
   try {
-    Xapian::WritableDatabase db( dict->ftsIndexName() );
+    Xapian::Database db( dict->ftsIndexName() );
     auto docid    = db.get_lastdocid();
     auto document = db.get_document( docid );
 
     qDebug() << document.get_data().c_str();
     //use a special document to mark the end of the index.
-    return document.get_data() != finish_mark;
+    if ( document.get_data() != finish_mark )
+      return true;
+
+    // Made before the completion markers were
+    markComplete( dict->ftsIndexName() );
+    ensureHeadwordMap( *dict, isCancelled );
+    return false;
   }
   catch ( Xapian::Error & e ) {
     qWarning() << e.get_description().c_str();
     //the file is corrupted,remove it.
+    indexCache().close( dict->ftsIndexName() );
     QFile::remove( QString::fromStdString( dict->ftsIndexName() ) );
     return true;
   }
@@ -45,6 +439,330 @@ bool ftsIndexIsOldOrBad( BtreeIndexing::BtreeDictionary * dict )
   }
 }
 
+namespace {
+
+enum {
+  /// The number of articles a worker takes at once
+  IndexingBatchSize = 256,
+  /// The number of articles added between the commits, which are the points
+  /// the indexing is resumed from after being interrupted
+  IndexingCheckpointInterval = 16384
+};
+
+/// The metadata key of the last checkpoint, which is "<articles done> <last address>"
+const static std::string checkpoint_key = std::string( "gd_checkpoint" );
+
+/// Keeps the number of threads used by the full-text indexing within the
+/// parallelThreads preference. Each dictionary being indexed has its own
+/// thread, which writes the database, and its workers use the threads left.
+class IndexingThreads
+{
+public:
+
+  /// Counts the thread of a dictionary starting to be indexed. The number of
+  /// such dictionaries is limited by the caller already.
+  void addWriter()
+  {
+    QMutexLocker _( &mutex );
+    ++used;
+  }
+
+  /// Takes up to 'wanted' of the threads left for the workers. Returns the
+  /// number of the threads taken.
+  int takeSpare( int wanted )
+  {
+    QMutexLocker _( &mutex );
+
+    int const taken = qMax( 0, qMin( wanted, limit() - used ) );
+    used += taken;
+
+    return taken;
+  }
+
+  /// Gives a thread back if more than allowed are used, which happens once
+  /// more dictionaries start being indexed. Returns true if it did.
+  bool releaseIfOverLimit()
+  {
+    QMutexLocker _( &mutex );
+
+    if ( used <= limit() )
+      return false;
+
+    --used;
+    return true;
+  }
+
+  /// Gives a thread of a writer or a worker back
+  void release()
+  {
+    QMutexLocker _( &mutex );
+    --used;
+  }
+
+private:
+
+  static int limit()
+  {
+    return qMax( (int)GlobalBroadcaster::instance()->getPreference()->fts.parallelThreads, 1 );
+  }
+
+  QMutex mutex;
+  int used = 0;
+};
+
+IndexingThreads & indexingThreads()
+{
+  static IndexingThreads threads;
+
+  return threads;
+}
+
+/// Turns the articles into Xapian documents on several threads at once, in
+/// batches of consecutive articles. The documents are handed back to the
+/// thread writing them to the database in the order of the articles, which
+/// keeps the document ids in that order as well.
+class IndexingPipeline
+{
+public:
+
+  IndexingPipeline( BtreeIndexing::BtreeDictionary * dict_,
+                    QVector< uint32_t > const & offsets_,
+                    int first_,
+                    QAtomicInt & isCancelled_ ):
+    dict( dict_ ),
+    offsets( offsets_ ),
+    first( first_ ),
+    batchCount( ( (int)offsets_.size() - first_ + IndexingBatchSize - 1 ) / IndexingBatchSize ),
+    isCancelled( isCancelled_ ),
+    withPositions( GlobalBroadcaster::instance()->getPreference()->fts.enablePosition )
+  {
+  }
+
+  /// Starts the workers on the bulk pool, as many as there are threads left
+  /// within the parallelThreads preference
+  void start()
+  {
+    int const workerCount = indexingThreads().takeSpare( batchCount - 1 );
+
+    for ( int x = 0; x < workerCount; ++x ) {
+      workers.push_back( Scheduler::run( Scheduler::Bulk, [ this ]() {
+        if ( !work( false ) )
+          indexingThreads().release();
+      } ) );
+    }
+  }
+
+  /// Waits for the next batch of documents and takes it. Makes the batch
+  /// itself if no worker has taken it yet, so it never waits for a worker
+  /// which hasn't been started. Returns false once all the batches are taken,
+  /// or the indexing was cancelled or failed.
+  bool takeNext( vector< Xapian::Document > & documents )
+  {
+    QMutexLocker _( &mutex );
+
+    for ( ;; ) {
+      if ( failed || Utils::AtomicInt::loadAcquire( isCancelled ) || nextToTake == batchCount )
+        return false;
+
+      auto i = ready.find( nextToTake );
+
+      if ( i != ready.end() ) {
+        documents.swap( i->second );
+        ready.erase( i );
+        ++nextToTake;
+        batchTaken.wakeAll();
+        return true;
+      }
+
+      if ( nextToMake < batchCount && nextToMake < nextToTake + maxBatchesAhead() ) {
+        _.unlock();
+        work( true );
+        _.relock();
+      }
+      else
+        batchReady.wait( &mutex, 100 );
+    }
+  }
+
+  /// Drops the workers which haven't been started and waits for the rest
+  void stop()
+  {
+    {
+      QMutexLocker _( &mutex );
+      stopped = true;
+      batchTaken.wakeAll();
+    }
+
+    for ( auto & worker : workers ) {
+      // The workers dropped before starting never give their threads back
+      if ( worker.cancel() )
+        indexingThreads().release();
+
+      worker.waitForFinished();
+    }
+  }
+
+private:
+
+  /// Makes the batches until there are none left. With 'once', only makes one.
+  /// Otherwise, it's a worker, which leaves early if the indexing uses more
+  /// threads than allowed. Returns true if it gave its thread back then.
+  bool work( bool once )
+  {
+    Xapian::TermGenerator indexer;
+    indexer.set_flags( Xapian::TermGenerator::FLAG_CJK_NGRAM );
+
+    for ( ;; ) {
+      int batch;
+
+      {
+        QMutexLocker _( &mutex );
+
+        // Don't run too far ahead of the writer, since the documents are kept in memory
+        while ( !once && !stopped && !failed && nextToMake < batchCount
+                && nextToMake >= nextToTake + maxBatchesAhead() )
+          batchTaken.wait( &mutex, 100 );
+
+        if ( stopped || failed || nextToMake == batchCount || Utils::AtomicInt::loadAcquire( isCancelled ) )
+          return false;
+
+        if ( !once && indexingThreads().releaseIfOverLimit() )
+          return true;
+
+        batch = nextToMake++;
+      }
+
+      vector< Xapian::Document > documents;
+
+      try {
+        int const begin = first + batch * IndexingBatchSize;
+        int const end   = qMin( begin + (int)IndexingBatchSize, (int)offsets.size() );
+
+        documents.reserve( end - begin );
+
+        for ( int x = begin; x < end && !Utils::AtomicInt::loadAcquire( isCancelled ); ++x ) {
+          QString headword, articleStr;
+
+          dict->getArticleText( offsets[ x ], headword, articleStr );
+
+          Xapian::Document doc;
+
+          indexer.set_document( doc );
+
+          if ( withPositions ) {
+            indexer.index_text( articleStr.toStdString() );
+          }
+          else {
+            indexer.index_text_without_positions( articleStr.toStdString() );
+          }
+
+          doc.set_data( std::to_string( offsets[ x ] ) );
+
+          documents.push_back( std::move( doc ) );
+        }
+      }
+      catch ( Xapian::Error & e ) {
+        qWarning() << "making xapian documents:" << QString::fromStdString( e.get_description() );
+        fail();
+        return false;
+      }
+      catch ( std::exception & e ) {
+        qWarning() << "making xapian documents:" << e.what();
+        fail();
+        return false;
+      }
+
+      {
+        QMutexLocker _( &mutex );
+        ready[ batch ].swap( documents );
+        batchReady.wakeAll();
+      }
+
+      if ( once )
+        return false;
+    }
+  }
+
+  void fail()
+  {
+    QMutexLocker _( &mutex );
+    failed = true;
+    batchReady.wakeAll();
+    batchTaken.wakeAll();
+  }
+
+  int maxBatchesAhead() const
+  {
+    return 2 * ( (int)workers.size() + 1 );
+  }
+
+  BtreeIndexing::BtreeDictionary * dict;
+  QVector< uint32_t > const & offsets;
+  int const first;
+  int const batchCount;
+  QAtomicInt & isCancelled;
+  bool const withPositions;
+
+  vector< Scheduler::Future > workers;
+
+  QMutex mutex;
+  QWaitCondition batchReady, batchTaken;
+  std::map< int, vector< Xapian::Document > > ready;
+  int nextToMake = 0;
+  int nextToTake = 0;
+  bool stopped   = false;
+  bool failed    = false;
+};
+
+/// Returns the position in the offsets to resume the indexing from, given
+/// what the database already holds. There's one document per article, added
+/// in the order of the offsets, so the id of the last document is the number
+/// of the articles done.
+int resumePosition( Xapian::WritableDatabase & db, QVector< uint32_t > const & offsets )
+{
+  try {
+    Xapian::docid const lastDocId = db.get_lastdocid();
+
+    if ( lastDocId == 0 )
+      return 0;
+
+    Xapian::Document lastDoc = db.get_document( lastDocId );
+    uint32_t lastAddress     = atoi( lastDoc.get_data().c_str() );
+
+    std::string const checkpoint = db.get_metadata( checkpoint_key );
+
+    if ( !checkpoint.empty() ) {
+      int done                   = 0;
+      unsigned checkpointAddress = 0;
+
+      // Xapian flushes the added documents by itself every now and then, so
+      // the database may hold more of them than the last checkpoint tells.
+      // Only trust it if it agrees with the last document.
+      if ( sscanf( checkpoint.c_str(), "%d %u", &done, &checkpointAddress ) == 2 && done > 0
+           && done <= offsets.size() && offsets[ done - 1 ] == checkpointAddress && (Xapian::docid)done == lastDocId )
+        return done;
+    }
+
+    // Documents flushed past the checkpoint, which still follow the offsets
+    if ( lastDocId <= (Xapian::docid)offsets.size() && offsets[ lastDocId - 1 ] == lastAddress )
+      return lastDocId;
+
+    // Made without checkpoints, or the articles have changed their order.
+    // Skip up to the last article indexed.
+    int position = 0;
+    while ( position < offsets.size() && offsets[ position ] <= lastAddress )
+      ++position;
+
+    return position;
+  }
+  catch ( Xapian::Error & e ) {
+    qDebug() << "get last doc failed: " << e.get_description().c_str();
+    return 0;
+  }
+}
+
+} // namespace
+
 void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancelled )
 {
   QMutexLocker _( &dict->getFtsMutex() );
@@ -57,15 +775,14 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
     if ( Utils::AtomicInt::loadAcquire( isCancelled ) )
       throw exUserAbort();
 
+    // The old index is going to be replaced
+    indexCache().close( dict->ftsIndexName() );
+    QFile::remove( QString::fromStdString( dict->ftsIndexName() + completion_marker ) );
+    QFile::remove( QString::fromStdString( dict->ftsIndexName() + headword_map ) );
+
     // Open the database for update, creating a new database if necessary.
     Xapian::WritableDatabase db( dict->ftsIndexName() + "_temp", Xapian::DB_CREATE_OR_OPEN );
 
-    Xapian::TermGenerator indexer;
-    //  Xapian::Stem stemmer("english");
-    //  indexer.set_stemmer(stemmer);
-    //  indexer.set_stemming_strategy(indexer.STEM_SOME_FULL_POS);
-    indexer.set_flags( Xapian::TermGenerator::FLAG_CJK_NGRAM );
-
     BtreeIndexing::IndexedWords indexedWords;
 
     QSet< uint32_t > setOfOffsets;
@@ -94,59 +811,54 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
     dict->sortArticlesOffsetsForFTS( offsets, isCancelled );
 
     // incremental build the index.
-    // get the last address.
-    bool skip            = true;
-    uint32_t lastAddress = -1;
-    try {
-      if ( db.get_lastdocid() > 0 ) {
-        Xapian::Document lastDoc = db.get_document( db.get_lastdocid() );
-        lastAddress              = atoi( lastDoc.get_data().c_str() );
-      }
-      else {
-        skip = false;
-      }
-    }
-    catch ( Xapian::Error & e ) {
-      qDebug() << "get last doc failed: " << e.get_description().c_str();
-      skip = false;
-    }
+    int indexedDoc = resumePosition( db, offsets );
+    int checkpoint = indexedDoc;
 
-    long indexedDoc = 0L;
+    dict->setIndexedFtsDoc( indexedDoc );
 
-    for ( auto const & address : offsets ) {
-      indexedDoc++;
+    indexingThreads().addWriter();
+    auto const writerReleaser = qScopeGuard( [] {
+      indexingThreads().release();
+    } );
 
-      if ( address > lastAddress && skip ) {
-        skip = false;
-      }
-      //skip until to the lastAddress;
-      if ( skip ) {
-        continue;
-      }
+    IndexingPipeline pipeline( dict, offsets, indexedDoc, isCancelled );
+    pipeline.start();
 
-      if ( Utils::AtomicInt::loadAcquire( isCancelled ) ) {
-        return;
-      }
+    vector< Xapian::Document > documents;
 
-      QString headword, articleStr;
+    try {
+      while ( pipeline.takeNext( documents ) ) {
+        for ( auto const & doc : documents ) {
+          // Add the document to the database.
+          db.add_document( doc );
+        }
 
-      dict->getArticleText( address, headword, articleStr );
+        indexedDoc += documents.size();
+        dict->setIndexedFtsDoc( indexedDoc );
 
-      Xapian::Document doc;
+        if ( indexedDoc - checkpoint >= IndexingCheckpointInterval ) {
+          db.set_metadata( checkpoint_key,
+                           std::to_string( indexedDoc ) + " " + std::to_string( offsets[ indexedDoc - 1 ] ) );
+          db.commit();
+          checkpoint = indexedDoc;
+        }
+      }
+    }
+    catch ( ... ) {
+      pipeline.stop();
+      throw;
+    }
 
-      indexer.set_document( doc );
+    pipeline.stop();
 
-      if ( GlobalBroadcaster::instance()->getPreference()->fts.enablePosition ) {
-        indexer.index_text( articleStr.toStdString() );
-      }
-      else {
-        indexer.index_text_without_positions( articleStr.toStdString() );
+    if ( indexedDoc < offsets.size() ) {
+      // Cancelled or failed. Keep what's done to resume from there next time.
+      if ( indexedDoc > 0 && indexedDoc != checkpoint ) {
+        db.set_metadata( checkpoint_key,
+                         std::to_string( indexedDoc ) + " " + std::to_string( offsets[ indexedDoc - 1 ] ) );
+        db.commit();
       }
-
-      doc.set_data( std::to_string( address ) );
-      // Add the document to the database.
-      db.add_document( doc );
-      dict->setIndexedFtsDoc( indexedDoc );
+      return;
     }
 
     //add a special document to mark the end of the index.
@@ -165,6 +877,11 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
     db.close();
 
     Utils::Fs::removeDirectory( dict->ftsIndexName() + "_temp" );
+
+    headwordMapFailures().remove( dict->ftsIndexName() );
+    makeHeadwordMap( *dict, isCancelled );
+
+    markComplete( dict->ftsIndexName() );
   }
   catch ( Xapian::Error & e ) {
     qWarning() << "create xapian index:" << QString::fromStdString( e.get_description() );
@@ -179,15 +896,21 @@ void FTSResultsRequest::run()
     return;
   }
 
+  // Put back into the cache once nothing refers to it anymore
+  sptr< OpenedIndex > index;
+
   try {
     if ( dict.haveFTSIndex() ) {
+      QElapsedTimer timer;
+      timer.start();
+
       //no need to parse the search string,  use xapian directly.
       //if the search mode is wildcard, change xapian search query flag?
-      // Open the database for searching.
-      Xapian::Database db( dict.ftsIndexName() );
+      // Take the database opened for searching.
+      index = indexCache().take( dict.ftsIndexName() );
 
       // Start an enquire session.
-      Xapian::Enquire enquire( db );
+      Xapian::Enquire enquire( index->db );
 
       // Combine the rest of the command line arguments with spaces between
       // them, so that simple queries don't have to be quoted at the shell
@@ -195,12 +918,10 @@ void FTSResultsRequest::run()
       string query_string( searchString.toStdString() );
 
       // Parse the query string to produce a Xapian::Query object.
-      Xapian::QueryParser qp;
-      qp.set_database( db );
       Xapian::QueryParser::feature_flag flag = Xapian::QueryParser::FLAG_DEFAULT;
       if ( searchMode == FTS::Wildcards )
         flag = Xapian::QueryParser::FLAG_WILDCARD;
-      Xapian::Query query = qp.parse_query( query_string, flag | Xapian::QueryParser::FLAG_CJK_NGRAM );
+      Xapian::Query query = index->qp.parse_query( query_string, flag | Xapian::QueryParser::FLAG_CJK_NGRAM );
       qDebug() << "Parsed query is: " << query.get_description().c_str();
 
       // Find the top 100 results for the query.
@@ -222,13 +943,15 @@ void FTSResultsRequest::run()
 
       if ( !offsetsForHeadwords.isEmpty() ) {
         QVector< QString > headwords;
+        getHeadwords( *index, dict, offsetsForHeadwords, headwords, isCancelled );
         QMutexLocker _( &dataMutex );
         QString id = QString::fromUtf8( dict.getId().c_str() );
-        dict.getHeadwordsFromOffsets( offsetsForHeadwords, headwords, &isCancelled );
         for ( const auto & headword : headwords ) {
           foundHeadwords->append( FTS::FtsHeadword( headword, id, QStringList(), matchCase ) );
         }
       }
+
+      qDebug() << "FTS: queried" << QString::fromUtf8( dict.getName().c_str() ) << "in" << timer.elapsed() << "ms";
     }
     else {
       //if no fulltext index,just returned.
@@ -247,12 +970,170 @@ void FTSResultsRequest::run()
   }
   catch ( const Xapian::Error & e ) {
     qWarning() << e.get_description().c_str();
+    index.reset();
   }
   catch ( std::exception & ex ) {
     gdWarning( "FTS: Failed full-text search for \"%s\", reason: %s\n", dict.getName().c_str(), ex.what() );
     // Results not loaded -- we don't set the hasAnyData flag then
+    index.reset();
+  }
+
+  if ( index )
+    indexCache().putBack( index );
+
+  finish();
+}
+
+QList< FTS::FtsHeadword > FTSFederatedRequest::takeHeadwords()
+{
+  QList< FTS::FtsHeadword > headwords;
+
+  QMutexLocker _( &dataMutex );
+  headwords.swap( foundHeadwords );
+
+  return headwords;
+}
+
+void FTSFederatedRequest::run()
+{
+  if ( Utils::AtomicInt::loadAcquire( isCancelled ) ) {
+    finish();
+    return;
   }
 
+  // Put back into the cache once the joined database is gone
+  vector< sptr< OpenedIndex > > indexes;
+
+  try {
+    QElapsedTimer timer;
+    timer.start();
+
+    Xapian::Database db;
+    vector< BtreeIndexing::BtreeDictionary * > indexed;
+
+    for ( auto const & dict : dicts ) {
+      auto * btreeDict = dynamic_cast< BtreeIndexing::BtreeDictionary * >( dict.get() );
+
+      if ( !btreeDict || !btreeDict->haveFTSIndex() || btreeDict->ftsIndexIsEmbedded()
+           || !btreeDict->ensureInitDone().empty() )
+        continue;
+
+      indexes.push_back( indexCache().take( btreeDict->ftsIndexName() ) );
+      db.add_database( indexes.back()->db );
+      indexed.push_back( btreeDict );
+    }
+
+    if ( indexed.empty() ) {
+      qWarning() << "There is no fulltext index right now.";
+      finish();
+      return;
+    }
+
+    Xapian::Enquire enquire( db );
+
+    Xapian::QueryParser qp;
+    qp.set_database( db );
+    Xapian::QueryParser::feature_flag flag = Xapian::QueryParser::FLAG_DEFAULT;
+    if ( searchMode == FTS::Wildcards )
+      flag = Xapian::QueryParser::FLAG_WILDCARD;
+    Xapian::Query query = qp.parse_query( searchString.toStdString(), flag | Xapian::QueryParser::FLAG_CJK_NGRAM );
+    qDebug() << "Parsed federated query is: " << query.get_description().c_str();
+
+    enquire.set_query( query );
+
+    Xapian::doccount const subCount = indexed.size();
+
+    for ( Xapian::doccount first = 0; first < MaxMatches; first += PageSize ) {
+      if ( Utils::AtomicInt::loadAcquire( isCancelled ) )
+        break;
+
+      Xapian::MSet matches = enquire.get_mset( first, PageSize );
+
+      if ( first == 0 )
+        emit matchCount( matches.get_matches_estimated() );
+
+      // The documents of the joined databases are interleaved: document n of
+      // database k becomes document ( n - 1 ) * subCount + k + 1
+      vector< std::pair< Xapian::doccount, uint32_t > > ranked;
+      vector< QList< uint32_t > > offsets( subCount );
+
+      for ( Xapian::MSetIterator i = matches.begin(); i != matches.end(); ++i ) {
+        string const data = i.get_document().get_data();
+        if ( data == finish_mark )
+          continue;
+        Xapian::doccount const sub = ( *i - 1 ) % subCount;
+        ranked.emplace_back( sub, atoi( data.c_str() ) );
+        offsets[ sub ].append( ranked.back().second );
+      }
+
+      // The headwords are looked up per dictionary, then put in the order of
+      // the ranking, with those missing in the headword maps last
+      vector< QHash< uint32_t, QString > > headwordOf( subCount );
+      vector< QVector< QString > > unmappedHeadwords( subCount );
+      vector< QString > ids( subCount );
+
+      for ( Xapian::doccount x = 0; x < subCount; ++x ) {
+        if ( offsets[ x ].isEmpty() )
+          continue;
+
+        mapHeadwords( *indexes[ x ],
+                      *indexed[ x ],
+                      offsets[ x ],
+                      headwordOf[ x ],
+                      unmappedHeadwords[ x ],
+                      isCancelled );
+        ids[ x ] = QString::fromUtf8( indexed[ x ]->getId().c_str() );
+      }
+
+      QList< FTS::FtsHeadword > page;
+      vector< QSet< QString > > added( subCount );
+
+      for ( auto const & [ sub, offset ] : ranked ) {
+        auto const headword = headwordOf[ sub ].constFind( offset );
+        if ( headword == headwordOf[ sub ].constEnd() || added[ sub ].contains( *headword ) )
+          continue;
+
+        added[ sub ].insert( *headword );
+        page.append( FTS::FtsHeadword( *headword, ids[ sub ], QStringList(), matchCase ) );
+      }
+
+      for ( Xapian::doccount x = 0; x < subCount; ++x ) {
+        for ( const auto & headword : unmappedHeadwords[ x ] ) {
+          if ( added[ x ].contains( headword ) )
+            continue;
+
+          added[ x ].insert( headword );
+          page.append( FTS::FtsHeadword( headword, ids[ x ], QStringList(), matchCase ) );
+        }
+      }
+
+      if ( !page.isEmpty() ) {
+        {
+          QMutexLocker _( &dataMutex );
+          foundHeadwords.append( page );
+        }
+        update();
+      }
+
+      if ( first == 0 )
+        qDebug() << "FTS: federated query of" << subCount << "dictionaries in" << timer.elapsed() << "ms";
+
+      if ( matches.size() < PageSize )
+        break;
+    }
+  }
+  catch ( const Xapian::Error & e ) {
+    qWarning() << e.get_description().c_str();
+    indexes.clear();
+  }
+  catch ( std::exception & ex ) {
+    gdWarning( "FTS: Failed federated full-text search, reason: %s\n", ex.what() );
+    indexes.clear();
+  }
+
+  for ( auto const & index : indexes )
+    indexCache().putBack( index );
+
   finish();
 }
 
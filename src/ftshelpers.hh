@@ -8,7 +8,6 @@
   #include <QRegExp>
 #endif
 #include <QList>
-#include <QtConcurrent>
 
 #include "dict/dictionary.hh"
 #include "btreeidx.hh"
@@ -18,7 +17,10 @@
 
 namespace FtsHelpers {
 
-bool ftsIndexIsOldOrBad( BtreeIndexing::BtreeDictionary * dict );
+/// Checks whether the full-text index of the dictionary has to be made anew.
+/// A complete index made before the headword maps were gets its map made here,
+/// on the indexing threads, so that the searches don't have to.
+bool ftsIndexIsOldOrBad( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancelled );
 
 void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancelled );
 
@@ -33,7 +35,7 @@ class FTSResultsRequest: public Dictionary::DataRequest
   QAtomicInt isCancelled;
 
   QAtomicInt results;
-  QFuture< void > f;
+  Scheduler::Future f;
 
   QList< FTS::FtsHeadword > * foundHeadwords;
 
@@ -55,7 +57,7 @@ public:
 
     foundHeadwords = new QList< FTS::FtsHeadword >;
     results        = 0;
-    f              = QtConcurrent::run( [ this ]() {
+    f              = Scheduler::run( Scheduler::Interactive, [ this ]() {
       this->run();
     } );
   }
@@ -64,6 +66,9 @@ public:
   virtual void cancel()
   {
     isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
   }
 
   ~FTSResultsRequest()
@@ -75,6 +80,66 @@ public:
   }
 };
 
+/// Searches the full-text indexes of several dictionaries at once, joined
+/// into a single Xapian database, so that the matches are ranked across all
+/// of them. The matches are fetched page by page, most relevant first, and
+/// each page is announced with updated() as soon as its headwords are known.
+class FTSFederatedRequest: public Dictionary::DataRequest
+{
+  std::vector< sptr< Dictionary::Class > > dicts;
+
+  QString searchString;
+  int searchMode;
+  bool matchCase;
+
+  QAtomicInt isCancelled;
+  Scheduler::Future f;
+
+  /// The headwords not taken yet, guarded by dataMutex
+  QList< FTS::FtsHeadword > foundHeadwords;
+
+public:
+
+  enum {
+    /// The number of matches fetched at once
+    PageSize = 100,
+    /// The matches past that are never fetched
+    MaxMatches = 10000
+  };
+
+  FTSFederatedRequest( std::vector< sptr< Dictionary::Class > > const & dicts_,
+                       QString const & searchString_,
+                       int searchMode_,
+                       bool matchCase_ ):
+    dicts( dicts_ ),
+    searchString( searchString_ ),
+    searchMode( searchMode_ ),
+    matchCase( matchCase_ )
+  {
+    f = Scheduler::run( Scheduler::Interactive, [ this ]() {
+      this->run();
+    } );
+  }
+
+  /// Returns the headwords found since the previous call
+  QList< FTS::FtsHeadword > takeHeadwords();
+
+  void run();
+  virtual void cancel()
+  {
+    isCancelled.ref();
+
+    if ( f.cancel() )
+      finish();
+  }
+
+  ~FTSFederatedRequest()
+  {
+    isCancelled.ref();
+    f.waitForFinished();
+  }
+};
+
 } // namespace FtsHelpers
 
 #endif // __FTSHELPERS_HH_INCLUDED__
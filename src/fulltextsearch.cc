@@ -5,8 +5,10 @@
 #include "ftshelpers.hh"
 #include "gddebug.hh"
 #include "help.hh"
+#include "scheduler.hh"
 
 #include <QThreadPool>
+#include <QtConcurrent>
 #include <QMessageBox>
 #include <qalgorithms.h>
 
@@ -30,6 +32,7 @@ void Indexing::run()
 
     QFutureSynchronizer< void > synchronizer;
     qDebug() << "starting create the fts with thread:" << parallel_count;
+    QThreadPool & bulkPool = Scheduler::pool( Scheduler::Bulk );
     for ( const auto & dictionary : dictionaries ) {
       if ( Utils::AtomicInt::loadAcquire( isCancelled ) ) {
         // synchronizer.setCancelOnWait( true );
@@ -38,7 +41,7 @@ void Indexing::run()
 
       if ( dictionary->canFTS() && !dictionary->haveFTSIndex() ) {
         sem.acquire();
-        QFuture< void > const f = QtConcurrent::run( [ this, &sem, &dictionary ]() {
+        QFuture< void > const f = QtConcurrent::run( &bulkPool, [ this, &sem, &dictionary ]() {
           QSemaphoreReleaser const _( sem );
           emit sendNowIndexingName( QString::fromUtf8( dictionary->getName().c_str() ) );
           dictionary->makeFTSIndex( isCancelled, false );
@@ -93,7 +96,8 @@ void FtsIndexing::doIndexing()
 
     connect( idx, &Indexing::sendNowIndexingName, this, &FtsIndexing::setNowIndexedName );
 
-    QThreadPool::globalInstance()->start( idx );
+    // It mostly waits for the dictionaries being indexed on the bulk pool
+    Scheduler::pool( Scheduler::Background ).start( idx );
 
     started = true;
   }
@@ -127,6 +131,18 @@ QString FtsIndexing::nowIndexingName()
   return nowIndexing;
 }
 
+/// Adds the dictionaries and the hilites of 'add', the same headword found
+/// elsewhere, to 'base'
+void mergeHeadword( FtsHeadword & base, FtsHeadword const & add )
+{
+  base.dictIDs.append( add.dictIDs );
+  for ( QStringList::const_iterator itr = add.foundHiliteRegExps.constBegin(); itr != add.foundHiliteRegExps.constEnd();
+        ++itr ) {
+    if ( !base.foundHiliteRegExps.contains( *itr ) )
+      base.foundHiliteRegExps.append( *itr );
+  }
+}
+
 void addSortedHeadwords( QList< FtsHeadword > & base_list, QList< FtsHeadword > const & add_list )
 {
   QList< FtsHeadword > list;
@@ -166,13 +182,7 @@ void addSortedHeadwords( QList< FtsHeadword > & base_list, QList< FtsHeadword >
       ++add_it;
     }
     else if ( *add_it == *base_it ) {
-      base_it->dictIDs.append( add_it->dictIDs );
-      for ( QStringList::const_iterator itr = add_it->foundHiliteRegExps.constBegin();
-            itr != add_it->foundHiliteRegExps.constEnd();
-            ++itr ) {
-        if ( !base_it->foundHiliteRegExps.contains( *itr ) )
-          base_it->foundHiliteRegExps.append( *itr );
-      }
+      mergeHeadword( *base_it, *add_it );
       ++add_it;
     }
     else {
@@ -223,6 +233,8 @@ FullTextSearchDialog::FullTextSearchDialog( QWidget * parent,
 
   ui.searchMode->setCurrentIndex( cfg.preferences.fts.searchMode );
 
+  ui.federatedSearch->setChecked( cfg.preferences.fts.federatedSearch );
+
   ui.searchProgressBar->hide();
 
   model = new HeadwordsListModel( this, results, activeDicts );
@@ -300,6 +312,8 @@ void FullTextSearchDialog::saveData()
 {
   cfg.preferences.fts.searchMode = ui.searchMode->currentIndex();
 
+  cfg.preferences.fts.federatedSearch = ui.federatedSearch->isChecked();
+
   cfg.preferences.fts.dialogGeometry = saveGeometry();
 }
 
@@ -340,11 +354,46 @@ void FullTextSearchDialog::accept()
   ui.OKButton->setEnabled( false );
   ui.searchProgressBar->show();
 
+  bool const federated = ui.federatedSearch->isChecked();
+
+  // The federated results come ranked across the dictionaries, which the
+  // list keeps rather than sorting them
+  rankedResults = federated;
+
+  if ( federated ) {
+    federatedReq =
+      std::make_shared< FtsHelpers::FTSFederatedRequest >( activeDicts, ui.searchLine->text(), mode, false );
+
+    connect( federatedReq.get(),
+             &Dictionary::Request::updated,
+             this,
+             &FullTextSearchDialog::federatedReqUpdated,
+             Qt::QueuedConnection );
+
+    connect( federatedReq.get(),
+             &Dictionary::Request::finished,
+             this,
+             &FullTextSearchDialog::searchReqFinished,
+             Qt::QueuedConnection );
+
+    connect( federatedReq.get(),
+             &Dictionary::Request::matchCount,
+             this,
+             &FullTextSearchDialog::matchCount,
+             Qt::QueuedConnection );
+
+    searchReqs.push_back( federatedReq );
+  }
+
   // Make search requests
   for ( unsigned x = 0; x < activeDicts.size(); ++x ) {
     if ( !activeDicts[ x ]->haveFTSIndex() ) {
       continue;
     }
+    // The federated search covers all but the ones with embedded indexes
+    if ( federated && !activeDicts[ x ]->ftsIndexIsEmbedded() ) {
+      continue;
+    }
     //max results=100
     sptr< Dictionary::DataRequest > req =
       activeDicts[ x ]->getSearchResults( ui.searchLine->text(), mode, false, false );
@@ -375,6 +424,12 @@ void FullTextSearchDialog::searchReqFinished()
       if ( ( *it )->isFinished() ) {
         GD_DPRINTF( "one finished.\n" );
 
+        if ( *it == federatedReq ) {
+          federatedReqUpdated();
+          federatedReq.reset();
+          break;
+        }
+
         QString errorString = ( *it )->getErrorString();
 
         if ( ( *it )->dataSize() >= 0 || errorString.size() ) {
@@ -384,9 +439,15 @@ void FullTextSearchDialog::searchReqFinished()
             try {
               ( *it )->getDataSlice( 0, sizeof( headwords ), &headwords );
               hws.swap( *headwords );
-              std::sort( hws.begin(), hws.end() );
               delete headwords;
-              addSortedHeadwords( allHeadwords, hws );
+              if ( rankedResults ) {
+                // Follow the ranked ones in the dictionary's own order
+                allHeadwords.append( hws );
+              }
+              else {
+                std::sort( hws.begin(), hws.end() );
+                addSortedHeadwords( allHeadwords, hws );
+              }
             }
             catch ( std::exception & e ) {
               gdWarning( "getDataSlice error: %s\n", e.what() );
@@ -407,7 +468,10 @@ void FullTextSearchDialog::searchReqFinished()
   }
 
   if ( !allHeadwords.isEmpty() ) {
-    model->addResults( QModelIndex(), allHeadwords );
+    if ( rankedResults )
+      model->appendRankedResults( allHeadwords );
+    else
+      model->addResults( QModelIndex(), allHeadwords );
     if ( results.size() > matchedCount )
       ui.articlesFoundLabel->setText( tr( "Articles found: " ) + QString::number( results.size() ) );
   }
@@ -419,6 +483,21 @@ void FullTextSearchDialog::searchReqFinished()
   }
 }
 
+void FullTextSearchDialog::federatedReqUpdated()
+{
+  if ( !federatedReq )
+    return;
+
+  QList< FtsHeadword > hws = federatedReq->takeHeadwords();
+  if ( hws.isEmpty() )
+    return;
+
+  // Already in the order of relevance across the dictionaries
+  model->appendRankedResults( hws );
+  if ( results.size() > matchedCount )
+    ui.articlesFoundLabel->setText( tr( "Articles found: " ) + QString::number( results.size() ) );
+}
+
 void FullTextSearchDialog::matchCount( int _matchCount )
 {
   matchedCount += _matchCount;
@@ -579,11 +658,34 @@ void HeadwordsListModel::addResults( const QModelIndex & parent, QList< FtsHeadw
   emit contentChanged();
 }
 
+void HeadwordsListModel::appendRankedResults( QList< FtsHeadword > const & hws )
+{
+  beginResetModel();
+
+  for ( auto const & hw : hws ) {
+    QString const key = hw.headword.toCaseFolded();
+    auto i            = rankedRows.constFind( key );
+
+    // The same headword may come from several dictionaries, in which case it
+    // stays where its most relevant match put it
+    if ( i != rankedRows.constEnd() && i.value() < headwords.size() )
+      mergeHeadword( headwords[ i.value() ], hw );
+    else {
+      rankedRows.insert( key, headwords.size() );
+      headwords.append( hw );
+    }
+  }
+
+  endResetModel();
+  emit contentChanged();
+}
+
 bool HeadwordsListModel::clear()
 {
   beginResetModel();
 
   headwords.clear();
+  rankedRows.clear();
 
   endResetModel();
 
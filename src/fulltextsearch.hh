@@ -3,6 +3,7 @@
 
 #include <QAbstractListModel>
 #include <QAction>
+#include <QHash>
 #include <QList>
 #include <QTimer>
 #include <QThread>
@@ -23,6 +24,10 @@
 #include "instances.hh"
 #include "delegate.hh"
 
+namespace FtsHelpers {
+class FTSFederatedRequest;
+}
+
 namespace FTS {
 
 enum {
@@ -185,11 +190,20 @@ public:
   //  bool setData( QModelIndex const & index, const QVariant & value, int role );
 
   void addResults( const QModelIndex & parent, QList< FtsHeadword > const & headwords );
+
+  /// Appends the headwords in the order given, which is their relevance,
+  /// rather than keeping the list sorted. The ones already listed are merged
+  /// into the existing rows.
+  void appendRankedResults( QList< FtsHeadword > const & headwords );
+
   bool clear();
 
 private:
 
   QList< FtsHeadword > & headwords;
+  /// The rows of the headwords added by appendRankedResults(), by their
+  /// case-folded text
+  QHash< QString, int > rankedRows;
   std::vector< sptr< Dictionary::Class > > const & dictionaries;
 
   int getDictIndex( QString const & id ) const;
@@ -210,10 +224,15 @@ class FullTextSearchDialog: public QDialog
 
   std::list< sptr< Dictionary::DataRequest > > searchReqs;
 
+  /// The federated search in progress, which is also in searchReqs
+  sptr< FtsHelpers::FTSFederatedRequest > federatedReq;
+
   FtsIndexing & ftsIdx;
 
   QRegExp searchRegExp;
   int matchedCount;
+  /// Whether the results of the current search are listed by relevance
+  bool rankedResults = false;
 
 public:
   FullTextSearchDialog( QWidget * parent,
@@ -250,6 +269,7 @@ private slots:
   void saveData();
   void accept();
   void searchReqFinished();
+  void federatedReqUpdated();
   void matchCount( int );
   void reject();
   void itemClicked( QModelIndex const & idx );
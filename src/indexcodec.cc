@@ -0,0 +1,232 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
+
+#include "indexcodec.hh"
+#include "globalbroadcaster.hh"
+
+#include <zlib.h>
+
+#ifdef USE_ZSTD
+  #include <zdict.h>
+  #include <zstd.h>
+#endif
+
+namespace IndexCodec {
+
+namespace {
+
+#ifdef USE_ZSTD
+
+enum {
+  /// A good compromise between the indexing time and the resulting size
+  ZstdLevel = 6
+};
+
+/// Compression and decompression contexts are costly to create, so each
+/// thread keeps its own ones around.
+struct ZstdContexts
+{
+  ZSTD_CCtx * cctx = nullptr;
+  ZSTD_DCtx * dctx = nullptr;
+
+  ZSTD_CCtx * compression()
+  {
+    if ( !cctx )
+      cctx = ZSTD_createCCtx();
+    return cctx;
+  }
+
+  ZSTD_DCtx * decompression()
+  {
+    if ( !dctx )
+      dctx = ZSTD_createDCtx();
+    return dctx;
+  }
+
+  ~ZstdContexts()
+  {
+    ZSTD_freeCCtx( cctx );
+    ZSTD_freeDCtx( dctx );
+  }
+};
+
+thread_local ZstdContexts zstdContexts;
+
+#endif
+
+} // namespace
+
+bool isSupported( uint32_t codec )
+{
+  switch ( codec ) {
+    case Zlib:
+      return true;
+#ifdef USE_ZSTD
+    case Zstd:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+Codec preferred()
+{
+#ifdef USE_ZSTD
+  Config::Preferences const * preferences = GlobalBroadcaster::instance()->getPreference();
+
+  if ( preferences && preferences->zstdIndexCompression )
+    return Zstd;
+#endif
+
+  return Zlib;
+}
+
+sptr< TrainedDictionary >
+TrainedDictionary::train( vector< char > const & samples, vector< size_t > const & sampleSizes, size_t maxSize )
+{
+#ifdef USE_ZSTD
+  if ( samples.empty() || sampleSizes.empty() )
+    return {};
+
+  vector< char > dictData( maxSize );
+
+  size_t result = ZDICT_trainFromBuffer( dictData.data(),
+                                         dictData.size(),
+                                         samples.data(),
+                                         sampleSizes.data(),
+                                         (unsigned)sampleSizes.size() );
+
+  if ( ZDICT_isError( result ) )
+    return {};
+
+  dictData.resize( result );
+
+  return std::make_shared< TrainedDictionary >( std::move( dictData ) );
+#else
+  Q_UNUSED( samples )
+  Q_UNUSED( sampleSizes )
+  Q_UNUSED( maxSize )
+  return {};
+#endif
+}
+
+TrainedDictionary::TrainedDictionary( vector< char > data ):
+  dictData( std::move( data ) )
+{
+}
+
+TrainedDictionary::~TrainedDictionary()
+{
+#ifdef USE_ZSTD
+  ZSTD_freeCDict( (ZSTD_CDict *)cdict );
+  ZSTD_freeDDict( (ZSTD_DDict *)ddict );
+#endif
+}
+
+void * TrainedDictionary::compressionDictionary() const
+{
+#ifdef USE_ZSTD
+  std::call_once( cdictCreated, [ this ]() {
+    cdict = ZSTD_createCDict( dictData.data(), dictData.size(), ZstdLevel );
+  } );
+#endif
+  return cdict;
+}
+
+void * TrainedDictionary::decompressionDictionary() const
+{
+#ifdef USE_ZSTD
+  std::call_once( ddictCreated, [ this ]() {
+    ddict = ZSTD_createDDict( dictData.data(), dictData.size() );
+  } );
+#endif
+  return ddict;
+}
+
+void compress( Codec codec,
+               void const * data,
+               size_t size,
+               vector< unsigned char > & out,
+               TrainedDictionary const * dictionary )
+{
+  switch ( codec ) {
+    case Zlib: {
+      out.resize( compressBound( size ) );
+
+      unsigned long compressedSize = out.size();
+
+      if ( ::compress( out.data(), &compressedSize, (unsigned char const *)data, size ) != Z_OK )
+        throw exFailedToCompress();
+
+      out.resize( compressedSize );
+      return;
+    }
+#ifdef USE_ZSTD
+    case Zstd: {
+      out.resize( ZSTD_compressBound( size ) );
+
+      ZSTD_CCtx * cctx = zstdContexts.compression();
+      size_t result;
+
+      if ( dictionary && dictionary->compressionDictionary() )
+        result = ZSTD_compress_usingCDict( cctx,
+                                           out.data(),
+                                           out.size(),
+                                           data,
+                                           size,
+                                           (ZSTD_CDict const *)dictionary->compressionDictionary() );
+      else
+        result = ZSTD_compressCCtx( cctx, out.data(), out.size(), data, size, ZstdLevel );
+
+      if ( ZSTD_isError( result ) )
+        throw exFailedToCompress();
+
+      out.resize( result );
+      return;
+    }
+#endif
+    default:
+      Q_UNUSED( dictionary )
+      throw exUnsupportedCodec();
+  }
+}
+
+bool decompress( uint32_t codec,
+                 void const * data,
+                 size_t size,
+                 void * out,
+                 size_t outSize,
+                 TrainedDictionary const * dictionary )
+{
+  switch ( codec ) {
+    case Zlib: {
+      unsigned long decompressedLength = outSize;
+
+      return uncompress( (unsigned char *)out, &decompressedLength, (unsigned char const *)data, size ) == Z_OK
+        && decompressedLength == outSize;
+    }
+#ifdef USE_ZSTD
+    case Zstd: {
+      ZSTD_DCtx * dctx = zstdContexts.decompression();
+      size_t result;
+
+      if ( dictionary && dictionary->decompressionDictionary() )
+        result = ZSTD_decompress_usingDDict( dctx,
+                                             out,
+                                             outSize,
+                                             data,
+                                             size,
+                                             (ZSTD_DDict const *)dictionary->decompressionDictionary() );
+      else
+        result = ZSTD_decompressDCtx( dctx, out, outSize, data, size );
+
+      return !ZSTD_isError( result ) && result == outSize;
+    }
+#endif
+    default:
+      Q_UNUSED( dictionary )
+      return false;
+  }
+}
+
+} // namespace IndexCodec
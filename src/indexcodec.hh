@@ -0,0 +1,94 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
+
+#ifndef __INDEXCODEC_HH_INCLUDED__
+#define __INDEXCODEC_HH_INCLUDED__
+
+#include "ex.hh"
+#include "sptr.hh"
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/// The compression codecs used for the data in our own index files, that is
+/// btree nodes and chunked storage. All the indexes built before the codec
+/// was made selectable use zlib, which is codec 0.
+namespace IndexCodec {
+
+using std::vector;
+
+DEF_EX( Ex, "Index codec exception", std::exception )
+DEF_EX( exUnsupportedCodec, "The index was compressed with a codec not supported by this build", Ex )
+DEF_EX( exFailedToCompress, "Failed to compress index data", Ex )
+
+enum Codec : uint32_t {
+  /// zlib's compress()/uncompress()
+  Zlib = 0,
+  /// Zstandard, optionally with a dictionary trained on the index data
+  Zstd = 1
+};
+
+/// Returns true if this build is able to decompress data using the codec.
+bool isSupported( uint32_t codec );
+
+/// Returns the codec to compress the newly built indexes with, as selected
+/// in the preferences.
+Codec preferred();
+
+/// A compression dictionary trained on the samples of the data to compress.
+/// Only makes sense for Zstd. Once created, it can be used from any thread.
+class TrainedDictionary
+{
+public:
+
+  /// Trains a dictionary of at most maxSize bytes on the given samples,
+  /// which are stored one after another in 'samples'. Returns nullptr if
+  /// there isn't enough data for training or it fails otherwise.
+  static sptr< TrainedDictionary >
+  train( vector< char > const & samples, vector< size_t > const & sampleSizes, size_t maxSize );
+
+  /// Wraps the data of a dictionary trained before.
+  explicit TrainedDictionary( vector< char > data );
+
+  ~TrainedDictionary();
+
+  vector< char > const & data() const
+  {
+    return dictData;
+  }
+
+  /// Returns the digested dictionaries, as used by the codec
+  void * compressionDictionary() const;
+  void * decompressionDictionary() const;
+
+private:
+
+  TrainedDictionary( TrainedDictionary const & ) = delete;
+  TrainedDictionary & operator=( TrainedDictionary const & ) = delete;
+
+  vector< char > dictData;
+
+  // These are created on first use, since readers never need the first one
+  // and writers never need the second one.
+  mutable std::once_flag cdictCreated, ddictCreated;
+  mutable void * cdict = nullptr;
+  mutable void * ddict = nullptr;
+};
+
+/// Compresses the data using the given codec. The result replaces the
+/// contents of 'out'. Throws exFailedToCompress on failure.
+void compress(
+  Codec, void const * data, size_t size, vector< unsigned char > & out, TrainedDictionary const * = nullptr );
+
+/// Decompresses the data, which must decompress to exactly outSize bytes.
+/// Returns false if it doesn't, or if the data is corrupted.
+bool decompress( uint32_t codec,
+                 void const * data,
+                 size_t size,
+                 void * out,
+                 size_t outSize,
+                 TrainedDictionary const * = nullptr );
+
+} // namespace IndexCodec
+
+#endif
@@ -13,6 +13,13 @@ using std::string;
 Group::Group( Config::Group const & cfgGroup,
               std::vector< sptr< Dictionary::Class > > const & allDictionaries,
               Config::Group const & inactiveGroup ):
+  Group( cfgGroup, Dictionary::Registry( allDictionaries ), inactiveGroup )
+{
+}
+
+Group::Group( Config::Group const & cfgGroup,
+              Dictionary::Registry const & allDictionaries,
+              Config::Group const & inactiveGroup ):
   id( cfgGroup.id ),
   name( cfgGroup.name ),
   icon( cfgGroup.icon ),
@@ -22,30 +29,19 @@ Group::Group( Config::Group const & cfgGroup,
   if ( !cfgGroup.iconData.isEmpty() )
     iconData = iconFromData( cfgGroup.iconData );
 
-  QMap< string, sptr< Dictionary::Class > > groupDicts;
-  QVector< string > dictOrderList;
-  auto dictMap = Dictionary::dictToMap( allDictionaries );
+  set< string, std::less<> > inactiveSet;
+  for ( auto const & dict : inactiveGroup.dictionaries )
+    inactiveSet.insert( dict.id.toStdString() );
 
+  set< string, std::less<> > presentIds;
   for ( auto const & dict : cfgGroup.dictionaries ) {
-    std::string dictId = dict.id.toStdString();
+    string dictId = dict.id.toStdString();
 
-    if ( dictMap.contains( dictId ) ) {
-      groupDicts.insert( dictId, dictMap[ dictId ] );
-      dictOrderList.push_back( dictId );
-    }
-  }
+    if ( inactiveSet.count( dictId ) || !presentIds.insert( dictId ).second )
+      continue;
 
-  // Remove inactive dictionaries
-  if ( !inactiveGroup.dictionaries.isEmpty() ) {
-    set< string, std::less<> > inactiveSet;
-    for ( auto const & dict : inactiveGroup.dictionaries ) {
-      string dictId = dict.id.toStdString();
-      groupDicts.remove( dictId );
-      dictOrderList.removeOne( dictId );
-    }
-  }
-  for ( const auto & dictId : dictOrderList ) {
-    dictionaries.push_back( groupDicts[ dictId ] );
+    if ( sptr< Dictionary::Class > d = allDictionaries.find( dictId ) )
+      dictionaries.push_back( d );
   }
 }
 
@@ -145,25 +141,34 @@ void complementDictionaryOrder( Group & group,
 
 void updateNames( Config::Group & group, vector< sptr< Dictionary::Class > > const & allDictionaries )
 {
+  updateNames( group, Dictionary::Registry( allDictionaries ) );
+}
 
+void updateNames( Config::Group & group, Dictionary::Registry const & allDictionaries )
+{
   for ( unsigned x = group.dictionaries.size(); x--; ) {
-    std::string id = group.dictionaries[ x ].id.toStdString();
-
-    for ( unsigned y = allDictionaries.size(); y--; )
-      if ( allDictionaries[ y ]->getId() == id ) {
-        group.dictionaries[ x ].name = QString::fromUtf8( allDictionaries[ y ]->getName().c_str() );
-        break;
-      }
+    if ( sptr< Dictionary::Class > dict = allDictionaries.find( group.dictionaries[ x ].id.toStdString() ) )
+      group.dictionaries[ x ].name = QString::fromUtf8( dict->getName().c_str() );
   }
 }
 
-void updateNames( Config::Groups & groups, vector< sptr< Dictionary::Class > > const & allDictionaries )
+void updateNames( Config::Groups & groups, Dictionary::Registry const & allDictionaries )
 {
   for ( int x = 0; x < groups.size(); ++x )
     updateNames( groups[ x ], allDictionaries );
 }
 
+void updateNames( Config::Groups & groups, vector< sptr< Dictionary::Class > > const & allDictionaries )
+{
+  updateNames( groups, Dictionary::Registry( allDictionaries ) );
+}
+
 void updateNames( Config::Class & cfg, vector< sptr< Dictionary::Class > > const & allDictionaries )
+{
+  updateNames( cfg, Dictionary::Registry( allDictionaries ) );
+}
+
+void updateNames( Config::Class & cfg, Dictionary::Registry const & allDictionaries )
 {
   updateNames( cfg.dictionaryOrder, allDictionaries );
   updateNames( cfg.inactiveDictionaries, allDictionaries );
@@ -32,6 +32,12 @@ struct Group
          std::vector< sptr< Dictionary::Class > > const & allDictionaries,
          Config::Group const & inactiveGroup );
 
+  /// The same, but looks the dictionaries up in the given registry. Use it
+  /// when instantiating several groups from the same dictionaries.
+  Group( Config::Group const & cfgGroup,
+         Dictionary::Registry const & allDictionaries,
+         Config::Group const & inactiveGroup );
+
   /// Creates an empty group.
   explicit Group( QString const & name_ );
 
@@ -77,13 +83,16 @@ void complementDictionaryOrder( Group & dictionaryOrder,
 /// the dictionaries they refer to in their current form, if they exist.
 /// If the dictionary instance can't be located, the name is left untouched.
 void updateNames( Config::Group &, vector< sptr< Dictionary::Class > > const & allDictionaries );
+void updateNames( Config::Group &, Dictionary::Registry const & allDictionaries );
 
 /// Does updateNames() for a set of given groups.
 void updateNames( Config::Groups &, vector< sptr< Dictionary::Class > > const & allDictionaries );
+void updateNames( Config::Groups &, Dictionary::Registry const & allDictionaries );
 
 /// Does updateNames() for any relevant dictionary groups present in the
 /// configuration.
 void updateNames( Config::Class &, vector< sptr< Dictionary::Class > > const & allDictionaries );
+void updateNames( Config::Class &, Dictionary::Registry const & allDictionaries );
 
 /// Creates icon from icon data. Used by Group, but also by others who work
 /// with icon data directly.
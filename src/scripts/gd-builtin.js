@@ -122,3 +122,58 @@ function gdCheckArticlesNumber() {
     if (el && el.className.search("gdcollapsedarticle") > 0) gdExpandArticle(s);
   }
 }
+
+// Moves an article which was finished out of order from the template it
+// was received in to the slot held for it, then fixes up the separators,
+// which only the articles below the first one should have. Only the filled
+// article and the one below it can be affected. An article which may still
+// be redone comes inside a slot of its own, which the redone one fills.
+function gdFillArticleSlot(id) {
+  var slot = document.getElementById("gdslot-" + id);
+  var fill = document.getElementById("gdslotfill-" + id);
+  if (!slot || !fill) return;
+  var parent = slot.parentNode;
+  var next = slot.nextElementSibling;
+  var article = fill.content.querySelector(".gdarticle");
+  slot.replaceWith(fill.content);
+  fill.remove();
+
+  if (!article) return;
+
+  var top = article;
+  while (top.parentNode && top.parentNode !== parent) top = top.parentNode;
+
+  var prev = article.previousElementSibling;
+  if (prev && prev.classList.contains("gdarticleseparator"))
+    prev.style.display = gdHasArticleBefore(top) ? "" : "none";
+
+  while (next && !gdArticleIn(next)) next = next.nextElementSibling;
+  if (next) gdShowArticleSeparator(gdArticleIn(next));
+}
+
+// Returns the article which is the given element or is held in it as a slot.
+function gdArticleIn(el) {
+  if (el.classList.contains("gdarticle")) return el;
+  return el.classList.contains("gdarticleslot") ? el.querySelector(":scope > .gdarticle") : null;
+}
+
+// Tells whether there's an article above the given element.
+function gdHasArticleBefore(el) {
+  for (el = el.previousElementSibling; el; el = el.previousElementSibling)
+    if (gdArticleIn(el)) return true;
+  return false;
+}
+
+// Gives the article a visible separator, making one if it has none.
+function gdShowArticleSeparator(article) {
+  var prev = article.previousElementSibling;
+  if (prev && prev.classList.contains("gdarticleseparator")) {
+    prev.style.display = "";
+  } else {
+    var clear = document.createElement("div");
+    clear.style.clear = "both";
+    var separator = document.createElement("span");
+    separator.className = "gdarticleseparator";
+    article.before(clear, separator);
+  }
+}
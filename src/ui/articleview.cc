@@ -1644,33 +1644,30 @@ void ArticleView::contextMenuRequested( QPoint const & pos )
   unsigned refsAdded            = 0;
   bool maxDictionaryRefsReached = false;
 
+  sptr< Dictionary::Registry const > registry = Dictionary::Registry::current();
+
   for ( QStringList::const_iterator i = ids.constBegin(); i != ids.constEnd(); ++i, ++refsAdded ) {
     // Find this dictionary
-
-    for ( unsigned x = allDictionaries.size(); x--; ) {
-      if ( allDictionaries[ x ]->getId() == i->toUtf8().data() ) {
-        QAction * action = nullptr;
-        if ( refsAdded == cfg.preferences.maxDictionaryRefsInContextMenu ) {
-          // Enough! Or the menu would become too large.
-          maxDictionaryRefsAction  = new QAction( ".........", &menu );
-          action                   = maxDictionaryRefsAction;
-          maxDictionaryRefsReached = true;
-        }
-        else {
-          action = new QAction( allDictionaries[ x ]->getIcon(),
-                                QString::fromUtf8( allDictionaries[ x ]->getName().c_str() ),
-                                &menu );
-          // Force icons in menu on all platforms,
-          // since without them it will be much harder
-          // to find things.
-          action->setIconVisibleInMenu( true );
-        }
-        menu.addAction( action );
-
-        tableOfContents[ action ] = *i;
-
-        break;
+    sptr< Dictionary::Class > dict = registry->find( i->toStdString() );
+
+    if ( dict ) {
+      QAction * action = nullptr;
+      if ( refsAdded == cfg.preferences.maxDictionaryRefsInContextMenu ) {
+        // Enough! Or the menu would become too large.
+        maxDictionaryRefsAction  = new QAction( ".........", &menu );
+        action                   = maxDictionaryRefsAction;
+        maxDictionaryRefsReached = true;
       }
+      else {
+        action = new QAction( dict->getIcon(), QString::fromUtf8( dict->getName().c_str() ), &menu );
+        // Force icons in menu on all platforms,
+        // since without them it will be much harder
+        // to find things.
+        action->setIconVisibleInMenu( true );
+      }
+      menu.addAction( action );
+
+      tableOfContents[ action ] = *i;
     }
     if ( maxDictionaryRefsReached )
       break;
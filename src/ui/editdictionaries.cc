@@ -201,6 +201,8 @@ void EditDictionaries::acceptChangedSources( bool rebuildGroups )
   groups.clear();
   orderAndProps.clear();
 
+  emit dictionariesAboutToReload();
+
   loadDictionaries( this, true, cfg, dictionaries, dictNetMgr );
 
   // If no changes to groups were made, update the original data
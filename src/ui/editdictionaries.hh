@@ -62,6 +62,10 @@ signals:
 
   void showDictionaryHeadwords( Dictionary::Class * dict );
 
+  /// Emitted before the dictionaries are reloaded, so that the references to
+  /// the old ones held elsewhere can be dropped
+  void dictionariesAboutToReload();
+
 private:
 
   bool isSourcesChanged() const;
@@ -389,13 +389,11 @@ void DictListModel::addSelectedUniqueFromModel( QItemSelectionModel * source )
   if ( list.empty() )
     return;
 
+  Dictionary::Registry const registry( *allDicts );
+
   for ( const auto & j : list ) {
-    for ( const auto & allDict : *allDicts ) {
-      if ( allDict->getId() == j ) {
-        dictionaries.push_back( allDict );
-        break;
-      }
-    }
+    if ( sptr< Dictionary::Class > dict = registry.find( j ) )
+      dictionaries.push_back( dict );
   }
 
   beginResetModel();
@@ -11,6 +11,7 @@
 #include <QWebEngineProfile>
 #include "editdictionaries.hh"
 #include "dict/loaddictionaries.hh"
+#include "btreeidx.hh"
 #include "preferences.hh"
 #include "about.hh"
 #include "mruqmenu.hh"
@@ -157,7 +158,6 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
   dictionaryBar( this, configEvents, cfg.editDictionaryCommandLine, cfg.preferences.maxDictionaryRefsInContextMenu ),
   articleMaker( dictionaries, groupInstances, cfg.preferences ),
   articleNetMgr( this,
-                 dictionaries,
                  articleMaker,
                  cfg.preferences.disallowContentFromOtherSites,
                  cfg.preferences.hideGoldenDictHeader ),
@@ -172,6 +172,8 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
   starIcon( ":/icons/star.svg" ),
   blueStarIcon( ":/icons/star_blue.svg" )
 {
+  startupTimer.start();
+
   if ( QThreadPool::globalInstance()->maxThreadCount() < MIN_THREAD_COUNT )
     QThreadPool::globalInstance()->setMaxThreadCount( MIN_THREAD_COUNT );
 
@@ -733,6 +735,7 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
            &MainWindow::proxyAuthentication );
 
   setupNetworkCache( cfg.preferences.maxNetworkCacheSize );
+  setupIndexNodeCache( cfg.preferences.indexNodeCacheSize );
 
   makeDictionaries();
 
@@ -1210,13 +1213,19 @@ void MainWindow::commitData( QSessionManager & )
 
 void MainWindow::commitData()
 {
+  BtreeIndexing::NodeCacheStats const nodeCache = BtreeIndexing::getNodeCacheStats();
+
+  qDebug() << "Index node cache:" << nodeCache.hits << "hits," << nodeCache.misses << "misses,"
+           << nodeCache.evictions << "evictions," << nodeCache.nodes << "nodes in" << nodeCache.bytesUsed
+           << "of" << nodeCache.bytesBudget << "bytes";
+
   if ( cfg.preferences.clearNetworkCacheOnExit ) {
     if ( QAbstractNetworkCache * cache = articleNetMgr.cache() )
       cache->clear();
   }
 
   //if the dictionaries is empty ,large chance that the config has corrupt.
-  if ( cfg.preferences.removeInvalidIndexOnExit && !dictMap.isEmpty() ) {
+  if ( cfg.preferences.removeInvalidIndexOnExit && !dictRegistry->empty() ) {
     QDir const dir( Config::getIndexDir() );
 
     QFileInfoList const entries = dir.entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
@@ -1225,7 +1234,7 @@ void MainWindow::commitData()
       QString const fileName = file.fileName();
 
       //remove both normal index and fts index.
-      if ( !dictMap.contains( fileName.toStdString() ) ) {
+      if ( !dictRegistry->contains( fileName.toStdString() ) ) {
         auto filePath = file.absoluteFilePath();
         qDebug() << "remove invalid index files & fts dirs";
 
@@ -1511,6 +1520,12 @@ void MainWindow::applyProxySettings()
   QNetworkProxy::setApplicationProxy( proxy );
 }
 
+void MainWindow::setupIndexNodeCache( int maxSize )
+{
+  // x << 20 == x * 2^20 converts mebibytes to bytes.
+  BtreeIndexing::setNodeCacheBudget( maxSize <= 0 ? size_t( 0 ) : static_cast< size_t >( maxSize ) << 20 );
+}
+
 void MainWindow::setupNetworkCache( int maxSize )
 {
   // x << 20 == x * 2^20 converts mebibytes to bytes.
@@ -1549,8 +1564,7 @@ void MainWindow::makeDictionaries()
 
   loadDictionaries( this, isVisible(), cfg, dictionaries, dictNetMgr, false );
 
-  //create map
-  dictMap = Dictionary::dictToMap( dictionaries );
+  dictRegistry = Dictionary::Registry::publish( dictionaries );
 
   for ( unsigned x = 0; x < dictionaries.size(); x++ ) {
     dictionaries[ x ]->setFTSParameters( cfg.preferences.fts );
@@ -1594,11 +1608,11 @@ void MainWindow::updateGroupList()
 
   // Add dictionaryOrder first, as the 'All' group.
   {
-    Instances::Group g( cfg.dictionaryOrder, dictionaries, Config::Group() );
+    Instances::Group g( cfg.dictionaryOrder, *dictRegistry, Config::Group() );
 
     // Add any missing entries to dictionary order
     Instances::complementDictionaryOrder( g,
-                                          Instances::Group( cfg.inactiveDictionaries, dictionaries, Config::Group() ),
+                                          Instances::Group( cfg.inactiveDictionaries, *dictRegistry, Config::Group() ),
                                           dictionaries );
 
     g.name = tr( "All" );
@@ -1610,13 +1624,13 @@ void MainWindow::updateGroupList()
 
   GlobalBroadcaster::instance()->groupFolderMap.clear();
   for ( int x = 0; x < cfg.groups.size(); ++x ) {
-    groupInstances.push_back( Instances::Group( cfg.groups[ x ], dictionaries, cfg.inactiveDictionaries ) );
+    groupInstances.push_back( Instances::Group( cfg.groups[ x ], *dictRegistry, cfg.inactiveDictionaries ) );
     GlobalBroadcaster::instance()->groupFolderMap.insert( cfg.groups[ x ].id, cfg.groups[ x ].favoritesFolder );
   }
 
   // Update names for dictionaries that are present, so that they could be
   // found in case they got moved.
-  Instances::updateNames( cfg, dictionaries );
+  Instances::updateNames( cfg, *dictRegistry );
 
   groupList->fill( groupInstances );
   groupList->setCurrentGroup( cfg.lastMainGroupId );
@@ -1984,6 +1998,11 @@ void MainWindow::pageLoaded( ArticleView * view )
   if ( view != getCurrentArticleView() )
     return; // It was background action
 
+  if ( !firstLookupShown && !view->getWord().isEmpty() ) {
+    firstLookupShown = true;
+    qDebug() << "First lookup shown" << startupTimer.elapsed() << "ms after startup";
+  }
+
   updateBackForwardButtons();
   updatePronounceAvailability();
 }
@@ -2074,21 +2093,18 @@ void MainWindow::updateFoundInDictsList()
 
     for ( QStringList::const_iterator i = ids.constBegin(); i != ids.constEnd(); ++i ) {
       // Find this dictionary
-
-      for ( unsigned x = dictionaries.size(); x--; ) {
-        if ( dictionaries[ x ]->getId() == i->toUtf8().data() ) {
-          QString dictName = QString::fromUtf8( dictionaries[ x ]->getName().c_str() );
-          QString dictId   = QString::fromUtf8( dictionaries[ x ]->getId().c_str() );
-          QListWidgetItem * item =
-            new QListWidgetItem( dictionaries[ x ]->getIcon(), dictName, ui.dictsList, QListWidgetItem::Type );
-          item->setData( Qt::UserRole, QVariant( dictId ) );
-          item->setToolTip( dictName );
-
-          ui.dictsList->addItem( item );
-          if ( dictId == activeId ) {
-            ui.dictsList->setCurrentItem( item );
-          }
-          break;
+      sptr< Dictionary::Class > dict = dictRegistry->find( i->toStdString() );
+
+      if ( dict ) {
+        QString dictName       = QString::fromUtf8( dict->getName().c_str() );
+        QString dictId         = *i;
+        QListWidgetItem * item = new QListWidgetItem( dict->getIcon(), dictName, ui.dictsList, QListWidgetItem::Type );
+        item->setData( Qt::UserRole, QVariant( dictId ) );
+        item->setToolTip( dictName );
+
+        ui.dictsList->addItem( item );
+        if ( dictId == activeId ) {
+          ui.dictsList->setCurrentItem( item );
         }
       }
     }
@@ -2140,6 +2156,8 @@ void MainWindow::editDictionaries( unsigned editDictionaryGroup )
 
     connect( &dicts, &EditDictionaries::showDictionaryHeadwords, this, &MainWindow::showDictionaryHeadwords );
 
+    connect( &dicts, &EditDictionaries::dictionariesAboutToReload, this, &MainWindow::releaseDictionaryRegistry );
+
     if ( editDictionaryGroup != Instances::Group::NoGroupId )
       dicts.editGroup( editDictionaryGroup );
 
@@ -2164,6 +2182,9 @@ void MainWindow::editDictionaries( unsigned editDictionaryGroup )
 
       cfg = newCfg;
 
+      if ( dicts.areDictionariesChanged() )
+        dictRegistry = Dictionary::Registry::publish( dictionaries );
+
       updateGroupList();
 
       Config::save( cfg );
@@ -2246,6 +2267,9 @@ void MainWindow::editPreferences()
     if ( cfg.preferences.maxNetworkCacheSize != p.maxNetworkCacheSize )
       setupNetworkCache( p.maxNetworkCacheSize );
 
+    if ( cfg.preferences.indexNodeCacheSize != p.indexNodeCacheSize )
+      setupIndexNodeCache( p.indexNodeCacheSize );
+
     bool needReload =
       ( cfg.preferences.displayStyle != p.displayStyle || cfg.preferences.addonStyle != p.addonStyle
         || cfg.preferences.darkReaderMode != p.darkReaderMode
@@ -3334,6 +3358,11 @@ void MainWindow::on_saveArticle_triggered()
   } );
 }
 
+void MainWindow::releaseDictionaryRegistry()
+{
+  dictRegistry = Dictionary::Registry::publish( {} );
+}
+
 void MainWindow::on_rescanFiles_triggered()
 {
   hotkeyWrapper.reset(); // No hotkeys while we're editing dictionaries
@@ -3347,9 +3376,10 @@ void MainWindow::on_rescanFiles_triggered()
   dictionaries.clear();
   dictionariesUnmuted.clear();
   dictionaryBar.setDictionaries( dictionaries );
+  releaseDictionaryRegistry();
 
   loadDictionaries( this, true, cfg, dictionaries, dictNetMgr );
-  dictMap = Dictionary::dictToMap( dictionaries );
+  dictRegistry = Dictionary::Registry::publish( dictionaries );
 
   for ( unsigned x = 0; x < dictionaries.size(); x++ ) {
     dictionaries[ x ]->setFTSParameters( cfg.preferences.fts );
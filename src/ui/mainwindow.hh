@@ -4,6 +4,7 @@
 #ifndef __MAINWINDOW_HH_INCLUDED__
 #define __MAINWINDOW_HH_INCLUDED__
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QThread>
 #include <QToolButton>
@@ -131,7 +132,9 @@ private:
   History history;
   DictionaryBar dictionaryBar;
   vector< sptr< Dictionary::Class > > dictionaries;
-  QMap< std::string, sptr< Dictionary::Class > > dictMap;
+  /// The ids of 'dictionaries', republished whenever they are reloaded, and
+  /// emptied before that
+  sptr< Dictionary::Registry const > dictRegistry = Dictionary::Registry::current();
   /// Here we store unmuted dictionaries when the dictionary bar is active
   vector< sptr< Dictionary::Class > > dictionariesUnmuted;
   Instances::Groups groupInstances;
@@ -157,6 +160,10 @@ private:
 
   bool wasMaximized; // Window state before minimization
 
+  /// Started along with the window, to measure the time to the first lookup
+  QElapsedTimer startupTimer;
+  bool firstLookupShown = false;
+
   QPrinter & getPrinter(); // Creates a printer if it's not there and returns it
 
   DictHeadwords * headwordsDlg;
@@ -199,6 +206,8 @@ private:
 
   void applyProxySettings();
   void setupNetworkCache( int maxSize );
+  /// Sets the memory budget of the decompressed index nodes, in MB
+  void setupIndexNodeCache( int maxSize );
   void makeDictionaries();
   void updateStatusLine();
   void updateGroupList();
@@ -419,6 +428,10 @@ private slots:
 
   void on_saveArticle_triggered();
 
+  /// Publishes an empty dictionary registry, so that only the dictionaries
+  /// list holds the dictionaries about to be reloaded
+  void releaseDictionaryRegistry();
+
   void on_rescanFiles_triggered();
 
   void toggle_favoritesPane();
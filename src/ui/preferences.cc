@@ -236,6 +236,7 @@ Preferences::Preferences( QWidget * parent, Config::Class & cfg_ ):
 
   ui.ignorePunctuation->setChecked( p.ignorePunctuation );
   ui.sessionCollapse->setChecked( p.sessionCollapse );
+  ui.streamArticles->setChecked( p.streamArticles );
 
   ui.synonymSearchEnabled->setChecked( p.synonymSearchEnabled );
 
@@ -355,6 +356,10 @@ Preferences::Preferences( QWidget * parent, Config::Class & cfg_ ):
   //Misc
   ui.removeInvalidIndexOnExit->setChecked( p.removeInvalidIndexOnExit );
   ui.dictionaryDebug->setChecked( p.dictionaryDebug );
+  ui.zstdIndexCompression->setChecked( p.zstdIndexCompression );
+#ifndef USE_ZSTD
+  ui.zstdIndexCompression->hide();
+#endif
 
   // Add-on styles
   ui.addonStylesLabel->setVisible( ui.addonStyles->count() > 1 );
@@ -477,6 +482,7 @@ Config::Preferences Preferences::getPreferences()
   p.ignoreDiacritics       = ui.ignoreDiacritics->isChecked();
   p.ignorePunctuation      = ui.ignorePunctuation->isChecked();
   p.sessionCollapse        = ui.sessionCollapse->isChecked();
+  p.streamArticles         = ui.streamArticles->isChecked();
   p.stripClipboard         = ui.stripClipboard->isChecked();
   p.raiseWindowOnSearch    = ui.raiseWindowOnSearch->isChecked();
 
@@ -520,6 +526,7 @@ Config::Preferences Preferences::getPreferences()
 
   p.removeInvalidIndexOnExit = ui.removeInvalidIndexOnExit->isChecked();
   p.dictionaryDebug          = ui.dictionaryDebug->isChecked();
+  p.zstdIndexCompression     = ui.zstdIndexCompression->isChecked();
 
   p.addonStyle = ui.addonStyles->getCurrentStyle();
 
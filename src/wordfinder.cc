@@ -6,6 +6,7 @@
 #include "wstring_qt.hh"
 #include <map>
 #include "gddebug.hh"
+#include <QDebug>
 
 using std::vector;
 using std::list;
@@ -13,12 +14,35 @@ using gd::wstring;
 using gd::wchar;
 using std::map;
 using std::pair;
+using std::string;
+
+namespace {
+
+/// Checks whether the word, or any of its parts following whitespace or
+/// punctuation, starts with the given folded string once folded.
+bool hasFoldedPrefix( wstring const & word, wstring const & folded )
+{
+  for ( wstring::size_type pos = 0; pos < word.size(); ++pos ) {
+    if ( pos && !Folding::isWhitespace( word[ pos - 1 ] ) && !Folding::isPunct( word[ pos - 1 ] ) )
+      continue;
+
+    if ( Folding::apply( word.substr( pos ) ).compare( 0, folded.size(), folded ) == 0 )
+      return true;
+  }
+
+  return false;
+}
+
+} // namespace
 
 WordFinder::WordFinder( QObject * parent ):
   QObject( parent ),
   searchInProgress( false ),
   updateResultsTimer( this ),
-  searchQueued( false )
+  searchQueued( false ),
+  canCacheSearch( false ),
+  cacheHits( 0 ),
+  cacheMisses( 0 )
 {
   updateResultsTimer.setInterval( 1000 ); // We use a one second update timer
   updateResultsTimer.setSingleShot( true );
@@ -136,6 +160,33 @@ void WordFinder::startSearch()
     allWordWritings.insert( allWordWritings.end(), writings.begin(), writings.end() );
   }
 
+  // The prefix search for a single writing can be answered from the cache if
+  // all the dictionaries queried can tell they'd only narrow down their results
+
+  canCacheSearch = false;
+
+  if ( searchType == PrefixMatch && allWordWritings.size() == 1 ) {
+    vector< string > dictIds;
+    bool narrowsDown = true;
+
+    for ( const auto & inputDict : *inputDicts ) {
+      if ( ( inputDict->getFeatures() & requestedFeatures ) != requestedFeatures )
+        continue;
+
+      if ( !inputDict->prefixMatchNarrowsDown() ) {
+        narrowsDown = false;
+        break;
+      }
+
+      dictIds.push_back( inputDict->getId() );
+    }
+
+    if ( narrowsDown && useCachedSearch( dictIds ) ) {
+      requestFinished();
+      return;
+    }
+  }
+
   // Query each dictionary for all word writings
 
   for ( const auto & inputDict : *inputDicts ) {
@@ -166,10 +217,90 @@ void WordFinder::startSearch()
   requestFinished();
 }
 
+bool WordFinder::useCachedSearch( vector< string > const & dictIds )
+{
+  wstring const & word = allWordWritings[ 0 ];
+
+  if ( word.find_first_of( U"*?[]" ) != wstring::npos )
+    return false; // Wildcards match differently
+
+  wstring folded = Folding::apply( word );
+
+  if ( folded.empty() )
+    return false;
+
+  auto cached = cachedSearches.begin();
+
+  while ( cached != cachedSearches.end()
+          && ( cached->dictIds != dictIds || cached->features != requestedFeatures
+               || cached->maxResults != requestedMaxResults ) )
+    ++cached;
+
+  if ( cached == cachedSearches.end() || folded.compare( 0, cached->folded.size(), cached->folded ) != 0 ) {
+    ++cacheMisses;
+
+    canCacheSearch           = true;
+    searchToCache.dictIds    = dictIds;
+    searchToCache.features   = requestedFeatures;
+    searchToCache.maxResults = requestedMaxResults;
+    searchToCache.folded     = folded;
+    searchToCache.uncertain  = false;
+    searchToCache.matches.clear();
+
+    return false;
+  }
+
+  // The word extends the cached one, so its matches are among the cached ones
+
+  auto sr = std::make_shared< Dictionary::WordSearchRequestInstant >();
+  sr->setUncertain( cached->uncertain );
+
+  for ( const auto & match : cached->matches ) {
+    if ( hasFoldedPrefix( match.word, folded ) )
+      sr->getMatches().push_back( match );
+  }
+
+  cached->folded  = folded;
+  cached->matches = sr->getMatches();
+  cachedSearches.splice( cachedSearches.begin(), cachedSearches, cached );
+
+  ++cacheHits;
+
+  qDebug() << "Word search: answered" << inputWord << "from the cache, hit" << cacheHits << "of"
+           << cacheHits + cacheMisses << "searches";
+
+  queuedRequests.push_back( sr );
+
+  return true;
+}
+
+void WordFinder::cacheSearch()
+{
+  if ( !canCacheSearch )
+    return;
+
+  canCacheSearch = false;
+
+  for ( auto i = cachedSearches.begin(); i != cachedSearches.end(); ++i ) {
+    if ( i->dictIds == searchToCache.dictIds ) {
+      cachedSearches.erase( i );
+      break;
+    }
+  }
+
+  cachedSearches.push_front( std::move( searchToCache ) );
+
+  if ( cachedSearches.size() > MaxCachedSearches )
+    cachedSearches.pop_back();
+
+  searchToCache = CachedSearch();
+}
+
 void WordFinder::cancel()
 {
   searchQueued     = false;
   searchInProgress = false;
+  canCacheSearch   = false;
 
   cancelSearches();
 }
@@ -179,6 +310,8 @@ void WordFinder::clear()
   cancel();
   queuedRequests.clear();
   finishedRequests.clear();
+  // The cached matches may come from the dictionaries being dropped
+  cachedSearches.clear();
 }
 
 void WordFinder::requestFinished()
@@ -194,6 +327,19 @@ void WordFinder::requestFinished()
       if ( ( *i )->isUncertain() )
         searchResultsUncertain = true;
 
+      if ( searchInProgress && canCacheSearch ) {
+        // Results cut short by maxResults don't hold the matches of the
+        // longer words, so such a search can't be reused
+        if ( !( *i )->getErrorString().isEmpty() || ( *i )->matchesCount() >= requestedMaxResults )
+          canCacheSearch = false;
+        else {
+          searchToCache.uncertain = searchToCache.uncertain || ( *i )->isUncertain();
+
+          vector< Dictionary::WordMatch > & matches = ( *i )->getAllMatches();
+          searchToCache.matches.insert( searchToCache.matches.end(), matches.begin(), matches.end() );
+        }
+      }
+
       if ( ( *i )->matchesCount() ) {
         newResults = true;
 
@@ -230,6 +376,7 @@ void WordFinder::requestFinished()
 
   if ( queuedRequests.empty() ) {
     // Search is finished.
+    cacheSearch();
     updateResults();
   }
 }
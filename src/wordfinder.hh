@@ -65,6 +65,32 @@ private:
   ResultsArray resultsArray;
   ResultsIndex resultsIndex;
 
+  /// The complete results of an earlier prefix search, kept to answer the
+  /// searches for the words extending it without querying the dictionaries.
+  struct CachedSearch
+  {
+    std::vector< std::string > dictIds;
+    Dictionary::Features features;
+    unsigned long maxResults;
+    gd::wstring folded; // The folded word searched for
+    bool uncertain;
+    std::vector< Dictionary::WordMatch > matches;
+  };
+
+  enum {
+    /// The number of the searches cached, one per dictionary group at most
+    MaxCachedSearches = 4
+  };
+
+  /// Most recently used searches first
+  std::list< CachedSearch > cachedSearches;
+  /// The search being made, collected to be cached once finished
+  CachedSearch searchToCache;
+  /// False if the search being made can't be cached, e.g. since some of the
+  /// dictionaries had more matches than requested
+  bool canCacheSearch;
+  unsigned cacheHits, cacheMisses;
+
 public:
 
   WordFinder( QObject * parent );
@@ -127,7 +153,8 @@ public:
 
   /// Cancels any pending search operation, if any, and makes sure no pending
   /// requests exist, and hence no dictionaries are used anymore. Unlike
-  /// cancel(), this may take some time to finish.
+  /// cancel(), this may take some time to finish. The cached searches are
+  /// dropped as well.
   void clear();
 
 signals:
@@ -152,6 +179,14 @@ private:
   // Starts the previously queued search.
   void startSearch();
 
+  /// Answers the prefix search being started from the cached results if
+  /// possible, or prepares its results to be cached. Returns true if the
+  /// search was answered.
+  bool useCachedSearch( std::vector< std::string > const & dictIds );
+
+  /// Puts the search just finished into the cache, if it's complete
+  void cacheSearch();
+
   // Cancels all searches. Useful to do before destroying them all, since they
   // would cancel in parallel.
   void cancelSearches();